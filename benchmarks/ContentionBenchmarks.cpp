@@ -0,0 +1,215 @@
+// Copyright (c) 2018-present, Facebook, Inc.
+//
+// This source code is licensed under the MIT license found in the
+// LICENSE file in the root directory of this source tree.
+
+//
+// sweeps the number of threads that submit to the strand and time_source
+// queues at the same time, and reports the throughput and the time spent
+// waiting for the queue locks at each count.
+//
+// build with PUSHMI_LOCK_STATS=1 to count the lock waits, otherwise only the
+// throughput is reported.
+//
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "pushmi/o/schedule.h"
+#include "pushmi/o/submit.h"
+
+#include "pushmi/new_thread.h"
+#include "pushmi/strand.h"
+#include "pushmi/time_source.h"
+
+#if __has_include(<experimental/thread_pool>)
+#define PUSHMI_BENCH_HAS_POOL 1
+#include "pool.h"
+#else
+#define PUSHMI_BENCH_HAS_POOL 0
+#endif
+
+using namespace pushmi::aliases;
+
+namespace {
+
+using clock = std::chrono::steady_clock;
+
+struct scenario {
+  std::string name;
+  mi::lock_stats* stats;
+  // submits items from each of producers threads and returns once all of
+  // them have run
+  std::function<void(int producers, int items)> fn;
+};
+
+// runs produce(p) on each of producers threads, released together
+template <class Produce>
+void in_parallel(int producers, Produce produce) {
+  std::atomic<bool> go{false};
+  std::vector<std::thread> threads;
+  for (int p = 0; p < producers; ++p) {
+    threads.emplace_back([&, p] {
+      while (!go.load(std::memory_order_acquire)) {
+        std::this_thread::yield();
+      }
+      produce(p);
+    });
+  }
+  go.store(true, std::memory_order_release);
+  for (auto& t : threads) {
+    t.join();
+  }
+}
+
+void wait_for(std::atomic<int>& remaining) {
+  while (remaining.load(std::memory_order_acquire) > 0) {
+    std::this_thread::yield();
+  }
+}
+
+// the strands over the worker threads of the pool, or over new_thread when
+// there is no pool
+template <class Fn>
+void with_strands(Fn fn) {
+#if PUSHMI_BENCH_HAS_POOL
+  mi::pool pl{std::max(1u, std::thread::hardware_concurrency())};
+  fn(mi::strands(pl.executor()));
+#else
+  fn(mi::strands(mi::new_thread()));
+#endif
+}
+
+std::vector<scenario> scenarios() {
+  std::vector<scenario> all;
+  all.push_back({"one strand", &mi::strand_lock_stats(), [](int producers, int items) {
+    with_strands([&](auto strands) {
+      auto strand = mi::make_strand(strands);
+      std::atomic<int> remaining{producers * items};
+      in_parallel(producers, [&](int) {
+        for (int i = 0; i < items; ++i) {
+          strand | op::schedule() | op::submit([&](auto) {
+            remaining.fetch_sub(1, std::memory_order_acq_rel);
+          });
+        }
+      });
+      wait_for(remaining);
+    });
+  }});
+  all.push_back({"strand per producer", &mi::strand_lock_stats(), [](int producers, int items) {
+    with_strands([&](auto strands) {
+      std::atomic<int> remaining{producers * items};
+      in_parallel(producers, [&](int) {
+        auto strand = mi::make_strand(strands);
+        for (int i = 0; i < items; ++i) {
+          strand | op::schedule() | op::submit([&](auto) {
+            remaining.fetch_sub(1, std::memory_order_acq_rel);
+          });
+        }
+      });
+      wait_for(remaining);
+    });
+  }});
+  all.push_back({"one time_source, schedule(tp)", &mi::time_source_lock_stats(), [](int producers, int items) {
+    auto time = mi::time_source<>{};
+    auto strands = time.make(mi::systemNowF{}, mi::new_thread());
+    std::atomic<int> remaining{producers * items};
+    in_parallel(producers, [&](int) {
+      auto tnt = mi::make_strand(strands);
+      for (int i = 0; i < items; ++i) {
+        tnt | op::schedule_at(std::chrono::system_clock::now()) |
+            op::submit([&](auto) {
+              remaining.fetch_sub(1, std::memory_order_acq_rel);
+            });
+      }
+    });
+    wait_for(remaining);
+    time.join();
+  }});
+  return all;
+}
+
+void usage(const char* self) {
+  std::printf(
+      "usage: %s [options]\n"
+      "  --filter <text>      run the scenarios with a name containing text\n"
+      "  --max-producers <n>  the largest number of producer threads\n"
+      "                       (default twice the hardware threads, at least 4)\n"
+      "  --items <n>          items submitted by each producer (default 20000)\n",
+      self);
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+  std::string filter;
+  int max_producers =
+      std::max(4, 2 * static_cast<int>(std::thread::hardware_concurrency()));
+  int items = 20000;
+  for (int i = 1; i < argc; ++i) {
+    auto arg = std::string(argv[i]);
+    auto next = [&]() -> const char* {
+      if (i + 1 >= argc) {
+        usage(argv[0]);
+        std::exit(1);
+      }
+      return argv[++i];
+    };
+    if (arg == "--filter") {
+      filter = next();
+    } else if (arg == "--max-producers") {
+      max_producers = std::max(1, std::atoi(next()));
+    } else if (arg == "--items") {
+      items = std::max(1, std::atoi(next()));
+    } else {
+      usage(argv[0]);
+      return arg == "--help" ? 0 : 1;
+    }
+  }
+
+  if (!mi::lock_stats::enabled) {
+    std::printf("built without PUSHMI_LOCK_STATS, lock waits are not counted\n");
+  }
+  // lock wait is the time that all the threads, producers and workers,
+  // spent waiting for the queue locks, as a fraction of the producer time.
+  std::printf("%d items per producer\n\n", items);
+
+  for (auto& s : scenarios()) {
+    if (s.name.find(filter) == std::string::npos) {
+      continue;
+    }
+    std::printf("%s\n", s.name.c_str());
+    std::printf(
+        "  %9s  %12s  %10s  %10s\n",
+        "producers",
+        "items/s",
+        "contended",
+        "lock wait");
+    for (int producers = 1; producers <= max_producers; producers *= 2) {
+      s.stats->reset();
+      auto start = clock::now();
+      s.fn(producers, items);
+      auto elapsed = std::chrono::duration<double>(clock::now() - start);
+
+      double acquisitions = s.stats->acquisitions.load();
+      double contended = s.stats->contended.load();
+      double wait = s.stats->wait_ns.load() * 1e-9;
+      std::printf(
+          "  %9d  %12.0f  %9.1f%%  %9.1f%%\n",
+          producers,
+          producers * items / elapsed.count(),
+          acquisitions > 0.0 ? 100.0 * contended / acquisitions : 0.0,
+          100.0 * wait / (producers * elapsed.count()));
+      std::fflush(stdout);
+    }
+    std::printf("\n");
+  }
+  return 0;
+}
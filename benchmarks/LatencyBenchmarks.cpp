@@ -0,0 +1,85 @@
+// Copyright (c) 2018-present, Facebook, Inc.
+//
+// This source code is licensed under the MIT license found in the
+// LICENSE file in the root directory of this source tree.
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <thread>
+
+#include "pushmi/o/just.h"
+#include "pushmi/o/schedule.h"
+#include "pushmi/o/submit.h"
+#include "pushmi/o/via.h"
+
+#include "pushmi/new_thread.h"
+#include "pushmi/strand.h"
+#include "pushmi/time_source.h"
+
+#if __has_include(<experimental/thread_pool>)
+#define PUSHMI_BENCH_HAS_POOL 1
+#include "pool.h"
+#else
+#define PUSHMI_BENCH_HAS_POOL 0
+#endif
+
+#include "latency.h"
+
+using namespace pushmi::aliases;
+
+//
+// each benchmark submits one item per tick of an open-loop generator and
+// records the time from the intended submit to the time the item runs.
+//
+
+#if PUSHMI_BENCH_HAS_POOL
+PUSHMI_LATENCY_BENCHMARK("pool{hardware_concurrency} schedule latency", [](bench::open_loop& loop){
+  mi::pool pl{std::max(1u,std::thread::hardware_concurrency())};
+  auto pe = pl.executor();
+  loop.run([&](std::size_t i){
+    pe | op::schedule() | op::submit([&loop, i](auto){ loop.complete(i); });
+  });
+})
+
+PUSHMI_LATENCY_BENCHMARK("strand(pool) schedule latency", [](bench::open_loop& loop){
+  mi::pool pl{std::max(1u,std::thread::hardware_concurrency())};
+  auto strands = mi::strands(pl.executor());
+  auto strand = mi::make_strand(strands);
+  loop.run([&](std::size_t i){
+    strand | op::schedule() | op::submit([&loop, i](auto){ loop.complete(i); });
+  });
+})
+#endif
+
+PUSHMI_LATENCY_BENCHMARK("strand(new thread) schedule latency", [](bench::open_loop& loop){
+  auto strands = mi::strands(mi::new_thread());
+  auto strand = mi::make_strand(strands);
+  loop.run([&](std::size_t i){
+    strand | op::schedule() | op::submit([&loop, i](auto){ loop.complete(i); });
+  });
+})
+
+PUSHMI_LATENCY_BENCHMARK("just | via(strand(new thread)) latency", [](bench::open_loop& loop){
+  auto strands = mi::strands(mi::new_thread());
+  loop.run([&](std::size_t i){
+    op::just(i) | op::via(strands) | op::submit([&loop](std::size_t i){ loop.complete(i); });
+  });
+})
+
+PUSHMI_LATENCY_BENCHMARK("time source(new thread) schedule at latency", [](bench::open_loop& loop){
+  auto time = mi::time_source<>{};
+  auto strands = time.make(mi::systemNowF{}, mi::new_thread());
+  auto tnt = mi::make_strand(strands);
+  // each item is scheduled at its intended time, which has just passed when
+  // the generator is on time.
+  auto steady = bench::clock::now();
+  auto system = std::chrono::system_clock::now();
+  loop.run([&](std::size_t i){
+    auto at = system + std::chrono::duration_cast<
+                           std::chrono::system_clock::duration>(
+                           loop.intended(i) - steady);
+    tnt | op::schedule_at(at) | op::submit([&loop, i](auto){ loop.complete(i); });
+  });
+  time.join();
+})
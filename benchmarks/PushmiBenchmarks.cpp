@@ -1,11 +1,16 @@
-
-#include <vector>
-
 // Copyright (c) 2018-present, Facebook, Inc.
 //
 // This source code is licensed under the MIT license found in the
 // LICENSE file in the root directory of this source tree.
 
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <numeric>
+#include <thread>
+#include <vector>
+
 #include "pushmi/o/just.h"
 #include "pushmi/o/defer.h"
 #include "pushmi/o/on.h"
@@ -16,16 +21,25 @@
 #include "pushmi/o/from.h"
 #include "pushmi/o/for_each.h"
 
+#include "pushmi/inline.h"
 #include "pushmi/trampoline.h"
 #include "pushmi/new_thread.h"
 #include "pushmi/time_source.h"
 
 #include "pushmi/receiver.h"
 #include "pushmi/entangle.h"
+#include "pushmi/stop_token.h"
 
+#if __has_include(<experimental/thread_pool>)
+#define PUSHMI_BENCH_HAS_POOL 1
 #include "pool.h"
+#else
+#define PUSHMI_BENCH_HAS_POOL 0
+#endif
 
 using namespace pushmi::aliases;
+// the senders and executors defined here are not in namespace pushmi
+using pushmi::operator|;
 
 template<class R>
 struct countdown {
@@ -41,23 +55,17 @@ struct countdown {
   template <class E>
   void error(E e) {std::abort();}
   void done() {}
-  PUSHMI_TEMPLATE (class Up)
-    (requires mi::Invocable<decltype(mi::set_value), Up, std::ptrdiff_t>)
+  template <class Up>
   void starting(Up up) {
     mi::set_value(up, 1);
   }
-  PUSHMI_TEMPLATE (class Up)
-    (requires mi::True<> && mi::Invocable<decltype(mi::set_value), Up>)
-  void starting(Up up) volatile {
-    mi::set_value(up);
-  }
 };
 
 template<class R>
 template <class ExecutorRef>
 void countdown<R>::value(ExecutorRef exec) {
   if (--*counter >= 0) {
-    exec | op::submit(R{}(*this));
+    exec | op::schedule() | op::submit(R{}(*this));
   }
 }
 
@@ -66,24 +74,22 @@ using countdownflowsingle = countdown<decltype(mi::make_flow_receiver)>;
 using countdownmany = countdown<decltype(mi::make_receiver)>;
 using countdownflowmany = countdown<decltype(mi::make_flow_receiver)>;
 
-struct inline_time_executor {
-    using properties = mi::property_set<mi::is_time<>, mi::is_executor<>, mi::is_fifo_sequence<>, mi::is_always_blocking<>, mi::is_single<>>;
-
-    std::chrono::system_clock::time_point top() { return std::chrono::system_clock::now(); }
-    auto executor() { return *this; }
-    template<class Out>
-    void submit(std::chrono::system_clock::time_point at, Out out) {
-      std::this_thread::sleep_until(at);
-      ::mi::set_value(out, *this);
-    }
+// the senders below deliver this executor, scheduling on it returns the
+// sender again.
+template<class Sender>
+struct inline_executor_of {
+    using properties = mi::property_set<mi::is_executor<>, mi::is_fifo_sequence<>>;
+    Sender s;
+    Sender schedule() { return s; }
 };
+template<class Sender>
+inline_executor_of<Sender> executor_of(Sender s) { return {s}; }
 
 struct inline_executor {
     using properties = mi::property_set<mi::is_sender<>, mi::is_fifo_sequence<>, mi::is_always_blocking<>, mi::is_single<>>;
-    auto executor() { return inline_time_executor{}; }
     template<class Out>
     void submit(Out out) {
-      ::mi::set_value(out, *this);
+      ::mi::set_value(out, executor_of(*this));
     }
 };
 
@@ -92,7 +98,6 @@ struct inline_executor_flow_single {
     CancellationFactory cf;
 
     using properties = mi::property_set<mi::is_sender<>, mi::is_flow<>, mi::is_fifo_sequence<>, mi::is_maybe_blocking<>, mi::is_single<>>;
-    auto executor() { return inline_time_executor{}; }
     template<class Out>
     void submit(Out out) {
 
@@ -103,9 +108,9 @@ struct inline_executor_flow_single {
         explicit Data(Stopper stopper) : stopper(std::move(stopper)) {}
         Stopper stopper;
       };
-      auto up = mi::MAKE(receiver)(
+      auto up = mi::make_receiver(
           Data{std::move(tokens.second)},
-          [](auto& data) {
+          [](auto& data, std::ptrdiff_t) {
           },
           [](auto& data, auto e) noexcept {
             auto both = lock_both(data.stopper);
@@ -121,7 +126,7 @@ struct inline_executor_flow_single {
 
     auto both = lock_both(tokens.first);
     if (!!both.first && !*(both.first)) {
-      ::mi::set_value(out, *this);
+      ::mi::set_value(out, executor_of(*this));
     } else {
       // cancellation is not an error
       ::mi::set_done(out);
@@ -157,15 +162,33 @@ struct entangled_cancellation_factory{
 };
 using inline_executor_flow_single_entangled = inline_executor_flow_single<entangled_cancellation_factory>;
 
+struct inline_executor_flow_single_stop_token {
+    using properties = mi::property_set<mi::is_sender<>, mi::is_flow<>, mi::is_fifo_sequence<>, mi::is_maybe_blocking<>, mi::is_single<>>;
+    template<class Out>
+    void submit(Out out) {
+      mi::stop_source source;
+      auto token = source.get_token();
+
+      // pass reference for cancellation.
+      ::mi::set_starting(out, std::move(source));
+
+      if (!token.stop_requested()) {
+        ::mi::set_value(out, executor_of(*this));
+      } else {
+        // cancellation is not an error
+        ::mi::set_done(out);
+      }
+    }
+};
+
 struct inline_executor_flow_single_ignore {
     using properties = mi::property_set<mi::is_sender<>, mi::is_flow<>, mi::is_fifo_sequence<>, mi::is_maybe_blocking<>, mi::is_single<>>;
-    auto executor() { return inline_time_executor{}; }
     template<class Out>
     void submit(Out out) {
       // pass reference for cancellation.
       ::mi::set_starting(out, mi::receiver<>{});
 
-      ::mi::set_value(out, *this);
+      ::mi::set_value(out, executor_of(*this));
     }
 };
 
@@ -179,7 +202,6 @@ struct inline_executor_flow_many {
 
   using properties = mi::property_set<mi::is_sender<>, mi::is_flow<>, mi::is_fifo_sequence<>, mi::is_maybe_blocking<>, mi::is_many<>>;
 
-  auto executor() { return inline_time_executor{}; }
   template<class Out>
   void submit(Out out) {
 
@@ -196,13 +218,13 @@ struct inline_executor_flow_many {
       std::shared_ptr<producer> p;
     };
 
-    auto up = mi::MAKE(receiver)(
+    auto up = mi::make_receiver(
         Data{p},
         [counter = this->counter](auto& data, auto requested) {
           if (requested < 1) {return;}
           // this is re-entrant
           while (!data.p->stop && --requested >= 0 && (!counter || --*counter >= 0)) {
-            ::mi::set_value(data.p->out, !!counter ? inline_executor_flow_many{*counter} : inline_executor_flow_many{});
+            ::mi::set_value(data.p->out, executor_of(!!counter ? inline_executor_flow_many{*counter} : inline_executor_flow_many{}));
           }
           if (!counter || *counter == 0) {
             ::mi::set_done(data.p->out);
@@ -224,13 +246,12 @@ struct inline_executor_flow_many {
 
 struct inline_executor_flow_many_ignore {
     using properties = mi::property_set<mi::is_sender<>, mi::is_flow<>, mi::is_fifo_sequence<>, mi::is_always_blocking<>, mi::is_many<>>;
-    auto executor() { return inline_time_executor{}; }
     template<class Out>
     void submit(Out out) {
       // pass reference for cancellation.
       ::mi::set_starting(out, mi::receiver<>{});
 
-      ::mi::set_value(out, *this);
+      ::mi::set_value(out, executor_of(*this));
 
       ::mi::set_done(out);
     }
@@ -238,10 +259,9 @@ struct inline_executor_flow_many_ignore {
 
 struct inline_executor_many {
     using properties = mi::property_set<mi::is_sender<>, mi::is_fifo_sequence<>, mi::is_always_blocking<>, mi::is_many<>>;
-    auto executor() { return inline_time_executor{}; }
     template<class Out>
     void submit(Out out) {
-      ::mi::set_value(out, *this);
+      ::mi::set_value(out, executor_of(*this));
       ::mi::set_done(out);
     }
 };
@@ -287,12 +307,12 @@ NONIUS_BENCHMARK("inline 1'000 single", [](nonius::chronometer meter){
 
 NONIUS_BENCHMARK("inline 1'000 time single", [](nonius::chronometer meter){
   std::atomic<int> counter{0};
-  auto ie = inline_time_executor{};
+  auto ie = mi::inline_time_executor();
   using IE = decltype(ie);
   countdownsingle single{counter};
   meter.measure([&]{
     counter.store(1'000);
-    ie | op::submit(mi::make_receiver(single));
+    ie | op::schedule() | op::submit(mi::make_receiver(single));
     while(counter.load() > 0);
     return counter.load();
   });
@@ -337,6 +357,46 @@ NONIUS_BENCHMARK("inline 1'000 flow_single entangle", [](nonius::chronometer met
   });
 })
 
+NONIUS_BENCHMARK("inline 1'000 flow_single stop_token", [](nonius::chronometer meter){
+  std::atomic<int> counter{0};
+  auto ie = inline_executor_flow_single_stop_token{};
+  using IE = decltype(ie);
+  countdownflowsingle flowsingle{counter};
+  meter.measure([&]{
+    counter.store(1'000);
+    ie | op::submit(mi::make_flow_receiver(flowsingle));
+    while(counter.load() > 0);
+    return counter.load();
+  });
+})
+
+NONIUS_BENCHMARK("entangle lock_both 2x oversubscribed 1'000", [](nonius::chronometer meter){
+  // two threads per core contend for each entangled pair
+  const int pairs = std::max(1u, std::thread::hardware_concurrency());
+  using Pair = decltype(mi::entangle(0, 0));
+  std::vector<std::unique_ptr<Pair>> entangled;
+  for (int p = 0; p < pairs; ++p) {
+    entangled.push_back(std::make_unique<Pair>(mi::entangle(0, 0)));
+  }
+  auto run = [](auto& side) {
+    for (int i = 0; i < 1'000; ++i) {
+      auto both = lock_both(side);
+      ++*both.first;
+    }
+  };
+  meter.measure([&]{
+    std::vector<std::thread> threads;
+    for (auto& e : entangled) {
+      threads.emplace_back([&, p = e.get()]{ run(p->first); });
+      threads.emplace_back([&, p = e.get()]{ run(p->second); });
+    }
+    for (auto& t : threads) {
+      t.join();
+    }
+    return entangled.front()->first.t;
+  });
+})
+
 NONIUS_BENCHMARK("inline 1'000 flow_single ignore cancellation", [](nonius::chronometer meter){
   std::atomic<int> counter{0};
   auto ie = inline_executor_flow_single_ignore{};
@@ -409,7 +469,7 @@ NONIUS_BENCHMARK("trampoline 1'000 single get (blocking_submit)", [](nonius::chr
   meter.measure([&]{
     counter = 1'000;
     while (--counter >=0) {
-      auto fortyTwo = tr | op::transform([](auto){return 42;}) | op::get<int>;
+      auto fortyTwo = tr | op::schedule() | op::transform([](auto){return 42;}) | op::get<int>;
     }
     return counter;
   });
@@ -422,7 +482,7 @@ NONIUS_BENCHMARK("trampoline static derecursion 1'000", [](nonius::chronometer m
   countdownsingle single{counter};
   meter.measure([&]{
     counter.store(1'000);
-    tr | op::submit(single);
+    tr | op::schedule() | op::submit(single);
     while(counter.load() > 0);
     return counter.load();
   });
@@ -436,7 +496,7 @@ NONIUS_BENCHMARK("trampoline virtual derecursion 1'000", [](nonius::chronometer
   std::function<void(mi::any_executor_ref<>)> recurse{[&](auto exec){::pushmi::set_value(single, exec);}};
   meter.measure([&]{
     counter.store(1'000);
-    tr | op::submit([&](auto exec) { recurse(exec); });
+    tr | op::schedule() | op::submit([&](auto exec) { recurse(exec); });
     while(counter.load() > 0);
     return counter.load();
   });
@@ -459,6 +519,7 @@ NONIUS_BENCHMARK("trampoline flow_many_sender 1'000", [](nonius::chronometer met
   });
 })
 
+#if PUSHMI_BENCH_HAS_POOL
 NONIUS_BENCHMARK("pool{1} submit 1'000", [](nonius::chronometer meter){
   mi::pool pl{std::max(1u,std::thread::hardware_concurrency())};
   auto pe = pl.executor();
@@ -467,7 +528,7 @@ NONIUS_BENCHMARK("pool{1} submit 1'000", [](nonius::chronometer meter){
   countdownsingle single{counter};
   meter.measure([&]{
     counter.store(1'000);
-    pe | op::submit(single);
+    pe | op::schedule() | op::submit(single);
     while(counter.load() > 0);
     return counter.load();
   });
@@ -481,12 +542,14 @@ NONIUS_BENCHMARK("pool{hardware_concurrency} submit 1'000", [](nonius::chronomet
   countdownsingle single{counter};
   meter.measure([&]{
     counter.store(1'000);
-    pe | op::submit(single);
+    pe | op::schedule() | op::submit(single);
     while(counter.load() > 0);
     return counter.load();
   });
 })
 
+#endif
+
 NONIUS_BENCHMARK("new thread submit 1'000", [](nonius::chronometer meter){
   auto nt = mi::new_thread();
   using NT = decltype(nt);
@@ -494,7 +557,7 @@ NONIUS_BENCHMARK("new thread submit 1'000", [](nonius::chronometer meter){
   countdownsingle single{counter};
   meter.measure([&]{
     counter.store(1'000);
-    nt | op::submit(single);
+    nt | op::schedule() | op::submit(single);
     while(counter.load() > 0);
     return counter.load();
   });
@@ -507,7 +570,7 @@ NONIUS_BENCHMARK("new thread blocking_submit 1'000", [](nonius::chronometer mete
   countdownsingle single{counter};
   meter.measure([&]{
     counter.store(1'000);
-    nt | op::blocking_submit(single);
+    nt | op::schedule() | op::blocking_submit(single);
     return counter.load();
   });
 })
@@ -516,13 +579,14 @@ NONIUS_BENCHMARK("new thread + time submit 1'000", [](nonius::chronometer meter)
   auto nt = mi::new_thread();
   using NT = decltype(nt);
   auto time = mi::time_source<>{};
-  auto tnt = time.make(mi::systemNowF{}, [nt](){ return nt; })();
+  auto strands = time.make(mi::systemNowF{}, nt);
+  auto tnt = mi::make_strand(strands);
   using TNT = decltype(tnt);
   std::atomic<int> counter{0};
   countdownsingle single{counter};
   meter.measure([&]{
     counter.store(1'000);
-    tnt | op::submit(single);
+    tnt | op::schedule() | op::submit(single);
     while(counter.load() > 0);
     return counter.load();
   });
@@ -0,0 +1,88 @@
+// Copyright (c) 2018-present, Facebook, Inc.
+//
+// This source code is licensed under the MIT license found in the
+// LICENSE file in the root directory of this source tree.
+
+#include <cstdlib>
+#include <new>
+
+#include "allocations.h"
+
+namespace bench {
+namespace detail {
+
+// constant initialized, so it is ready for allocations made by the static
+// initializers of other translation units
+allocation_state allocations;
+
+namespace {
+
+void* allocate(std::size_t size) noexcept {
+  if (allocations.counting.load(std::memory_order_relaxed)) {
+    allocations.allocations.fetch_add(1, std::memory_order_relaxed);
+    allocations.bytes.fetch_add(size, std::memory_order_relaxed);
+  }
+  for (;;) {
+    if (void* p = std::malloc(size == 0 ? 1 : size)) {
+      return p;
+    }
+    auto handler = std::get_new_handler();
+    if (handler == nullptr) {
+      return nullptr;
+    }
+    handler();
+  }
+}
+
+void* allocate_or_throw(std::size_t size) {
+  if (void* p = allocate(size)) {
+    return p;
+  }
+  throw std::bad_alloc{};
+}
+
+void deallocate(void* p) noexcept {
+  if (p == nullptr) {
+    return;
+  }
+  if (allocations.counting.load(std::memory_order_relaxed)) {
+    allocations.deallocations.fetch_add(1, std::memory_order_relaxed);
+  }
+  std::free(p);
+}
+
+} // namespace
+} // namespace detail
+} // namespace bench
+
+void* operator new(std::size_t size) {
+  return bench::detail::allocate_or_throw(size);
+}
+void* operator new[](std::size_t size) {
+  return bench::detail::allocate_or_throw(size);
+}
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept {
+  return bench::detail::allocate(size);
+}
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept {
+  return bench::detail::allocate(size);
+}
+
+void operator delete(void* p) noexcept {
+  bench::detail::deallocate(p);
+}
+void operator delete[](void* p) noexcept {
+  bench::detail::deallocate(p);
+}
+void operator delete(void* p, std::size_t) noexcept {
+  bench::detail::deallocate(p);
+}
+void operator delete[](void* p, std::size_t) noexcept {
+  bench::detail::deallocate(p);
+}
+void operator delete(void* p, const std::nothrow_t&) noexcept {
+  bench::detail::deallocate(p);
+}
+void operator delete[](void* p, const std::nothrow_t&) noexcept {
+  bench::detail::deallocate(p);
+}
@@ -0,0 +1,54 @@
+// Copyright (c) 2018-present, Facebook, Inc.
+//
+// This source code is licensed under the MIT license found in the
+// LICENSE file in the root directory of this source tree.
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+//
+// allocations.cpp replaces the global operator new and operator delete. while
+// counting is on they count the allocations made on every thread, otherwise
+// they cost one relaxed load on top of malloc and free.
+//
+
+namespace bench {
+
+struct allocation_counts {
+  std::uint64_t allocations = 0;
+  std::uint64_t bytes = 0;
+  std::uint64_t deallocations = 0;
+};
+
+namespace detail {
+struct allocation_state {
+  std::atomic<bool> counting{false};
+  std::atomic<std::uint64_t> allocations{0};
+  std::atomic<std::uint64_t> bytes{0};
+  std::atomic<std::uint64_t> deallocations{0};
+};
+// defined in allocations.cpp
+extern allocation_state allocations;
+} // namespace detail
+
+inline void start_counting_allocations() {
+  auto& s = detail::allocations;
+  s.allocations.store(0, std::memory_order_relaxed);
+  s.bytes.store(0, std::memory_order_relaxed);
+  s.deallocations.store(0, std::memory_order_relaxed);
+  s.counting.store(true, std::memory_order_release);
+}
+
+inline allocation_counts stop_counting_allocations() {
+  auto& s = detail::allocations;
+  s.counting.store(false, std::memory_order_release);
+  allocation_counts counts;
+  counts.allocations = s.allocations.load(std::memory_order_relaxed);
+  counts.bytes = s.bytes.load(std::memory_order_relaxed);
+  counts.deallocations = s.deallocations.load(std::memory_order_relaxed);
+  return counts;
+}
+
+} // namespace bench
@@ -0,0 +1,277 @@
+// Copyright (c) 2018-present, Facebook, Inc.
+//
+// This source code is licensed under the MIT license found in the
+// LICENSE file in the root directory of this source tree.
+
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <functional>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "allocations.h"
+#include "perf_counters.h"
+
+//
+// a self-contained benchmark driver that needs nothing beyond the standard
+// library. the interface is the subset of nonius that the pushmi benchmarks
+// use, so the same benchmark sources build with either.
+//
+// each benchmark is sampled a number of times. every sample calls the
+// benchmark with a chronometer that times, and reads the hardware counters
+// around, runs() calls of the function passed to measure(). the results are
+// reported per run of that function.
+//
+
+namespace bench {
+
+using clock = std::chrono::steady_clock;
+
+// one sample of one benchmark
+struct measurement {
+  int runs = 0;
+  std::chrono::nanoseconds elapsed{0};
+  counter_values counters;
+  allocation_counts allocations;
+};
+
+namespace detail {
+// keeps the compiler from discarding the result of a measured function
+template <class T>
+void keep(T&& value) {
+#if defined(__GNUC__)
+  asm volatile("" : : "r,m"(value) : "memory");
+#else
+  static volatile const void* sink;
+  sink = &value;
+#endif
+}
+template <class Fun>
+void invoke(Fun& fun, int i, std::true_type) {
+  fun(i);
+}
+template <class Fun>
+void invoke(Fun& fun, int i, std::false_type) {
+  keep(fun(i));
+}
+
+template <class Fun, class = void>
+struct takes_run_index : std::false_type {};
+template <class Fun>
+struct takes_run_index<
+    Fun,
+    decltype((void)std::declval<Fun&>()(std::declval<int>()))>
+    : std::true_type {};
+} // namespace detail
+
+class chronometer {
+  int runs_;
+  perf_counters* counters_;
+  measurement* result_;
+  bool count_allocations_;
+
+  template <class Fun>
+  void measure(Fun& fun, std::true_type) {
+    if (counters_ != nullptr) {
+      counters_->start();
+    }
+    if (count_allocations_) {
+      start_counting_allocations();
+    }
+    auto started = clock::now();
+    using returns_void = std::is_void<decltype(fun(0))>;
+    for (int i = 0; i < runs_; ++i) {
+      detail::invoke(fun, i, returns_void{});
+    }
+    auto finished = clock::now();
+    if (count_allocations_) {
+      result_->allocations = stop_counting_allocations();
+    }
+    if (counters_ != nullptr) {
+      result_->counters = counters_->stop();
+    }
+    result_->runs = runs_;
+    result_->elapsed =
+        std::chrono::duration_cast<std::chrono::nanoseconds>(
+            finished - started);
+  }
+  template <class Fun>
+  void measure(Fun& fun, std::false_type) {
+    auto indexed = [&fun](int) -> decltype(auto) { return fun(); };
+    measure(indexed, std::true_type{});
+  }
+
+ public:
+  chronometer(
+      int runs,
+      perf_counters* counters,
+      measurement* result,
+      bool count_allocations = false)
+      : runs_(runs),
+        counters_(counters),
+        result_(result),
+        count_allocations_(count_allocations) {}
+
+  int runs() const {
+    return runs_;
+  }
+
+  template <class Fun>
+  void measure(Fun&& fun) {
+    measure(fun, detail::takes_run_index<Fun>{});
+  }
+};
+
+struct benchmark {
+  std::string name;
+  std::function<void(chronometer)> fn;
+};
+
+inline std::vector<benchmark>& registry() {
+  static std::vector<benchmark> benchmarks;
+  return benchmarks;
+}
+
+struct registrar {
+  // a benchmark either takes a chronometer, or is itself the function to
+  // measure.
+  template <class Fun>
+  registrar(std::string name, Fun fun) {
+    registry().push_back(
+        {std::move(name),
+         wrap(std::move(fun), std::is_constructible<
+                                  std::function<void(chronometer)>,
+                                  Fun>{})});
+  }
+
+ private:
+  template <class Fun>
+  static std::function<void(chronometer)> wrap(Fun fun, std::true_type) {
+    return fun;
+  }
+  template <class Fun>
+  static std::function<void(chronometer)> wrap(Fun fun, std::false_type) {
+    return [fun](chronometer meter) { meter.measure(fun); };
+  }
+};
+
+struct options {
+  // the number of samples of each benchmark
+  int samples = 20;
+  // the number of runs in a sample is chosen so that a sample takes at least
+  // this long
+  std::chrono::nanoseconds sample_time = std::chrono::milliseconds(10);
+  // read the hardware counters
+  bool counters = true;
+  // only benchmarks with a name that contains the filter are run
+  std::string filter;
+};
+
+// the samples of one benchmark, reported per run
+struct result {
+  std::string name;
+  int runs = 0;
+  std::vector<double> ns;
+  counter_values counters;
+
+  double mean() const {
+    double sum = 0.0;
+    for (double n : ns) {
+      sum += n;
+    }
+    return ns.empty() ? 0.0 : sum / ns.size();
+  }
+  double median() const {
+    if (ns.empty()) {
+      return 0.0;
+    }
+    auto sorted = ns;
+    std::sort(sorted.begin(), sorted.end());
+    auto mid = sorted.size() / 2;
+    return sorted.size() % 2 != 0 ? sorted[mid]
+                                   : (sorted[mid - 1] + sorted[mid]) / 2.0;
+  }
+  double stddev() const {
+    if (ns.size() < 2) {
+      return 0.0;
+    }
+    double m = mean();
+    double sum = 0.0;
+    for (double n : ns) {
+      sum += (n - m) * (n - m);
+    }
+    return std::sqrt(sum / (ns.size() - 1));
+  }
+};
+
+inline measurement sample(
+    const benchmark& b,
+    int runs,
+    perf_counters* pc,
+    bool count_allocations = false) {
+  measurement m;
+  b.fn(chronometer{runs, pc, &m, count_allocations});
+  if (m.runs == 0) {
+    throw std::logic_error(
+        "benchmark '" + b.name + "' did not call chronometer::measure()");
+  }
+  return m;
+}
+
+inline result run(const benchmark& b, const options& opts, perf_counters* pc) {
+  // warm up and find the number of runs that fills a sample
+  const int max_runs = 1 << 24;
+  int runs = 1;
+  for (;;) {
+    auto m = sample(b, runs, nullptr);
+    if (m.elapsed >= opts.sample_time || runs >= max_runs) {
+      break;
+    }
+    auto grow = m.elapsed.count() > 0
+        ? static_cast<double>(opts.sample_time.count()) / m.elapsed.count()
+        : 100.0;
+    runs = static_cast<int>(std::min<double>(
+        runs * std::min(std::max(grow * 1.1, 2.0), 100.0), max_runs));
+  }
+
+  result r;
+  r.name = b.name;
+  r.runs = runs;
+  r.counters.available.fill(true);
+  for (int s = 0; s < opts.samples; ++s) {
+    auto m = sample(b, runs, opts.counters ? pc : nullptr);
+    r.ns.push_back(static_cast<double>(m.elapsed.count()) / m.runs);
+    for (int c = 0; c < counter_count; ++c) {
+      r.counters.available[c] =
+          r.counters.available[c] && m.counters.available[c];
+      r.counters.value[c] += m.counters.value[c] / m.runs / opts.samples;
+    }
+  }
+  return r;
+}
+
+// counts the allocations made, on any thread, while the measured function
+// runs. the first sample is not counted, so that allocations made once, on
+// first use, do not show up.
+inline allocation_counts count_allocations(const benchmark& b, int runs) {
+  sample(b, 1, nullptr);
+  return sample(b, runs, nullptr, true).allocations;
+}
+
+} // namespace bench
+
+#define PUSHMI_BENCH_CAT_(A, B) A##B
+#define PUSHMI_BENCH_CAT(A, B) PUSHMI_BENCH_CAT_(A, B)
+
+// registers a benchmark, used as nonius uses NONIUS_BENCHMARK
+#define PUSHMI_BENCHMARK(NAME, ...)                                        \
+  namespace {                                                              \
+  static ::bench::registrar PUSHMI_BENCH_CAT(pushmi_bench_registrar_,      \
+                                             __LINE__){NAME, __VA_ARGS__}; \
+  }
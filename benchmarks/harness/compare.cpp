@@ -0,0 +1,302 @@
+// Copyright (c) 2018-present, Facebook, Inc.
+//
+// This source code is licensed under the MIT license found in the
+// LICENSE file in the root directory of this source tree.
+
+//
+// compares two result files written by PushmiBench --json. the samples of
+// each timed benchmark are compared with Welch's t-test, a benchmark has
+// regressed when it is significantly slower by more than the threshold.
+// allocations per op regress when they grow by more than the threshold.
+// latency percentiles are only reported, they have no samples to test.
+//
+// exits with 1 when any benchmark regressed and 2 when the files cannot be
+// read.
+//
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "json.h"
+
+namespace {
+
+void usage(const char* self) {
+  std::printf(
+      "usage: %s [options] <baseline.json> <candidate.json>\n"
+      "  --threshold <percent>  the change that counts as a regression\n"
+      "                         (default 5)\n"
+      "  --alpha <p>            the significance level of the t-test\n"
+      "                         (default 0.01)\n",
+      self);
+}
+
+bench::json::value load(const std::string& path) {
+  std::ifstream in{path};
+  if (!in) {
+    throw std::runtime_error("could not read " + path);
+  }
+  std::stringstream text;
+  text << in.rdbuf();
+  return bench::json::parse(text.str());
+}
+
+// the continued fraction of the regularized incomplete beta function
+double beta_fraction(double a, double b, double x) {
+  const double tiny = 1e-300;
+  const double epsilon = 1e-14;
+  double c = 1.0;
+  double d = 1.0 - (a + b) * x / (a + 1.0);
+  d = 1.0 / (std::abs(d) < tiny ? tiny : d);
+  double f = d;
+  for (int m = 1; m <= 300; ++m) {
+    double m2 = 2.0 * m;
+    double numerator = m * (b - m) * x / ((a + m2 - 1.0) * (a + m2));
+    d = 1.0 + numerator * d;
+    d = 1.0 / (std::abs(d) < tiny ? tiny : d);
+    c = 1.0 + numerator / c;
+    c = std::abs(c) < tiny ? tiny : c;
+    f *= c * d;
+    numerator = -(a + m) * (a + b + m) * x / ((a + m2) * (a + m2 + 1.0));
+    d = 1.0 + numerator * d;
+    d = 1.0 / (std::abs(d) < tiny ? tiny : d);
+    c = 1.0 + numerator / c;
+    c = std::abs(c) < tiny ? tiny : c;
+    double delta = c * d;
+    f *= delta;
+    if (std::abs(delta - 1.0) < epsilon) {
+      break;
+    }
+  }
+  return f;
+}
+
+// the regularized incomplete beta function I_x(a, b)
+double incomplete_beta(double a, double b, double x) {
+  if (x <= 0.0) {
+    return 0.0;
+  }
+  if (x >= 1.0) {
+    return 1.0;
+  }
+  double front = std::exp(
+      std::lgamma(a + b) - std::lgamma(a) - std::lgamma(b) + a * std::log(x) +
+      b * std::log(1.0 - x));
+  if (x < (a + 1.0) / (a + b + 2.0)) {
+    return front * beta_fraction(a, b, x) / a;
+  }
+  return 1.0 - front * beta_fraction(b, a, 1.0 - x) / b;
+}
+
+struct summary {
+  double n = 0.0;
+  double mean = 0.0;
+  double variance = 0.0;
+};
+
+summary summarize(const std::vector<double>& samples) {
+  summary s;
+  s.n = static_cast<double>(samples.size());
+  for (double x : samples) {
+    s.mean += x;
+  }
+  s.mean /= std::max(s.n, 1.0);
+  for (double x : samples) {
+    s.variance += (x - s.mean) * (x - s.mean);
+  }
+  s.variance /= std::max(s.n - 1.0, 1.0);
+  return s;
+}
+
+// the two-sided p-value of Welch's t-test that the means are the same
+double welch_p_value(const summary& a, const summary& b) {
+  if (a.n < 2.0 || b.n < 2.0) {
+    return 1.0;
+  }
+  double va = a.variance / a.n;
+  double vb = b.variance / b.n;
+  if (va + vb == 0.0) {
+    return a.mean == b.mean ? 1.0 : 0.0;
+  }
+  double t = (b.mean - a.mean) / std::sqrt(va + vb);
+  double df =
+      (va + vb) * (va + vb) / (va * va / (a.n - 1.0) + vb * vb / (b.n - 1.0));
+  return incomplete_beta(df / 2.0, 0.5, df / (df + t * t));
+}
+
+std::vector<double> samples_of(const bench::json::value& benchmark) {
+  std::vector<double> samples;
+  if (auto s = benchmark.find("samples_ns")) {
+    for (auto& x : s->items()) {
+      samples.push_back(x.as_number());
+    }
+  }
+  return samples;
+}
+
+const bench::json::value* find_benchmark(
+    const bench::json::value& results,
+    const std::string& name,
+    const std::string& kind) {
+  if (auto list = results.find("benchmarks")) {
+    for (auto& b : list->items()) {
+      if (b.string_or("name", "") == name && b.string_or("kind", "") == kind) {
+        return &b;
+      }
+    }
+  }
+  return nullptr;
+}
+
+double change(double baseline, double candidate) {
+  if (baseline == 0.0) {
+    return candidate == 0.0 ? 0.0 : std::numeric_limits<double>::infinity();
+  }
+  return 100.0 * (candidate - baseline) / baseline;
+}
+
+void print_context(const char* label, const bench::json::value& results) {
+  auto context = results.find("context");
+  if (context == nullptr) {
+    return;
+  }
+  std::printf(
+      "%s: %s, %s, %s\n",
+      label,
+      context->string_or("date", "?").c_str(),
+      context->string_or("compiler", "?").c_str(),
+      context->string_or("command", "?").c_str());
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+  double threshold = 5.0;
+  double alpha = 0.01;
+  std::vector<std::string> paths;
+  for (int i = 1; i < argc; ++i) {
+    auto arg = std::string(argv[i]);
+    auto next = [&]() -> const char* {
+      if (i + 1 >= argc) {
+        usage(argv[0]);
+        std::exit(2);
+      }
+      return argv[++i];
+    };
+    if (arg == "--threshold") {
+      threshold = std::atof(next());
+    } else if (arg == "--alpha") {
+      alpha = std::atof(next());
+    } else if (arg == "--help") {
+      usage(argv[0]);
+      return 0;
+    } else if (!arg.empty() && arg[0] == '-') {
+      usage(argv[0]);
+      return 2;
+    } else {
+      paths.push_back(arg);
+    }
+  }
+  if (paths.size() != 2) {
+    usage(argv[0]);
+    return 2;
+  }
+
+  bench::json::value baseline;
+  bench::json::value candidate;
+  try {
+    baseline = load(paths[0]);
+    candidate = load(paths[1]);
+  } catch (const std::exception& e) {
+    std::fprintf(stderr, "%s\n", e.what());
+    return 2;
+  }
+
+  print_context("baseline ", baseline);
+  print_context("candidate", candidate);
+  std::printf(
+      "regression: slower by more than %.1f%% with p < %g\n\n",
+      threshold,
+      alpha);
+
+  int regressions = 0;
+  auto list = candidate.find("benchmarks");
+  if (list == nullptr) {
+    std::fprintf(stderr, "%s has no benchmarks\n", paths[1].c_str());
+    return 2;
+  }
+  for (auto& c : list->items()) {
+    auto name = c.string_or("name", "");
+    auto kind = c.string_or("kind", "");
+    auto b = find_benchmark(baseline, name, kind);
+    if (b == nullptr) {
+      std::printf("%s\n  new\n", name.c_str());
+      continue;
+    }
+    std::printf("%s\n", name.c_str());
+    if (kind == "time") {
+      auto before = summarize(samples_of(*b));
+      auto after = summarize(samples_of(c));
+      auto p = welch_p_value(before, after);
+      auto delta = change(before.mean, after.mean);
+      bool significant = p < alpha;
+      bool regressed = significant && delta > threshold;
+      regressions += regressed ? 1 : 0;
+      std::printf(
+          "  mean %.1f ns -> %.1f ns  %+.1f%%  p %.3g  %s\n",
+          before.mean,
+          after.mean,
+          delta,
+          p,
+          regressed ? "REGRESSION"
+                    : !significant ? "no significant change"
+                                   : delta < 0.0 ? "faster" : "within threshold");
+    } else if (kind == "allocations") {
+      auto before = b->number_or("allocations_per_op", 0.0);
+      auto after = c.number_or("allocations_per_op", 0.0);
+      // a small absolute slack keeps allocations made by other threads while
+      // counting from failing a benchmark that does not allocate
+      bool regressed = after > before * (1.0 + threshold / 100.0) + 0.01;
+      regressions += regressed ? 1 : 0;
+      std::printf(
+          "  allocations per op %.3f -> %.3f  bytes per op %.1f -> %.1f  %s\n",
+          before,
+          after,
+          b->number_or("bytes_per_op", 0.0),
+          c.number_or("bytes_per_op", 0.0),
+          regressed ? "REGRESSION" : "");
+    } else if (kind == "latency") {
+      auto corrected = [](const bench::json::value& v, const char* p) {
+        auto h = v.find("corrected_ns");
+        return h != nullptr ? h->number_or(p, 0.0) : 0.0;
+      };
+      for (auto p : {"p50", "p99", "p99.9"}) {
+        std::printf(
+            "  %-5s %.0f ns -> %.0f ns  %+.1f%%\n",
+            p,
+            corrected(*b, p),
+            corrected(c, p),
+            change(corrected(*b, p), corrected(c, p)));
+      }
+    }
+  }
+  if (auto before = baseline.find("benchmarks")) {
+    for (auto& b : before->items()) {
+      auto name = b.string_or("name", "");
+      if (find_benchmark(candidate, name, b.string_or("kind", "")) == nullptr) {
+        std::printf("%s\n  missing from the candidate\n", name.c_str());
+      }
+    }
+  }
+
+  std::printf("\n%d regression%s\n", regressions, regressions == 1 ? "" : "s");
+  return regressions > 0 ? 1 : 0;
+}
@@ -0,0 +1,109 @@
+// Copyright (c) 2018-present, Facebook, Inc.
+//
+// This source code is licensed under the MIT license found in the
+// LICENSE file in the root directory of this source tree.
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+namespace bench {
+
+//
+// histogram counts values in log-linear buckets, as HdrHistogram does. each
+// power of two is split into the same number of linear sub-buckets, so every
+// value is kept to about three significant digits whatever its magnitude,
+// from nanoseconds to hours, in a fixed amount of memory.
+//
+class histogram {
+  static constexpr int sub_bits = 11;
+  static constexpr std::uint64_t sub_count = std::uint64_t{1} << sub_bits;
+  static constexpr std::uint64_t half_count = sub_count / 2;
+  static constexpr std::size_t bucket_count =
+      (64 - sub_bits + 1) * half_count + half_count;
+
+  std::vector<std::uint64_t> counts_;
+  std::uint64_t total_ = 0;
+  std::uint64_t min_ = std::numeric_limits<std::uint64_t>::max();
+  std::uint64_t max_ = 0;
+  double sum_ = 0.0;
+
+  static int msb(std::uint64_t v) {
+#if defined(__GNUC__)
+    return 63 - __builtin_clzll(v);
+#else
+    int r = 0;
+    while (v >>= 1) {
+      ++r;
+    }
+    return r;
+#endif
+  }
+
+  static std::size_t index_of(std::uint64_t v) {
+    if (v < sub_count) {
+      return static_cast<std::size_t>(v);
+    }
+    int shift = msb(v) - (sub_bits - 1);
+    return static_cast<std::size_t>(shift * half_count + (v >> shift));
+  }
+
+  // the largest value that is counted in the bucket
+  static std::uint64_t highest_in(std::size_t index) {
+    if (index < sub_count) {
+      return index;
+    }
+    auto shift = index / half_count - 1;
+    auto mantissa = index - shift * half_count;
+    return ((mantissa + 1) << shift) - 1;
+  }
+
+ public:
+  histogram() : counts_(bucket_count) {}
+
+  void record(std::uint64_t v, std::uint64_t n = 1) {
+    counts_[index_of(v)] += n;
+    total_ += n;
+    min_ = std::min(min_, v);
+    max_ = std::max(max_, v);
+    sum_ += static_cast<double>(v) * n;
+  }
+
+  std::uint64_t count() const {
+    return total_;
+  }
+  std::uint64_t min() const {
+    return total_ == 0 ? 0 : min_;
+  }
+  std::uint64_t max() const {
+    return max_;
+  }
+  double mean() const {
+    return total_ == 0 ? 0.0 : sum_ / total_;
+  }
+
+  // the value that percentile percent of the recorded values are at or
+  // below
+  std::uint64_t percentile(double percent) const {
+    if (total_ == 0) {
+      return 0;
+    }
+    auto target = static_cast<std::uint64_t>(
+        std::ceil(std::min(percent, 100.0) / 100.0 * total_));
+    target = std::max<std::uint64_t>(target, 1);
+    std::uint64_t seen = 0;
+    for (std::size_t i = 0; i < counts_.size(); ++i) {
+      seen += counts_[i];
+      if (seen >= target) {
+        return std::min(highest_in(i), max_);
+      }
+    }
+    return max_;
+  }
+};
+
+} // namespace bench
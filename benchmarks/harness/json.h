@@ -0,0 +1,383 @@
+// Copyright (c) 2018-present, Facebook, Inc.
+//
+// This source code is licensed under the MIT license found in the
+// LICENSE file in the root directory of this source tree.
+
+#pragma once
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+//
+// just enough json to write the benchmark results and read them back in the
+// compare tool.
+//
+
+namespace bench {
+namespace json {
+
+class value {
+ public:
+  enum kind_t { null_kind, bool_kind, number_kind, string_kind, array_kind, object_kind };
+
+  value() = default;
+  value(bool b) : kind_(bool_kind), bool_(b) {}
+  value(double n) : kind_(number_kind), number_(n) {}
+  value(int n) : value(static_cast<double>(n)) {}
+  value(long n) : value(static_cast<double>(n)) {}
+  value(long long n) : value(static_cast<double>(n)) {}
+  value(unsigned n) : value(static_cast<double>(n)) {}
+  value(unsigned long n) : value(static_cast<double>(n)) {}
+  value(unsigned long long n) : value(static_cast<double>(n)) {}
+  value(std::string s) : kind_(string_kind), string_(std::move(s)) {}
+  value(const char* s) : value(std::string(s)) {}
+
+  static value array() {
+    value v;
+    v.kind_ = array_kind;
+    return v;
+  }
+  static value object() {
+    value v;
+    v.kind_ = object_kind;
+    return v;
+  }
+
+  kind_t kind() const {
+    return kind_;
+  }
+  bool is_number() const {
+    return kind_ == number_kind;
+  }
+  bool is_string() const {
+    return kind_ == string_kind;
+  }
+  bool is_array() const {
+    return kind_ == array_kind;
+  }
+  bool is_object() const {
+    return kind_ == object_kind;
+  }
+
+  bool as_bool() const {
+    return bool_;
+  }
+  double as_number() const {
+    return number_;
+  }
+  const std::string& as_string() const {
+    return string_;
+  }
+  const std::vector<value>& items() const {
+    return items_;
+  }
+  const std::vector<std::pair<std::string, value>>& members() const {
+    return members_;
+  }
+
+  value& push(value v) {
+    items_.push_back(std::move(v));
+    return *this;
+  }
+  value& set(std::string key, value v) {
+    members_.emplace_back(std::move(key), std::move(v));
+    return *this;
+  }
+
+  // returns nullptr when this is not an object or has no member named key
+  const value* find(const std::string& key) const {
+    for (auto& m : members_) {
+      if (m.first == key) {
+        return &m.second;
+      }
+    }
+    return nullptr;
+  }
+  double number_or(const std::string& key, double otherwise) const {
+    auto v = find(key);
+    return v != nullptr && v->is_number() ? v->as_number() : otherwise;
+  }
+  std::string string_or(const std::string& key, std::string otherwise) const {
+    auto v = find(key);
+    return v != nullptr && v->is_string() ? v->as_string() : otherwise;
+  }
+
+  std::string dump(int indent = 0) const {
+    std::string out;
+    dump(out, indent, 0);
+    return out;
+  }
+
+ private:
+  kind_t kind_ = null_kind;
+  bool bool_ = false;
+  double number_ = 0.0;
+  std::string string_;
+  std::vector<value> items_;
+  std::vector<std::pair<std::string, value>> members_;
+
+  static void quote(std::string& out, const std::string& s) {
+    out += '"';
+    for (unsigned char c : s) {
+      switch (c) {
+        case '"':
+          out += "\\\"";
+          break;
+        case '\\':
+          out += "\\\\";
+          break;
+        case '\n':
+          out += "\\n";
+          break;
+        case '\t':
+          out += "\\t";
+          break;
+        default:
+          if (c < 0x20) {
+            char buf[8];
+            std::snprintf(buf, sizeof(buf), "\\u%04x", c);
+            out += buf;
+          } else {
+            out += static_cast<char>(c);
+          }
+      }
+    }
+    out += '"';
+  }
+
+  static void newline(std::string& out, int indent, int depth) {
+    if (indent > 0) {
+      out += '\n';
+      out.append(static_cast<std::size_t>(indent * depth), ' ');
+    }
+  }
+
+  void dump(std::string& out, int indent, int depth) const {
+    switch (kind_) {
+      case null_kind:
+        out += "null";
+        break;
+      case bool_kind:
+        out += bool_ ? "true" : "false";
+        break;
+      case number_kind: {
+        if (!std::isfinite(number_)) {
+          out += "null";
+          break;
+        }
+        char buf[32];
+        std::snprintf(buf, sizeof(buf), "%.17g", number_);
+        out += buf;
+        break;
+      }
+      case string_kind:
+        quote(out, string_);
+        break;
+      case array_kind:
+        out += '[';
+        for (std::size_t i = 0; i < items_.size(); ++i) {
+          out += i == 0 ? "" : ",";
+          newline(out, indent, depth + 1);
+          items_[i].dump(out, indent, depth + 1);
+        }
+        if (!items_.empty()) {
+          newline(out, indent, depth);
+        }
+        out += ']';
+        break;
+      case object_kind:
+        out += '{';
+        for (std::size_t i = 0; i < members_.size(); ++i) {
+          out += i == 0 ? "" : ",";
+          newline(out, indent, depth + 1);
+          quote(out, members_[i].first);
+          out += indent > 0 ? ": " : ":";
+          members_[i].second.dump(out, indent, depth + 1);
+        }
+        if (!members_.empty()) {
+          newline(out, indent, depth);
+        }
+        out += '}';
+        break;
+    }
+  }
+
+  friend class parser;
+};
+
+class parser {
+  const std::string& text_;
+  std::size_t at_ = 0;
+
+  [[noreturn]] void fail(const char* what) const {
+    throw std::runtime_error(
+        std::string("json: ") + what + " at offset " + std::to_string(at_));
+  }
+  void skip_space() {
+    while (at_ < text_.size() &&
+           (text_[at_] == ' ' || text_[at_] == '\t' || text_[at_] == '\n' ||
+            text_[at_] == '\r')) {
+      ++at_;
+    }
+  }
+  char peek() {
+    skip_space();
+    return at_ < text_.size() ? text_[at_] : '\0';
+  }
+  void expect(char c) {
+    if (peek() != c) {
+      fail("unexpected character");
+    }
+    ++at_;
+  }
+  bool literal(const char* word) {
+    std::string w = word;
+    if (text_.compare(at_, w.size(), w) == 0) {
+      at_ += w.size();
+      return true;
+    }
+    return false;
+  }
+
+  std::string parse_string() {
+    expect('"');
+    std::string s;
+    while (at_ < text_.size() && text_[at_] != '"') {
+      char c = text_[at_++];
+      if (c != '\\') {
+        s += c;
+        continue;
+      }
+      if (at_ >= text_.size()) {
+        fail("unterminated escape");
+      }
+      c = text_[at_++];
+      switch (c) {
+        case 'n':
+          s += '\n';
+          break;
+        case 't':
+          s += '\t';
+          break;
+        case 'r':
+          s += '\r';
+          break;
+        case 'b':
+          s += '\b';
+          break;
+        case 'f':
+          s += '\f';
+          break;
+        case 'u': {
+          if (at_ + 4 > text_.size()) {
+            fail("short unicode escape");
+          }
+          auto code = std::strtoul(text_.substr(at_, 4).c_str(), nullptr, 16);
+          at_ += 4;
+          // the results only hold ascii, anything else is kept as utf-8
+          if (code < 0x80) {
+            s += static_cast<char>(code);
+          } else if (code < 0x800) {
+            s += static_cast<char>(0xc0 | (code >> 6));
+            s += static_cast<char>(0x80 | (code & 0x3f));
+          } else {
+            s += static_cast<char>(0xe0 | (code >> 12));
+            s += static_cast<char>(0x80 | ((code >> 6) & 0x3f));
+            s += static_cast<char>(0x80 | (code & 0x3f));
+          }
+          break;
+        }
+        default:
+          s += c;
+      }
+    }
+    if (at_ >= text_.size()) {
+      fail("unterminated string");
+    }
+    ++at_;
+    return s;
+  }
+
+  value parse_value() {
+    char c = peek();
+    if (c == '{') {
+      ++at_;
+      auto v = value::object();
+      if (peek() == '}') {
+        ++at_;
+        return v;
+      }
+      for (;;) {
+        auto key = parse_string();
+        expect(':');
+        v.set(std::move(key), parse_value());
+        if (peek() == ',') {
+          ++at_;
+          continue;
+        }
+        expect('}');
+        return v;
+      }
+    }
+    if (c == '[') {
+      ++at_;
+      auto v = value::array();
+      if (peek() == ']') {
+        ++at_;
+        return v;
+      }
+      for (;;) {
+        v.push(parse_value());
+        if (peek() == ',') {
+          ++at_;
+          continue;
+        }
+        expect(']');
+        return v;
+      }
+    }
+    if (c == '"') {
+      return value{parse_string()};
+    }
+    if (literal("true")) {
+      return value{true};
+    }
+    if (literal("false")) {
+      return value{false};
+    }
+    if (literal("null")) {
+      return value{};
+    }
+    const char* begin = text_.c_str() + at_;
+    char* end = nullptr;
+    double n = std::strtod(begin, &end);
+    if (end == begin) {
+      fail("expected a value");
+    }
+    at_ += static_cast<std::size_t>(end - begin);
+    return value{n};
+  }
+
+ public:
+  explicit parser(const std::string& text) : text_(text) {}
+
+  value parse() {
+    auto v = parse_value();
+    if (peek() != '\0') {
+      fail("trailing characters");
+    }
+    return v;
+  }
+};
+
+inline value parse(const std::string& text) {
+  return parser{text}.parse();
+}
+
+} // namespace json
+} // namespace bench
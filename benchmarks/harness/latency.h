@@ -0,0 +1,204 @@
+// Copyright (c) 2018-present, Facebook, Inc.
+//
+// This source code is licensed under the MIT license found in the
+// LICENSE file in the root directory of this source tree.
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "bench.h"
+#include "histogram.h"
+
+//
+// open-loop latency benchmarks. a closed-loop benchmark only submits the next
+// item after the last one finished, so a stall delays the submissions as well
+// as the work and most of the stall never shows up in the results (the
+// coordinated omission problem). an open-loop benchmark submits item i at
+// start + i / rate whatever happened to the items before it, and measures the
+// latency of each item from the time it was meant to be submitted.
+//
+
+namespace bench {
+
+struct load {
+  // submissions per second
+  double rate = 10000.0;
+  // the time to keep submitting for
+  std::chrono::nanoseconds duration = std::chrono::milliseconds(500);
+  // the time to wait for the submitted items to run
+  std::chrono::nanoseconds timeout = std::chrono::seconds(10);
+};
+
+class open_loop {
+  load load_;
+  std::chrono::nanoseconds interval_;
+  std::vector<clock::time_point> submitted_;
+  std::vector<clock::time_point> completed_;
+  std::atomic<std::size_t> remaining_;
+  clock::time_point start_;
+  bool count_allocations_;
+  allocation_counts allocations_;
+
+ public:
+  explicit open_loop(load l, bool count_allocations = false)
+      : load_(l),
+        interval_(std::max<std::int64_t>(
+            1, static_cast<std::int64_t>(1e9 / std::max(l.rate, 1.0)))),
+        submitted_(std::max<std::size_t>(
+            1, static_cast<std::size_t>(l.duration / interval_))),
+        completed_(submitted_.size()),
+        remaining_(submitted_.size()),
+        count_allocations_(count_allocations) {}
+
+  std::size_t size() const {
+    return submitted_.size();
+  }
+  double rate() const {
+    return load_.rate;
+  }
+
+  // the time that item i is meant to be submitted at
+  clock::time_point intended(std::size_t i) const {
+    return start_ + interval_ * i;
+  }
+
+  // calls submit(i) for each item at its intended time, or as soon as
+  // possible when the generator is behind, then waits for all of the items to
+  // complete. returns false when some did not complete before the timeout.
+  template <class Submit>
+  bool run(Submit submit) {
+    if (count_allocations_) {
+      start_counting_allocations();
+    }
+    start_ = clock::now() + interval_;
+    for (std::size_t i = 0; i < submitted_.size(); ++i) {
+      auto at = intended(i);
+      // yield rather than sleep, a sleep overshoots by more than the interval
+      while (clock::now() < at) {
+        std::this_thread::yield();
+      }
+      submitted_[i] = clock::now();
+      submit(i);
+    }
+    auto deadline = clock::now() + load_.timeout;
+    bool finished = true;
+    while (remaining_.load(std::memory_order_acquire) != 0) {
+      if (clock::now() > deadline) {
+        finished = false;
+        break;
+      }
+      std::this_thread::yield();
+    }
+    if (count_allocations_) {
+      allocations_ = stop_counting_allocations();
+    }
+    return finished;
+  }
+
+  // called by item i when it runs, on any thread
+  void complete(std::size_t i) {
+    completed_[i] = clock::now();
+    remaining_.fetch_sub(1, std::memory_order_acq_rel);
+  }
+
+  // the allocations made while run() submitted and waited for the items
+  allocation_counts allocations() const {
+    return allocations_;
+  }
+
+  std::size_t completed() const {
+    return submitted_.size() - remaining_.load(std::memory_order_acquire);
+  }
+
+  // the latency from the intended submit time, corrected for coordinated
+  // omission.
+  histogram corrected() const {
+    histogram h;
+    for (std::size_t i = 0; i < completed_.size(); ++i) {
+      if (completed_[i] != clock::time_point{}) {
+        h.record(nanoseconds(completed_[i] - intended(i)));
+      }
+    }
+    return h;
+  }
+  // the latency from the actual submit time, as a closed-loop benchmark
+  // would see it.
+  histogram uncorrected() const {
+    histogram h;
+    for (std::size_t i = 0; i < completed_.size(); ++i) {
+      if (completed_[i] != clock::time_point{}) {
+        h.record(nanoseconds(completed_[i] - submitted_[i]));
+      }
+    }
+    return h;
+  }
+
+ private:
+  static std::uint64_t nanoseconds(clock::duration d) {
+    auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(d).count();
+    return ns < 0 ? 0 : static_cast<std::uint64_t>(ns);
+  }
+};
+
+struct latency_benchmark {
+  std::string name;
+  // creates the executor and calls open_loop::run() while it is alive
+  std::function<void(open_loop&)> fn;
+};
+
+inline std::vector<latency_benchmark>& latency_registry() {
+  static std::vector<latency_benchmark> benchmarks;
+  return benchmarks;
+}
+
+struct latency_registrar {
+  latency_registrar(std::string name, std::function<void(open_loop&)> fn) {
+    latency_registry().push_back({std::move(name), std::move(fn)});
+  }
+};
+
+struct latency_result {
+  std::string name;
+  double rate = 0.0;
+  std::size_t submitted = 0;
+  std::size_t completed = 0;
+  histogram corrected;
+  histogram uncorrected;
+  allocation_counts allocations;
+};
+
+inline latency_result run(
+    const latency_benchmark& b,
+    const load& l,
+    bool count_allocations = false) {
+  open_loop loop{l, count_allocations};
+  b.fn(loop);
+  latency_result r;
+  r.name = b.name;
+  r.rate = loop.rate();
+  r.submitted = loop.size();
+  r.completed = loop.completed();
+  r.corrected = loop.corrected();
+  r.uncorrected = loop.uncorrected();
+  r.allocations = loop.allocations();
+  return r;
+}
+
+} // namespace bench
+
+// registers an open-loop latency benchmark
+#define PUSHMI_LATENCY_BENCHMARK(NAME, ...)                       \
+  namespace {                                                     \
+  static ::bench::latency_registrar PUSHMI_BENCH_CAT(             \
+      pushmi_latency_registrar_, __LINE__){NAME, __VA_ARGS__};    \
+  }
@@ -0,0 +1,17 @@
+// Copyright (c) 2018-present, Facebook, Inc.
+//
+// This source code is licensed under the MIT license found in the
+// LICENSE file in the root directory of this source tree.
+
+#pragma once
+
+// stands in for nonius when the benchmarks are built with the harness, this
+// directory is searched before external/nonius/include.
+
+#include "../bench.h"
+
+namespace nonius {
+using chronometer = ::bench::chronometer;
+} // namespace nonius
+
+#define NONIUS_BENCHMARK(...) PUSHMI_BENCHMARK(__VA_ARGS__)
@@ -0,0 +1,151 @@
+// Copyright (c) 2018-present, Facebook, Inc.
+//
+// This source code is licensed under the MIT license found in the
+// LICENSE file in the root directory of this source tree.
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#define PUSHMI_BENCH_HAS_PERF 1
+#else
+#define PUSHMI_BENCH_HAS_PERF 0
+#endif
+
+namespace bench {
+
+enum counter : int {
+  cycles,
+  instructions,
+  cache_misses,
+  branch_misses,
+  counter_count
+};
+
+inline const char* counter_name(int c) {
+  static const char* const names[counter_count] = {
+      "cycles", "instructions", "cache-misses", "branch-misses"};
+  return names[c];
+}
+
+// the counts of one measured region, scaled up when the kernel had to
+// multiplex the counters. a counter that could not be opened is not
+// available.
+struct counter_values {
+  std::array<double, counter_count> value{};
+  std::array<bool, counter_count> available{};
+};
+
+//
+// perf_counters reads the hardware counters of the calling thread and of the
+// threads that it creates after the counters are opened, so work that a
+// benchmark hands to a new_thread or a pool created inside the benchmark is
+// counted as well.
+//
+// the counters are unavailable when the kernel does not allow them, for
+// example when perf_event_paranoid is too high or inside a container.
+//
+class perf_counters {
+  std::array<int, counter_count> fd_;
+
+#if PUSHMI_BENCH_HAS_PERF
+  static int open(std::uint64_t config) {
+    perf_event_attr attr;
+    std::memset(&attr, 0, sizeof(attr));
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.size = sizeof(attr);
+    attr.config = config;
+    attr.disabled = 1;
+    attr.inherit = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format =
+        PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    return static_cast<int>(
+        ::syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0));
+  }
+#endif
+
+ public:
+  perf_counters() {
+    fd_.fill(-1);
+#if PUSHMI_BENCH_HAS_PERF
+    const std::uint64_t configs[counter_count] = {
+        PERF_COUNT_HW_CPU_CYCLES,
+        PERF_COUNT_HW_INSTRUCTIONS,
+        PERF_COUNT_HW_CACHE_MISSES,
+        PERF_COUNT_HW_BRANCH_MISSES};
+    for (int c = 0; c < counter_count; ++c) {
+      fd_[c] = open(configs[c]);
+    }
+#endif
+  }
+  perf_counters(const perf_counters&) = delete;
+  perf_counters& operator=(const perf_counters&) = delete;
+  ~perf_counters() {
+#if PUSHMI_BENCH_HAS_PERF
+    for (int fd : fd_) {
+      if (fd >= 0) {
+        ::close(fd);
+      }
+    }
+#endif
+  }
+
+  bool any() const {
+    for (int fd : fd_) {
+      if (fd >= 0) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  void start() {
+#if PUSHMI_BENCH_HAS_PERF
+    for (int fd : fd_) {
+      if (fd >= 0) {
+        ::ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+        ::ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+      }
+    }
+#endif
+  }
+
+  counter_values stop() {
+    counter_values result;
+#if PUSHMI_BENCH_HAS_PERF
+    for (int fd : fd_) {
+      if (fd >= 0) {
+        ::ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+      }
+    }
+    for (int c = 0; c < counter_count; ++c) {
+      // value, time enabled, time running
+      std::uint64_t read_format[3] = {};
+      if (fd_[c] < 0 ||
+          ::read(fd_[c], read_format, sizeof(read_format)) !=
+              static_cast<ssize_t>(sizeof(read_format))) {
+        continue;
+      }
+      double value = static_cast<double>(read_format[0]);
+      if (read_format[2] != 0 && read_format[2] < read_format[1]) {
+        value *= static_cast<double>(read_format[1]) /
+            static_cast<double>(read_format[2]);
+      }
+      result.value[c] = value;
+      result.available[c] = true;
+    }
+#endif
+    return result;
+  }
+};
+
+} // namespace bench
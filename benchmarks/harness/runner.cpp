@@ -0,0 +1,446 @@
+// Copyright (c) 2018-present, Facebook, Inc.
+//
+// This source code is licensed under the MIT license found in the
+// LICENSE file in the root directory of this source tree.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <exception>
+#include <fstream>
+#include <string>
+#include <thread>
+
+#include "bench.h"
+#include "json.h"
+#include "latency.h"
+
+namespace {
+
+void usage(const char* self) {
+  std::printf(
+      "usage: %s [options]\n"
+      "  --filter <text>      run the benchmarks with a name containing text\n"
+      "  --samples <n>        samples of each benchmark (default 20)\n"
+      "  --sample-time <ms>   minimum time of each sample (default 10)\n"
+      "  --no-counters        do not read the hardware counters\n"
+      "  --rate <n>           items per second of the latency benchmarks\n"
+      "                       (default 10000)\n"
+      "  --duration <ms>      time to submit for in the latency benchmarks\n"
+      "                       (default 500)\n"
+      "  --allocations        count the allocations per op instead of timing,\n"
+      "                       as csv. an op is a run of the measured function,\n"
+      "                       or an item of a latency benchmark\n"
+      "  --allocation-runs <n> runs counted in each benchmark (default 100)\n"
+      "  --json <file>        also write the results, with the build and\n"
+      "                       machine they came from, to file as json\n"
+      "  --list               list the benchmarks\n",
+      self);
+}
+
+// 1234.5 -> "1.23k"
+std::string scaled(double v) {
+  const char* suffix[] = {"", "k", "M", "G"};
+  int i = 0;
+  while (std::abs(v) >= 1000.0 && i < 3) {
+    v /= 1000.0;
+    ++i;
+  }
+  char buf[32];
+  std::snprintf(buf, sizeof(buf), "%.3g%s", v, suffix[i]);
+  return buf;
+}
+
+std::string duration(double ns) {
+  const char* unit[] = {"ns", "us", "ms", "s"};
+  int i = 0;
+  while (ns >= 1000.0 && i < 3) {
+    ns /= 1000.0;
+    ++i;
+  }
+  char buf[32];
+  std::snprintf(buf, sizeof(buf), "%.3g %s", ns, unit[i]);
+  return buf;
+}
+
+void report(const bench::result& r) {
+  auto mean = r.mean();
+  std::printf("%s\n", r.name.c_str());
+  std::printf(
+      "  %zu samples x %d runs  mean %s  median %s  stddev %.1f%%\n",
+      r.ns.size(),
+      r.runs,
+      duration(mean).c_str(),
+      duration(r.median()).c_str(),
+      mean > 0.0 ? 100.0 * r.stddev() / mean : 0.0);
+
+  std::string counters;
+  for (int c = 0; c < bench::counter_count; ++c) {
+    if (r.counters.available[c]) {
+      counters += std::string("  ") + bench::counter_name(c) + " " +
+          scaled(r.counters.value[c]);
+    }
+  }
+  if (r.counters.available[bench::cycles] &&
+      r.counters.available[bench::instructions] &&
+      r.counters.value[bench::cycles] > 0.0) {
+    char ipc[32];
+    std::snprintf(
+        ipc,
+        sizeof(ipc),
+        "  ipc %.2f",
+        r.counters.value[bench::instructions] /
+            r.counters.value[bench::cycles]);
+    counters += ipc;
+  }
+  if (!counters.empty()) {
+    std::printf("%s\n", counters.c_str());
+  }
+  std::fflush(stdout);
+}
+
+void report(const bench::latency_result& r, const bench::load& l) {
+  std::printf("%s\n", r.name.c_str());
+  std::printf(
+      "  %s/s for %s, %zu of %zu completed\n",
+      scaled(r.rate).c_str(),
+      duration(static_cast<double>(l.duration.count())).c_str(),
+      r.completed,
+      r.submitted);
+  auto line = [](const char* label, const bench::histogram& h) {
+    std::printf(
+        "  %-12s p50 %s  p90 %s  p99 %s  p99.9 %s  max %s\n",
+        label,
+        duration(h.percentile(50.0)).c_str(),
+        duration(h.percentile(90.0)).c_str(),
+        duration(h.percentile(99.0)).c_str(),
+        duration(h.percentile(99.9)).c_str(),
+        duration(h.max()).c_str());
+  };
+  line("corrected", r.corrected);
+  line("uncorrected", r.uncorrected);
+  std::fflush(stdout);
+}
+
+bench::json::value to_json(const bench::result& r) {
+  auto samples = bench::json::value::array();
+  for (double ns : r.ns) {
+    samples.push(ns);
+  }
+  auto counters = bench::json::value::object();
+  for (int c = 0; c < bench::counter_count; ++c) {
+    if (r.counters.available[c]) {
+      counters.set(bench::counter_name(c), r.counters.value[c]);
+    }
+  }
+  return bench::json::value::object()
+      .set("name", r.name)
+      .set("kind", "time")
+      .set("runs", r.runs)
+      .set("mean_ns", r.mean())
+      .set("median_ns", r.median())
+      .set("stddev_ns", r.stddev())
+      .set("samples_ns", std::move(samples))
+      .set("counters", std::move(counters));
+}
+
+bench::json::value to_json(const bench::histogram& h) {
+  return bench::json::value::object()
+      .set("count", h.count())
+      .set("mean", h.mean())
+      .set("p50", h.percentile(50.0))
+      .set("p90", h.percentile(90.0))
+      .set("p99", h.percentile(99.0))
+      .set("p99.9", h.percentile(99.9))
+      .set("max", h.max());
+}
+
+bench::json::value to_json(
+    const bench::latency_result& r,
+    const bench::load& l) {
+  return bench::json::value::object()
+      .set("name", r.name)
+      .set("kind", "latency")
+      .set("rate", r.rate)
+      .set("duration_ns", l.duration.count())
+      .set("submitted", r.submitted)
+      .set("completed", r.completed)
+      .set("corrected_ns", to_json(r.corrected))
+      .set("uncorrected_ns", to_json(r.uncorrected));
+}
+
+bench::json::value allocations_to_json(
+    const std::string& name,
+    std::uint64_t ops,
+    const bench::allocation_counts& counts) {
+  double n = static_cast<double>(std::max<std::uint64_t>(ops, 1));
+  return bench::json::value::object()
+      .set("name", name)
+      .set("kind", "allocations")
+      .set("ops", ops)
+      .set("allocations_per_op", counts.allocations / n)
+      .set("bytes_per_op", counts.bytes / n)
+      .set("deallocations_per_op", counts.deallocations / n);
+}
+
+// the build and the machine that the results came from
+bench::json::value context(
+    int argc,
+    char** argv,
+    const bench::options& opts,
+    bool counters) {
+  char date[32] = "";
+  auto now = std::time(nullptr);
+  if (auto utc = std::gmtime(&now)) {
+    std::strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%SZ", utc);
+  }
+  std::string command;
+  for (int i = 0; i < argc; ++i) {
+    command += (i == 0 ? "" : " ") + std::string(argv[i]);
+  }
+#if defined(__clang__)
+  const char* compiler = "clang " __clang_version__;
+#elif defined(__GNUC__)
+  const char* compiler = "gcc " __VERSION__;
+#elif defined(_MSC_VER)
+  const std::string msvc = "msvc " + std::to_string(_MSC_FULL_VER);
+  const char* compiler = msvc.c_str();
+#else
+  const char* compiler = "unknown";
+#endif
+#if defined(__linux__)
+  const char* os = "linux";
+#elif defined(__APPLE__)
+  const char* os = "macos";
+#elif defined(_WIN32)
+  const char* os = "windows";
+#else
+  const char* os = "unknown";
+#endif
+#if defined(__x86_64__) || defined(_M_X64)
+  const char* arch = "x86_64";
+#elif defined(__aarch64__) || defined(_M_ARM64)
+  const char* arch = "aarch64";
+#else
+  const char* arch = "unknown";
+#endif
+#if defined(__OPTIMIZE__) || (defined(_MSC_VER) && !defined(_DEBUG))
+  const bool optimized = true;
+#else
+  const bool optimized = false;
+#endif
+#if defined(NDEBUG)
+  const bool assertions = false;
+#else
+  const bool assertions = true;
+#endif
+#if defined(PUSHMI_BENCH_BUILD_TYPE)
+  const char* build_type = PUSHMI_BENCH_BUILD_TYPE;
+#else
+  const char* build_type = "";
+#endif
+  return bench::json::value::object()
+      .set("date", date)
+      .set("command", command)
+      .set("compiler", compiler)
+      .set("cplusplus", static_cast<long>(__cplusplus))
+      .set("build_type", build_type)
+      .set("optimized", optimized)
+      .set("assertions", assertions)
+      .set("os", os)
+      .set("arch", arch)
+      .set("hardware_concurrency", std::thread::hardware_concurrency())
+      .set("hardware_counters", counters)
+      .set("samples", opts.samples)
+      .set("sample_time_ns", opts.sample_time.count());
+}
+
+bool write_json(
+    const std::string& path,
+    bench::json::value context,
+    bench::json::value results) {
+  std::ofstream out{path};
+  out << bench::json::value::object()
+             .set("context", std::move(context))
+             .set("benchmarks", std::move(results))
+             .dump(2)
+      << "\n";
+  out.close();
+  if (!out) {
+    std::fprintf(stderr, "could not write %s\n", path.c_str());
+    return false;
+  }
+  return true;
+}
+
+// quotes a csv field
+std::string csv(const std::string& text) {
+  std::string quoted = "\"";
+  for (char c : text) {
+    quoted += c;
+    if (c == '"') {
+      quoted += c;
+    }
+  }
+  return quoted + "\"";
+}
+
+void report_allocations(
+    const std::string& name,
+    std::uint64_t ops,
+    const bench::allocation_counts& counts) {
+  double n = static_cast<double>(std::max<std::uint64_t>(ops, 1));
+  std::printf(
+      "%s,%llu,%.3f,%.1f,%.3f\n",
+      csv(name).c_str(),
+      static_cast<unsigned long long>(ops),
+      counts.allocations / n,
+      counts.bytes / n,
+      counts.deallocations / n);
+  std::fflush(stdout);
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+  bench::options opts;
+  bench::load load;
+  bool list = false;
+  bool allocations = false;
+  int allocation_runs = 100;
+  std::string json_path;
+  auto results = bench::json::value::array();
+  for (int i = 1; i < argc; ++i) {
+    auto arg = std::string(argv[i]);
+    auto next = [&]() -> const char* {
+      if (i + 1 >= argc) {
+        usage(argv[0]);
+        std::exit(1);
+      }
+      return argv[++i];
+    };
+    if (arg == "--filter") {
+      opts.filter = next();
+    } else if (arg == "--samples") {
+      opts.samples = std::max(1, std::atoi(next()));
+    } else if (arg == "--sample-time") {
+      opts.sample_time = std::chrono::milliseconds(std::atoi(next()));
+    } else if (arg == "--no-counters") {
+      opts.counters = false;
+    } else if (arg == "--rate") {
+      load.rate = std::max(1.0, std::atof(next()));
+    } else if (arg == "--duration") {
+      load.duration = std::chrono::milliseconds(std::max(1, std::atoi(next())));
+    } else if (arg == "--allocations") {
+      allocations = true;
+    } else if (arg == "--allocation-runs") {
+      allocation_runs = std::max(1, std::atoi(next()));
+    } else if (arg == "--json") {
+      json_path = next();
+    } else if (arg == "--list") {
+      list = true;
+    } else {
+      usage(argv[0]);
+      return arg == "--help" ? 0 : 1;
+    }
+  }
+
+  if (list) {
+    for (auto& b : bench::registry()) {
+      std::printf("%s\n", b.name.c_str());
+    }
+    for (auto& b : bench::latency_registry()) {
+      std::printf("%s\n", b.name.c_str());
+    }
+    return 0;
+  }
+
+  if (allocations) {
+    std::printf(
+        "benchmark,ops,allocations_per_op,bytes_per_op,deallocations_per_op\n");
+    for (auto& b : bench::registry()) {
+      if (b.name.find(opts.filter) == std::string::npos) {
+        continue;
+      }
+      try {
+        auto counts = bench::count_allocations(b, allocation_runs);
+        report_allocations(b.name, allocation_runs, counts);
+        results.push(allocations_to_json(b.name, allocation_runs, counts));
+      } catch (const std::exception& e) {
+        std::fprintf(stderr, "%s failed: %s\n", b.name.c_str(), e.what());
+      }
+    }
+    for (auto& b : bench::latency_registry()) {
+      if (b.name.find(opts.filter) == std::string::npos) {
+        continue;
+      }
+      try {
+        auto r = bench::run(b, load, true);
+        report_allocations(b.name, r.submitted, r.allocations);
+        results.push(allocations_to_json(b.name, r.submitted, r.allocations));
+      } catch (const std::exception& e) {
+        std::fprintf(stderr, "%s failed: %s\n", b.name.c_str(), e.what());
+      }
+    }
+    if (!json_path.empty() &&
+        !write_json(
+            json_path,
+            context(argc, argv, opts, false),
+            std::move(results))) {
+      return 1;
+    }
+    return 0;
+  }
+
+  bench::perf_counters counters;
+  if (opts.counters && !counters.any()) {
+    std::printf("hardware counters are not available, reporting time only\n");
+  }
+  std::printf("results are per run of the measured function\n\n");
+
+  for (auto& b : bench::registry()) {
+    if (b.name.find(opts.filter) == std::string::npos) {
+      continue;
+    }
+    try {
+      auto r = bench::run(b, opts, &counters);
+      report(r);
+      results.push(to_json(r));
+    } catch (const std::exception& e) {
+      std::printf("%s\n  failed: %s\n", b.name.c_str(), e.what());
+    }
+  }
+
+  bool latency_header = false;
+  for (auto& b : bench::latency_registry()) {
+    if (b.name.find(opts.filter) == std::string::npos) {
+      continue;
+    }
+    if (!latency_header) {
+      std::printf(
+          "\nlatency from the intended submit time to the item running, "
+          "corrected for coordinated omission\n\n");
+      latency_header = true;
+    }
+    try {
+      auto r = bench::run(b, load);
+      report(r, load);
+      results.push(to_json(r, load));
+    } catch (const std::exception& e) {
+      std::printf("%s\n  failed: %s\n", b.name.c_str(), e.what());
+    }
+  }
+
+  if (!json_path.empty() &&
+      !write_json(
+          json_path,
+          context(argc, argv, opts, opts.counters && counters.any()),
+          std::move(results))) {
+    return 1;
+  }
+  return 0;
+}
@@ -28,6 +28,9 @@ set(header_files
     "${CMAKE_CURRENT_SOURCE_DIR}/include/pushmi/detail/if_constexpr.h"
     "${CMAKE_CURRENT_SOURCE_DIR}/include/pushmi/detail/functional.h"
     "${CMAKE_CURRENT_SOURCE_DIR}/include/pushmi/detail/opt.h"
+    "${CMAKE_CURRENT_SOURCE_DIR}/include/pushmi/detail/futex.h"
+    "${CMAKE_CURRENT_SOURCE_DIR}/include/pushmi/detail/lock_stats.h"
+    "${CMAKE_CURRENT_SOURCE_DIR}/include/pushmi/detail/queue_stats.h"
 
     "${CMAKE_CURRENT_SOURCE_DIR}/include/pushmi/traits.h"
     "${CMAKE_CURRENT_SOURCE_DIR}/include/pushmi/forwards.h"
@@ -49,7 +52,11 @@ set(header_files
     "${CMAKE_CURRENT_SOURCE_DIR}/include/pushmi/strand.h"
     "${CMAKE_CURRENT_SOURCE_DIR}/include/pushmi/new_thread.h"
     "${CMAKE_CURRENT_SOURCE_DIR}/include/pushmi/time_source.h"
+    "${CMAKE_CURRENT_SOURCE_DIR}/include/pushmi/instrumented.h"
+    "${CMAKE_CURRENT_SOURCE_DIR}/include/pushmi/epoll_context.h"
     "${CMAKE_CURRENT_SOURCE_DIR}/include/pushmi/entangle.h"
+    "${CMAKE_CURRENT_SOURCE_DIR}/include/pushmi/stop_token.h"
+    "${CMAKE_CURRENT_SOURCE_DIR}/include/pushmi/detail/trace.h"
     "${CMAKE_CURRENT_SOURCE_DIR}/include/pushmi/o/extension_operators.h"
     "${CMAKE_CURRENT_SOURCE_DIR}/include/pushmi/subject.h"
 
@@ -62,6 +69,7 @@ set(header_files
     "${CMAKE_CURRENT_SOURCE_DIR}/include/pushmi/o/empty.h"
     "${CMAKE_CURRENT_SOURCE_DIR}/include/pushmi/o/request_via.h"
     "${CMAKE_CURRENT_SOURCE_DIR}/include/pushmi/o/share.h"
+    "${CMAKE_CURRENT_SOURCE_DIR}/include/pushmi/o/ref_share.h"
     "${CMAKE_CURRENT_SOURCE_DIR}/include/pushmi/o/on.h"
     "${CMAKE_CURRENT_SOURCE_DIR}/include/pushmi/o/transform.h"
     "${CMAKE_CURRENT_SOURCE_DIR}/include/pushmi/o/schedule.h"
@@ -69,6 +77,14 @@ set(header_files
     "${CMAKE_CURRENT_SOURCE_DIR}/include/pushmi/o/from.h"
     "${CMAKE_CURRENT_SOURCE_DIR}/include/pushmi/o/tap.h"
     "${CMAKE_CURRENT_SOURCE_DIR}/include/pushmi/o/filter.h"
+    "${CMAKE_CURRENT_SOURCE_DIR}/include/pushmi/o/buffer.h"
+    "${CMAKE_CURRENT_SOURCE_DIR}/include/pushmi/o/merge.h"
+    "${CMAKE_CURRENT_SOURCE_DIR}/include/pushmi/o/flat_map.h"
+    "${CMAKE_CURRENT_SOURCE_DIR}/include/pushmi/o/parallel_transform.h"
+    "${CMAKE_CURRENT_SOURCE_DIR}/include/pushmi/o/throttle.h"
+    "${CMAKE_CURRENT_SOURCE_DIR}/include/pushmi/o/timeout.h"
+    "${CMAKE_CURRENT_SOURCE_DIR}/include/pushmi/o/retry.h"
+    "${CMAKE_CURRENT_SOURCE_DIR}/include/pushmi/o/when_all.h"
 )
 
 BuildSingleHeader("pushmi" ${header_files})
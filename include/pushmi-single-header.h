@@ -11,6 +11,10 @@
 #include <cassert>
 #include <cstdint>
 #include <cstdio>
+#include <cstring>
+#include <cerrno>
+#include <ctime>
+#include <climits>
 #include <chrono>
 #include <exception>
 #include <functional>
@@ -22,10 +26,30 @@
 
 #include <thread>
 #include <future>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <array>
 #include <tuple>
 #include <deque>
+#include <list>
 #include <vector>
 #include <queue>
+#include <random>
+#include <stdexcept>
+#include <system_error>
+#include <unordered_map>
+#include <string>
+#include <ostream>
+
+#if defined(__linux__)
+#include <linux/futex.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/syscall.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+#endif
 
 #if __cpp_lib_optional >= 201606
 #include <optional>
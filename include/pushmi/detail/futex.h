@@ -0,0 +1,145 @@
+/*
+ * Copyright 2018-present Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <atomic>
+#include <climits>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+
+#if defined(__linux__)
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#define PUSHMI_HAS_FUTEX 1
+#else
+#define PUSHMI_HAS_FUTEX 0
+#endif
+
+namespace pushmi {
+
+namespace detail {
+
+#if !PUSHMI_HAS_FUTEX
+// without a futex the waiters block on a condition variable chosen by the
+// address of the word.
+struct parking_bucket {
+  std::mutex lock;
+  std::condition_variable parked;
+};
+inline parking_bucket& parking_bucket_for(const void* word) noexcept {
+  static parking_bucket buckets[16];
+  return buckets[(reinterpret_cast<std::uintptr_t>(word) >> 4) % 16];
+}
+#endif
+
+// one iteration of a spin loop
+inline void cpu_relax() noexcept {
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+  __builtin_ia32_pause();
+#elif defined(__GNUC__) && defined(__aarch64__)
+  asm volatile("yield" ::: "memory");
+#endif
+}
+
+// the number of iterations to spin before parking. spinning cannot help
+// when the thread that would change the word needs this core.
+inline int spin_limit() noexcept {
+  static const int limit = std::thread::hardware_concurrency() > 1 ? 256 : 0;
+  return limit;
+}
+
+// blocks while word holds expected. may return spuriously.
+inline void futex_wait(std::atomic<int>& word, int expected) noexcept {
+#if PUSHMI_HAS_FUTEX
+  static_assert(
+      sizeof(std::atomic<int>) == sizeof(int),
+      "futex requires a lock-free std::atomic<int>");
+  ::syscall(
+      SYS_futex,
+      reinterpret_cast<int*>(&word),
+      FUTEX_WAIT_PRIVATE,
+      expected,
+      nullptr,
+      nullptr,
+      0);
+#else
+  auto& bucket = parking_bucket_for(&word);
+  std::unique_lock<std::mutex> guard{bucket.lock};
+  if (word.load(std::memory_order_relaxed) == expected) {
+    bucket.parked.wait(guard);
+  }
+#endif
+}
+
+// wakes up to count threads blocked in futex_wait() on word.
+//
+// it is safe to call this after the word has been destroyed, only the
+// address is used to find the waiters, at worst an unrelated waiter at the
+// same address wakes spuriously.
+inline void futex_wake(std::atomic<int>& word, int count = INT_MAX) noexcept {
+#if PUSHMI_HAS_FUTEX
+  ::syscall(
+      SYS_futex,
+      reinterpret_cast<int*>(&word),
+      FUTEX_WAKE_PRIVATE,
+      count,
+      nullptr,
+      nullptr,
+      0);
+#else
+  (void)count;
+  auto& bucket = parking_bucket_for(&word);
+  std::unique_lock<std::mutex> guard{bucket.lock};
+  bucket.parked.notify_all();
+#endif
+}
+
+// waits until done(word) is true. spins for a while in case the owner is
+// about to change the word, then sets parked_bit in the word and blocks.
+//
+// every store to the word that can satisfy done must be a read-modify-write
+// that keeps or clears parked_bit, and must call futex_wake() when the
+// previous value had parked_bit set.
+template <class Done>
+void spin_then_park(std::atomic<int>& word, int parked_bit, Done done) {
+  const int limit = spin_limit();
+  for (int spins = 0;; ++spins) {
+    int current = word.load(std::memory_order_acquire);
+    if (done(current)) {
+      return;
+    }
+    if (spins < limit) {
+      cpu_relax();
+      continue;
+    }
+    if ((current & parked_bit) == 0 &&
+        !word.compare_exchange_weak(
+            current,
+            current | parked_bit,
+            std::memory_order_acquire,
+            std::memory_order_relaxed)) {
+      continue;
+    }
+    futex_wait(word, current | parked_bit);
+  }
+}
+
+} // namespace detail
+
+} // namespace pushmi
@@ -0,0 +1,114 @@
+/*
+ * Copyright 2018-present Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <type_traits>
+
+// when PUSHMI_LOCK_STATS is 1 the locks of the strand and time_source queues
+// count how often they were taken, how often they had to be waited for and
+// how long the waits took. the counts are shared by all the locks of a kind.
+// otherwise the locks are plain std::mutex and the counts stay zero.
+#ifndef PUSHMI_LOCK_STATS
+#define PUSHMI_LOCK_STATS 0
+#endif
+
+namespace pushmi {
+
+struct lock_stats {
+  static constexpr bool enabled = PUSHMI_LOCK_STATS != 0;
+
+  std::atomic<std::uint64_t> acquisitions{0};
+  std::atomic<std::uint64_t> contended{0};
+  std::atomic<std::uint64_t> wait_ns{0};
+
+  void reset() noexcept {
+    acquisitions.store(0, std::memory_order_relaxed);
+    contended.store(0, std::memory_order_relaxed);
+    wait_ns.store(0, std::memory_order_relaxed);
+  }
+};
+
+namespace detail {
+
+struct strand_lock_tag {};
+struct time_source_lock_tag {};
+
+template <class Tag>
+lock_stats& lock_stats_of() noexcept {
+  static lock_stats stats;
+  return stats;
+}
+
+#if PUSHMI_LOCK_STATS
+template <class Tag>
+class stats_mutex {
+  std::mutex m_;
+
+ public:
+  void lock() {
+    auto& stats = lock_stats_of<Tag>();
+    stats.acquisitions.fetch_add(1, std::memory_order_relaxed);
+    if (m_.try_lock()) {
+      return;
+    }
+    auto start = std::chrono::steady_clock::now();
+    m_.lock();
+    auto waited = std::chrono::steady_clock::now() - start;
+    stats.contended.fetch_add(1, std::memory_order_relaxed);
+    stats.wait_ns.fetch_add(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(waited).count(),
+        std::memory_order_relaxed);
+  }
+  bool try_lock() {
+    if (!m_.try_lock()) {
+      return false;
+    }
+    lock_stats_of<Tag>().acquisitions.fetch_add(1, std::memory_order_relaxed);
+    return true;
+  }
+  void unlock() {
+    m_.unlock();
+  }
+};
+#else
+template <class Tag>
+using stats_mutex = std::mutex;
+#endif
+
+// std::condition_variable only waits on a std::mutex
+template <class Mutex>
+using condition_variable_for = std::conditional_t<
+    std::is_same<Mutex, std::mutex>::value,
+    std::condition_variable,
+    std::condition_variable_any>;
+
+} // namespace detail
+
+// the counts for the locks of all the strand queues
+inline lock_stats& strand_lock_stats() noexcept {
+  return detail::lock_stats_of<detail::strand_lock_tag>();
+}
+// the counts for the locks of all the time_sources
+inline lock_stats& time_source_lock_stats() noexcept {
+  return detail::lock_stats_of<detail::time_source_lock_tag>();
+}
+
+} // namespace pushmi
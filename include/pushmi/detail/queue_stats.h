@@ -0,0 +1,118 @@
+/*
+ * Copyright 2018-present Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+// the strand and time_source queues keep these counts as they run. they are
+// relaxed atomics, so another thread can sample them at any time without
+// taking the queue locks. a sample is not a snapshot, each count may be from
+// a slightly different moment.
+
+namespace pushmi {
+
+namespace detail {
+inline void store_max(
+    std::atomic<std::uint64_t>& max,
+    std::uint64_t value) noexcept {
+  auto current = max.load(std::memory_order_relaxed);
+  while (value > current &&
+         !max.compare_exchange_weak(
+             current, value, std::memory_order_relaxed)) {
+  }
+}
+} // namespace detail
+
+struct queue_stats {
+  // the items waiting in the queues now
+  std::atomic<std::uint64_t> queued{0};
+  // the items ever added to the queues
+  std::atomic<std::uint64_t> enqueued{0};
+  // the most items seen waiting in one strand, or in all the queues of a
+  // time_source
+  std::atomic<std::uint64_t> max_depth{0};
+  // the dispatches that ran items, and the items that they ran
+  std::atomic<std::uint64_t> batches{0};
+  std::atomic<std::uint64_t> dispatched{0};
+  // the most items run by one dispatch
+  std::atomic<std::uint64_t> max_batch{0};
+
+  void enqueue(std::uint64_t depth) noexcept {
+    queued.fetch_add(1, std::memory_order_relaxed);
+    enqueued.fetch_add(1, std::memory_order_relaxed);
+    detail::store_max(max_depth, depth);
+  }
+  void dequeue() noexcept {
+    queued.fetch_sub(1, std::memory_order_relaxed);
+  }
+  void batch(std::uint64_t items) noexcept {
+    if (items == 0) {
+      return;
+    }
+    batches.fetch_add(1, std::memory_order_relaxed);
+    dispatched.fetch_add(items, std::memory_order_relaxed);
+    detail::store_max(max_batch, items);
+  }
+
+  // restarts the totals and the maxima. queued is a level, it is kept.
+  void reset() noexcept {
+    enqueued.store(0, std::memory_order_relaxed);
+    max_depth.store(0, std::memory_order_relaxed);
+    batches.store(0, std::memory_order_relaxed);
+    dispatched.store(0, std::memory_order_relaxed);
+    max_batch.store(0, std::memory_order_relaxed);
+  }
+};
+
+// a batch is one drain of a strand queue by its worker
+struct strand_stats : queue_stats {};
+
+// a batch is one dispatch of the ready timers of a queue. every dispatched
+// timer also records how late it fired, the time from when it was due to
+// when its receiver was signalled.
+struct time_source_stats : queue_stats {
+  // the timers that recorded their lateness. the batch counts are updated
+  // when the batch completes, so they can lag behind fired.
+  std::atomic<std::uint64_t> fired_count{0};
+  std::atomic<std::uint64_t> late_ns{0};
+  std::atomic<std::uint64_t> max_late_ns{0};
+
+  void fired(std::chrono::nanoseconds late) noexcept {
+    auto ns = late.count() < 0 ? 0 : static_cast<std::uint64_t>(late.count());
+    late_ns.fetch_add(ns, std::memory_order_relaxed);
+    fired_count.fetch_add(1, std::memory_order_relaxed);
+    detail::store_max(max_late_ns, ns);
+  }
+
+  // the mean lateness of the timers fired since the last reset
+  std::chrono::nanoseconds mean_late() const noexcept {
+    auto n = fired_count.load(std::memory_order_relaxed);
+    return std::chrono::nanoseconds{
+        n == 0 ? 0 : static_cast<std::int64_t>(
+                         late_ns.load(std::memory_order_relaxed) / n)};
+  }
+
+  void reset() noexcept {
+    queue_stats::reset();
+    fired_count.store(0, std::memory_order_relaxed);
+    late_ns.store(0, std::memory_order_relaxed);
+    max_late_ns.store(0, std::memory_order_relaxed);
+  }
+};
+
+} // namespace pushmi
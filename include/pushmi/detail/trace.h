@@ -0,0 +1,365 @@
+/*
+ * Copyright 2018-present Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <pushmi/concepts.h>
+#include <pushmi/detail/functional.h>
+#include <pushmi/extension_points.h>
+
+// when PUSHMI_TRACE is 1 the operators built with sender_from and
+// receiver_from_fn record a span for every value, error, done and starting
+// signal that their receivers are given. the spans are kept in a ring buffer
+// per thread and are written out in the chrome://tracing json format by
+// write_chrome_trace(). nothing is recorded until start_tracing() is called.
+//
+// otherwise the operators are not wrapped and the functions below do
+// nothing. PUSHMI_TRACE changes the types of the operator receivers, so it
+// must have the same value in every translation unit of a program.
+#ifndef PUSHMI_TRACE
+#define PUSHMI_TRACE 0
+#endif
+
+// the number of spans that each thread keeps, older spans are overwritten
+#ifndef PUSHMI_TRACE_CAPACITY
+#define PUSHMI_TRACE_CAPACITY (1 << 14)
+#endif
+
+namespace pushmi {
+
+enum class trace_signal { value, error, done, starting };
+
+namespace detail {
+
+inline const char* trace_signal_name(trace_signal s) noexcept {
+  switch (s) {
+    case trace_signal::value:
+      return "value";
+    case trace_signal::error:
+      return "error";
+    case trace_signal::done:
+      return "done";
+    case trace_signal::starting:
+      return "starting";
+  }
+  return "";
+}
+
+struct trace_event {
+  const char* name;
+  trace_signal signal;
+  std::int64_t begin_ns;
+  std::int64_t end_ns;
+};
+
+// written only by the thread that owns it. a span is stored and then
+// published by the release store of next_, so a reader that acquires next_
+// sees every span below it.
+class trace_ring {
+  static constexpr std::uint64_t capacity = PUSHMI_TRACE_CAPACITY;
+
+  std::array<trace_event, capacity> events_;
+  std::atomic<std::uint64_t> next_{0};
+  std::atomic<std::uint64_t> cleared_{0};
+  int tid_;
+
+ public:
+  explicit trace_ring(int tid) noexcept : tid_(tid) {}
+
+  int tid() const noexcept {
+    return tid_;
+  }
+
+  void record(const trace_event& e) noexcept {
+    auto next = next_.load(std::memory_order_relaxed);
+    events_[next % capacity] = e;
+    next_.store(next + 1, std::memory_order_release);
+  }
+
+  void clear() noexcept {
+    cleared_.store(
+        next_.load(std::memory_order_acquire), std::memory_order_relaxed);
+  }
+
+  // calls f with each span that is still in the ring, oldest first
+  template <class F>
+  void for_each(F&& f) const {
+    auto next = next_.load(std::memory_order_acquire);
+    auto first = cleared_.load(std::memory_order_relaxed);
+    if (next - first > capacity) {
+      first = next - capacity;
+    }
+    for (auto i = first; i < next; ++i) {
+      f(events_[i % capacity]);
+    }
+  }
+};
+
+struct trace_registry {
+  std::atomic<bool> enabled{false};
+  std::chrono::steady_clock::time_point epoch =
+      std::chrono::steady_clock::now();
+  // only taken when a thread records its first span and when the rings are
+  // read. the rings are shared so that the spans of a thread outlive it.
+  std::mutex lock;
+  std::vector<std::shared_ptr<trace_ring>> rings;
+};
+
+inline trace_registry& trace_state() {
+  static trace_registry state;
+  return state;
+}
+
+inline std::int64_t trace_now() noexcept {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now() - trace_state().epoch)
+      .count();
+}
+
+inline trace_ring& this_thread_trace_ring() {
+  static thread_local const std::shared_ptr<trace_ring> ring = [] {
+    auto& state = trace_state();
+    std::lock_guard<std::mutex> guard{state.lock};
+    auto r = std::make_shared<trace_ring>(
+        static_cast<int>(state.rings.size()) + 1);
+    state.rings.push_back(r);
+    return r;
+  }();
+  return *ring;
+}
+
+// the name of the operator whose submit is running on this thread. the
+// receivers made while it is set are recorded under it.
+inline const char*& current_trace_operator() noexcept {
+  static thread_local const char* name = nullptr;
+  return name;
+}
+
+class trace_operator_scope {
+  const char* saved_;
+
+ public:
+  explicit trace_operator_scope(const char* name) noexcept
+      : saved_(current_trace_operator()) {
+    current_trace_operator() = name;
+  }
+  trace_operator_scope(const trace_operator_scope&) = delete;
+  trace_operator_scope& operator=(const trace_operator_scope&) = delete;
+  ~trace_operator_scope() {
+    current_trace_operator() = saved_;
+  }
+};
+
+class trace_span {
+  const char* name_;
+  trace_signal signal_;
+  std::int64_t begin_ns_ = 0;
+
+ public:
+  trace_span(const char* name, trace_signal signal) noexcept
+      : name_(
+            name != nullptr &&
+                    trace_state().enabled.load(std::memory_order_relaxed)
+                ? name
+                : nullptr),
+        signal_(signal) {
+    if (name_ != nullptr) {
+      begin_ns_ = trace_now();
+    }
+  }
+  trace_span(const trace_span&) = delete;
+  trace_span& operator=(const trace_span&) = delete;
+  ~trace_span() {
+    if (name_ != nullptr) {
+      this_thread_trace_ring().record(
+          trace_event{name_, signal_, begin_ns_, trace_now()});
+    }
+  }
+};
+
+// "transform" for pushmi::detail::transform_fn::submit_impl<...>. the name is
+// taken from the first enclosing class that ends in _fn.
+inline std::string trace_name_from_signature(const char* signature) {
+  std::string s = signature;
+  auto self = s.find("operator_name");
+  auto fn = s.find("_fn::", self == std::string::npos ? 0 : self);
+  if (fn == std::string::npos) {
+    return "operator";
+  }
+  auto begin = s.find_last_of(": <", fn);
+  begin = begin == std::string::npos ? 0 : begin + 1;
+  return s.substr(begin, fn - begin);
+}
+
+template <class Fn>
+const char* operator_name() {
+#if defined(_MSC_VER) && !defined(__clang__)
+  static const std::string name = trace_name_from_signature(__FUNCSIG__);
+#else
+  static const std::string name =
+      trace_name_from_signature(__PRETTY_FUNCTION__);
+#endif
+  return name.c_str();
+}
+
+// the submit function of an operator. the receivers that it makes are named
+// after the operator.
+template <class Fn>
+struct traced_submit {
+  Fn fn_;
+  const char* name_ = operator_name<Fn>();
+
+  PUSHMI_TEMPLATE(class... AN)
+  (requires Invocable<Fn&, AN...>) //
+  decltype(auto) operator()(AN&&... an) {
+    trace_operator_scope scope{name_};
+    return fn_((AN &&) an...);
+  }
+  PUSHMI_TEMPLATE(class... AN)
+  (requires Invocable<const Fn&, AN...>) //
+  decltype(auto) operator()(AN&&... an) const {
+    trace_operator_scope scope{name_};
+    return fn_((AN &&) an...);
+  }
+};
+
+template <class Out>
+class traced_receiver {
+  Out out_;
+  // nullptr when the receiver was not made by an operator
+  const char* name_;
+
+ public:
+  using properties = properties_t<Out>;
+
+  traced_receiver(Out out, const char* name)
+      : out_(std::move(out)), name_(name) {}
+
+  PUSHMI_TEMPLATE(class O = Out)
+  (requires //
+   requires(::pushmi::get_allocator(std::declval<O&>()))) //
+  auto get_allocator() {
+    return ::pushmi::get_allocator(out_);
+  }
+
+  PUSHMI_TEMPLATE(class... VN)
+  (requires ReceiveValue<Out&, VN...>) //
+  void value(VN&&... vn) {
+    trace_span span{name_, trace_signal::value};
+    set_value(out_, (VN &&) vn...);
+  }
+  PUSHMI_TEMPLATE(class E)
+  (requires ReceiveError<Out&, E>) //
+  void error(E&& e) noexcept {
+    trace_span span{name_, trace_signal::error};
+    set_error(out_, (E &&) e);
+  }
+  void done() {
+    trace_span span{name_, trace_signal::done};
+    set_done(out_);
+  }
+  PUSHMI_TEMPLATE(class Up)
+  (requires FlowUpTo<Out&, Up>) //
+  void starting(Up&& up) {
+    trace_span span{name_, trace_signal::starting};
+    set_starting(out_, (Up &&) up);
+  }
+};
+
+#if PUSHMI_TRACE
+template <class Out>
+traced_receiver<std::decay_t<Out>> trace_receiver(Out&& out) {
+  return {(Out &&) out, current_trace_operator()};
+}
+template <class Fn>
+traced_submit<std::decay_t<Fn>> trace_submit(Fn&& fn) {
+  return {(Fn &&) fn};
+}
+#else
+template <class Out>
+std::decay_t<Out> trace_receiver(Out&& out) {
+  return (Out &&) out;
+}
+template <class Fn>
+std::decay_t<Fn> trace_submit(Fn&& fn) {
+  return (Fn &&) fn;
+}
+#endif
+
+} // namespace detail
+
+inline void start_tracing() noexcept {
+  detail::trace_state().enabled.store(true, std::memory_order_relaxed);
+}
+
+inline void stop_tracing() noexcept {
+  detail::trace_state().enabled.store(false, std::memory_order_relaxed);
+}
+
+// drops the spans recorded so far
+inline void clear_trace() {
+  auto& state = detail::trace_state();
+  std::lock_guard<std::mutex> guard{state.lock};
+  for (auto& ring : state.rings) {
+    ring->clear();
+  }
+}
+
+// writes the spans in the chrome://tracing json format, one complete event
+// per span with the operator as the name and the signal as the category.
+//
+// the spans are read while the threads may still be recording. a thread that
+// records more than PUSHMI_TRACE_CAPACITY spans during the write may
+// overwrite spans as they are read, so stop the traced work first for an
+// exact trace.
+inline void write_chrome_trace(std::ostream& out) {
+  auto& state = detail::trace_state();
+  std::lock_guard<std::mutex> guard{state.lock};
+  out << "{\"traceEvents\":[";
+  const char* separator = "\n";
+  char buffer[256];
+  for (auto& ring : state.rings) {
+    ring->for_each([&](const detail::trace_event& e) {
+      std::snprintf(
+          buffer,
+          sizeof(buffer),
+          "{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,"
+          "\"dur\":%.3f,\"pid\":1,\"tid\":%d}",
+          e.name,
+          detail::trace_signal_name(e.signal),
+          e.begin_ns / 1000.0,
+          (e.end_ns - e.begin_ns) / 1000.0,
+          ring->tid());
+      out << separator << buffer;
+      separator = ",\n";
+    });
+  }
+  out << "\n],\"displayTimeUnit\":\"ns\"}\n";
+}
+
+} // namespace pushmi
@@ -19,6 +19,7 @@
 #include <memory>
 #include <mutex>
 
+#include <pushmi/detail/futex.h>
 #include <pushmi/forwards.h>
 
 namespace pushmi {
@@ -80,10 +81,20 @@ struct entangled {
   // In a couple places, we can save on some atomic ops by making this atomic,
   // and adding a "dual == null" fast-path without locking.
   entangled<Dual, T>* dual;
+  // Set when this side lost the last race, it is only touched by the thread
+  // that calls lockBoth() on this side.
+  bool lostRace = false;
 
   const static int kUnlocked = 0;
   const static int kLocked = 1;
   const static int kLockedAndLossAcknowledged = 2;
+  // Or-ed into the local lock by a side that lost the last race, so that it
+  // wins the next one (rather than using address-ordering, which would let
+  // the side at the lower address win every time).
+  const static int kPriority = 4;
+  // Set by the owning thread when it blocks on its own stateMachine; any
+  // other thread that stores to that stateMachine must wake it.
+  const static int kParked = 8;
 
   // Note: *not* thread-safe; it's a bug for two threads to concurrently call
   // lockBoth() on the same entangled (just as it's a bug for two threads to
@@ -93,6 +104,7 @@ struct entangled {
   // Note also that this may wait indefinitely; it's not the usual non-blocking
   // tryLock().
   bool tryLockBoth() {
+    const int priority = lostRace ? kPriority : 0;
     // Try to acquire the local lock. We have to start locally, since local
     // addresses are the only ones we know are safe at first. The rule is, you
     // have to hold *both* locks to write any of either entangled object's
@@ -100,7 +112,7 @@ struct entangled {
     int expected = kUnlocked;
     if (!stateMachine.compare_exchange_weak(
             expected,
-            kLocked,
+            kLocked | priority,
             std::memory_order_seq_cst,
             std::memory_order_relaxed)) {
       return false;
@@ -108,11 +120,13 @@ struct entangled {
     // Having *either* object local-locked protects the data in both objects.
     // Once we hold our lock, no control data can change, in either object.
     if (dual == nullptr) {
+      lostRace = false;
       return true;
     }
     expected = kUnlocked;
     if (dual->stateMachine.compare_exchange_strong(
             expected, kLocked, std::memory_order_seq_cst)) {
+      lostRace = false;
       return true;
     }
     // We got here, and so hit the race; we're deadlocked if we stick to
@@ -121,32 +135,44 @@ struct entangled {
     // addresses here are only stable *because* we know both sides are locked,
     // and because of the invariant that you must hold both locks to modify
     // either piece of data.
-    if ((uintptr_t)this < (uintptr_t)dual) {
+    // Both threads see the same pair of priority bits, each one was set with
+    // the local lock and does not change until the race is over, so they
+    // agree on the winner. Address-ordering breaks ties.
+    const int dualPriority = expected & kPriority;
+    const bool win = priority != dualPriority
+        ? priority != 0
+        : (uintptr_t)this < (uintptr_t)dual;
+    if (win) {
       // I get to win the race. I'll acquire the locks, but have to make sure
       // my memory stays valid until the other thread acknowledges its loss.
-      while (stateMachine.load(std::memory_order_relaxed) !=
-             kLockedAndLossAcknowledged) {
-        // Spin.
-      }
+      ::pushmi::detail::spin_then_park(stateMachine, kParked, [](int state) {
+        return state == kLockedAndLossAcknowledged;
+      });
       stateMachine.store(kLocked, std::memory_order_relaxed);
+      lostRace = false;
       return true;
     } else {
       // I lose the race, but have to coordinate with the winning thread, so
       // that it knows that I'm not about to try to touch it's data
-      dual->stateMachine.store(
-          kLockedAndLossAcknowledged, std::memory_order_relaxed);
+      auto winner = dual;
+      lostRace = true;
+      if (winner->stateMachine.exchange(
+              kLockedAndLossAcknowledged, std::memory_order_relaxed) &
+          kParked) {
+        ::pushmi::detail::futex_wake(winner->stateMachine);
+      }
       return false;
     }
   }
 
   void lockBoth() {
     while (!tryLockBoth()) {
-      // Spin. But, note that all the unbounded spinning in tryLockBoth can be
-      // straightforwardly futex-ified. There's a potentialy starvation issue
-      // here, but note that it can be dealt with by adding a "priority" bit to
-      // the state machine (i.e. if my priority bit is set, the thread for whom
-      // I'm the local member of the pair gets to win the race, rather than
-      // using address-ordering).
+      // The local lock is held by the thread on the other side, either
+      // because it locked both or because it won the race. Spin for a while
+      // and then block until that thread unlocks it, so that waiting does not
+      // burn whole timeslices when there are more threads than cores.
+      ::pushmi::detail::spin_then_park(
+          stateMachine, kParked, [](int state) { return state == kUnlocked; });
     }
   }
 
@@ -157,9 +183,14 @@ struct entangled {
     // other object so long as its locked. Going in the other order could let
     // another thread incorrectly think we're going down the deadlock-avoidance
     // path in tryLock().
+    // Only the owning thread parks on the local stateMachine, so the local
+    // store does not need to wake anyone.
     stateMachine.store(kUnlocked, std::memory_order_release);
-    if (dual != nullptr) {
-      dual->stateMachine.store(kUnlocked, std::memory_order_release);
+    auto other = dual;
+    if (other != nullptr &&
+        other->stateMachine.exchange(kUnlocked, std::memory_order_release) &
+            kParked) {
+      ::pushmi::detail::futex_wake(other->stateMachine);
     }
   }
 
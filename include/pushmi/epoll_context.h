@@ -0,0 +1,864 @@
+/*
+ * Copyright 2018-present Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#if defined(__linux__)
+
+#include <array>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <ctime>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <system_error>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+#include <pushmi/executor.h>
+#include <pushmi/flow_receiver.h>
+#include <pushmi/receiver.h>
+
+//
+// epoll_context is a reactor. the thread that calls run() waits in epoll for
+// file descriptors to become ready, for timers to become due and for work
+// scheduled from other threads, and signals the receivers that were waiting
+// for them.
+//
+// executor() is a time executor for the run() thread. schedule() queues an
+// item to run in fifo order, schedule(tp) queues it to run at tp on the
+// steady clock. a timerfd in the same epoll set wakes the thread for timers
+// and an eventfd wakes it for items scheduled from other threads.
+//
+// when_readable(fd) and when_writable(fd) are single senders that deliver fd
+// when it is ready. the descriptors are registered edge-triggered, so after
+// fd is delivered it must be read or written until EAGAIN before waiting for
+// it again. readable_stream(fd) is a flow many sender that reads chunks of fd
+// as they are requested and is done at end of file.
+//
+// the descriptors must be non-blocking. remove(fd) must be called before fd
+// is closed, the receivers that were waiting for it are signalled done.
+//
+
+namespace pushmi {
+
+class epoll_context;
+class epoll_executor;
+
+namespace detail {
+
+enum class epoll_signal { value, error, done };
+
+//
+// every receiver that waits in an epoll_context is held by an intrusive
+// operation. it is linked into one of the fifo lists of the context and is
+// completed once, on the run() thread.
+//
+
+class epoll_op {
+ public:
+  using complete_fn = void(epoll_op*, epoll_signal, std::exception_ptr);
+
+  explicit epoll_op(complete_fn* complete) : complete_(complete) {}
+
+  void complete(epoll_signal signal, std::exception_ptr e = {}) {
+    complete_(this, signal, std::move(e));
+  }
+
+  epoll_op* next_ = nullptr;
+  // the signal to complete with when the op reaches the ready list
+  epoll_signal signal_ = epoll_signal::value;
+  std::exception_ptr error_;
+
+ private:
+  complete_fn* complete_;
+};
+
+class epoll_op_list {
+  epoll_op* head_ = nullptr;
+  epoll_op* tail_ = nullptr;
+
+ public:
+  bool empty() const noexcept {
+    return head_ == nullptr;
+  }
+  void push(epoll_op* op) noexcept {
+    op->next_ = nullptr;
+    if (tail_ == nullptr) {
+      head_ = op;
+    } else {
+      tail_->next_ = op;
+    }
+    tail_ = op;
+  }
+  epoll_op* pop() noexcept {
+    auto op = head_;
+    if (op != nullptr) {
+      head_ = op->next_;
+      tail_ = head_ == nullptr ? nullptr : tail_;
+      op->next_ = nullptr;
+    }
+    return op;
+  }
+  // returns false when op is not in this list
+  bool remove(epoll_op* op) noexcept {
+    epoll_op* prev = nullptr;
+    for (auto it = head_; it != nullptr; prev = it, it = it->next_) {
+      if (it != op) {
+        continue;
+      }
+      (prev == nullptr ? head_ : prev->next_) = op->next_;
+      if (tail_ == op) {
+        tail_ = prev;
+      }
+      op->next_ = nullptr;
+      return true;
+    }
+    return false;
+  }
+  // moves every op of other to the end of this list
+  void splice(epoll_op_list& other) noexcept {
+    if (other.empty()) {
+      return;
+    }
+    if (tail_ == nullptr) {
+      head_ = other.head_;
+    } else {
+      tail_->next_ = other.head_;
+    }
+    tail_ = other.tail_;
+    other.head_ = other.tail_ = nullptr;
+  }
+};
+
+struct epoll_timer {
+  std::chrono::steady_clock::time_point when;
+  std::uint64_t order;
+  epoll_op* op;
+};
+inline bool operator>(const epoll_timer& l, const epoll_timer& r) {
+  return l.when > r.when || (l.when == r.when && l.order > r.order);
+}
+
+struct epoll_fd_state {
+  explicit epoll_fd_state(int f) : fd(f) {}
+  int fd;
+  // an edge that arrived while nothing was waiting for it
+  bool readable = false;
+  bool writable = false;
+  bool removed = false;
+  epoll_op_list readers;
+  epoll_op_list writers;
+};
+
+//
+// the op of a submitted receiver is allocated with the allocator of the
+// receiver and deletes itself after it has been signalled. on value it
+// delivers V and then done.
+//
+
+template <class Out, class V>
+class epoll_receiver_op : public epoll_op {
+  using allocator_t = allocator_for_t<epoll_receiver_op, Out>;
+  using traits_t = std::allocator_traits<allocator_t>;
+  Out out_;
+  V v_;
+
+  struct deleter {
+    void operator()(epoll_receiver_op* self) const {
+      allocator_t alloc{::pushmi::get_allocator(self->out_)};
+      traits_t::destroy(alloc, self);
+      traits_t::deallocate(alloc, self, 1);
+    }
+  };
+
+  static void
+  complete_impl(epoll_op* op, epoll_signal signal, std::exception_ptr e) {
+    std::unique_ptr<epoll_receiver_op, deleter> self{
+        static_cast<epoll_receiver_op*>(op)};
+    switch (signal) {
+      case epoll_signal::value:
+        ::pushmi::set_value(self->out_, self->v_);
+        ::pushmi::set_done(self->out_);
+        break;
+      case epoll_signal::error:
+        ::pushmi::set_error(self->out_, std::move(e));
+        break;
+      case epoll_signal::done:
+        ::pushmi::set_done(self->out_);
+        break;
+    }
+  }
+
+ public:
+  epoll_receiver_op(Out out, V v)
+      : epoll_op(&complete_impl), out_(std::move(out)), v_(std::move(v)) {}
+
+  template <class SOut>
+  static epoll_op* make(SOut&& out, V v) {
+    allocator_t alloc{::pushmi::get_allocator(out)};
+    auto p = traits_t::allocate(alloc, 1);
+    try {
+      traits_t::construct(alloc, p, (SOut &&) out, std::move(v));
+    } catch (...) {
+      traits_t::deallocate(alloc, p, 1);
+      throw;
+    }
+    return p;
+  }
+};
+
+inline void epoll_check(int result, const char* what) {
+  if (result < 0) {
+    throw std::system_error(errno, std::system_category(), what);
+  }
+}
+
+} // namespace detail
+
+class epoll_context {
+ public:
+  using clock = std::chrono::steady_clock;
+  using time_point = clock::time_point;
+
+  epoll_context() {
+    epoll_fd_ = ::epoll_create1(EPOLL_CLOEXEC);
+    detail::epoll_check(epoll_fd_, "epoll_create1");
+    wake_fd_ = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    timer_fd_ = ::timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (wake_fd_ < 0 || timer_fd_ < 0) {
+      auto error = errno;
+      close_fds();
+      throw std::system_error(error, std::system_category(), "eventfd");
+    }
+    try {
+      watch(wake_fd_, &wake_fd_, EPOLLIN);
+      watch(timer_fd_, &timer_fd_, EPOLLIN);
+    } catch (...) {
+      close_fds();
+      throw;
+    }
+  }
+  epoll_context(const epoll_context&) = delete;
+  epoll_context& operator=(const epoll_context&) = delete;
+
+  // run() must have returned. the receivers that are still waiting are
+  // signalled done.
+  ~epoll_context() {
+    for (;;) {
+      detail::epoll_op_list pending;
+      {
+        std::lock_guard<std::mutex> guard{lock_};
+        pending.splice(ready_);
+        while (!timers_.empty()) {
+          pending.push(timers_.top().op);
+          timers_.pop();
+        }
+        for (auto& fd : fds_) {
+          pending.splice(fd.second->readers);
+          pending.splice(fd.second->writers);
+        }
+      }
+      if (pending.empty()) {
+        break;
+      }
+      while (auto op = pending.pop()) {
+        op->complete(detail::epoll_signal::done);
+      }
+    }
+    close_fds();
+  }
+
+  epoll_executor executor();
+
+  // signals the waiting receivers on this thread until stop() is called.
+  void run() {
+    std::array<epoll_event, 64> events;
+    detail::epoll_op_list batch;
+    for (;;) {
+      std::unique_lock<std::mutex> guard{lock_};
+      if (stopped_) {
+        stopped_ = false;
+        return;
+      }
+      take_due_timers(clock::now());
+      batch.splice(ready_);
+      bool block = batch.empty();
+      sleeping_ = block;
+      guard.unlock();
+
+      try {
+        while (auto op = batch.pop()) {
+          op->complete(op->signal_, std::move(op->error_));
+        }
+      } catch (...) {
+        // the rest of the batch is signalled by the next run()
+        guard.lock();
+        batch.splice(ready_);
+        ready_.splice(batch);
+        throw;
+      }
+
+      int count = ::epoll_wait(
+          epoll_fd_,
+          events.data(),
+          static_cast<int>(events.size()),
+          block ? -1 : 0);
+      if (count < 0 && errno != EINTR) {
+        detail::epoll_check(count, "epoll_wait");
+      }
+
+      guard.lock();
+      sleeping_ = false;
+      for (int i = 0; i < count; ++i) {
+        ready(events[i]);
+      }
+      // no event that refers to a removed fd can be returned after this
+      removed_.clear();
+    }
+  }
+
+  // makes run() return after the items that are running now. it can be
+  // called from any thread, run() can be called again afterwards.
+  void stop() {
+    std::lock_guard<std::mutex> guard{lock_};
+    stopped_ = true;
+    wake();
+  }
+
+  // stops waiting for fd and signals done to the receivers that were
+  // waiting for it. call this before fd is closed.
+  void remove(int fd) {
+    std::lock_guard<std::mutex> guard{lock_};
+    auto found = fds_.find(fd);
+    if (found == fds_.end()) {
+      return;
+    }
+    auto& state = found->second;
+    ::epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, fd, nullptr);
+    state->removed = true;
+    for (auto list : {&state->readers, &state->writers}) {
+      while (auto op = list->pop()) {
+        op->signal_ = detail::epoll_signal::done;
+        ready_.push(op);
+      }
+    }
+    removed_.push_back(std::move(state));
+    fds_.erase(found);
+    wake();
+  }
+
+  class task;
+  template <bool Write>
+  class readiness_sender;
+  class stream_sender;
+
+  readiness_sender<false> when_readable(int fd);
+  readiness_sender<true> when_writable(int fd);
+  stream_sender readable_stream(int fd, std::size_t chunk_size = 4096);
+
+  // queues op to be completed on the run() thread
+  void post(detail::epoll_op* op) {
+    std::lock_guard<std::mutex> guard{lock_};
+    ready_.push(op);
+    wake();
+  }
+  void post_at(time_point when, detail::epoll_op* op) {
+    std::lock_guard<std::mutex> guard{lock_};
+    timers_.push(detail::epoll_timer{when, order_++, op});
+    arm();
+  }
+  // queues op to be completed when fd is ready to read, or to write. when
+  // fd cannot be watched, op is completed with the error instead.
+  void post_when_ready(int fd, bool write, detail::epoll_op* op) {
+    std::lock_guard<std::mutex> guard{lock_};
+    auto found = fds_.find(fd);
+    if (found == fds_.end()) {
+      auto added = std::make_unique<detail::epoll_fd_state>(fd);
+      try {
+        watch(fd, added.get(), EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET);
+      } catch (...) {
+        op->signal_ = detail::epoll_signal::error;
+        op->error_ = std::current_exception();
+        ready_.push(op);
+        wake();
+        return;
+      }
+      found = fds_.emplace(fd, std::move(added)).first;
+    }
+    auto& state = found->second;
+    auto& edge = write ? state->writable : state->readable;
+    if (edge) {
+      // use up the edge that arrived while nothing was waiting
+      edge = false;
+      ready_.push(op);
+      wake();
+    } else {
+      (write ? state->writers : state->readers).push(op);
+    }
+  }
+  // takes an op that was queued by post_when_ready() off the list of fd.
+  // returns false when the op is not waiting, it has been or will be
+  // completed.
+  bool cancel_when_ready(int fd, bool write, detail::epoll_op* op) {
+    std::lock_guard<std::mutex> guard{lock_};
+    auto found = fds_.find(fd);
+    if (found == fds_.end()) {
+      return false;
+    }
+    auto& state = found->second;
+    return (write ? state->writers : state->readers).remove(op);
+  }
+
+ private:
+  int epoll_fd_ = -1;
+  int wake_fd_ = -1;
+  int timer_fd_ = -1;
+
+  std::mutex lock_;
+  detail::epoll_op_list ready_;
+  std::priority_queue<
+      detail::epoll_timer,
+      std::vector<detail::epoll_timer>,
+      std::greater<>>
+      timers_;
+  std::uint64_t order_ = 0;
+  time_point armed_ = time_point::max();
+  std::unordered_map<int, std::unique_ptr<detail::epoll_fd_state>> fds_;
+  std::vector<std::unique_ptr<detail::epoll_fd_state>> removed_;
+  bool sleeping_ = false;
+  bool stopped_ = false;
+
+  void close_fds() noexcept {
+    for (auto fd : {timer_fd_, wake_fd_, epoll_fd_}) {
+      if (fd >= 0) {
+        ::close(fd);
+      }
+    }
+  }
+
+  void watch(int fd, void* tag, std::uint32_t events) {
+    epoll_event e{};
+    e.events = events;
+    e.data.ptr = tag;
+    detail::epoll_check(
+        ::epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &e), "epoll_ctl");
+  }
+
+  // the lock is held by the callers of these
+
+  void wake() {
+    if (sleeping_) {
+      sleeping_ = false;
+      std::uint64_t one = 1;
+      auto written = ::write(wake_fd_, &one, sizeof(one));
+      (void)written;
+    }
+  }
+
+  void arm() {
+    auto when = timers_.empty() ? time_point::max() : timers_.top().when;
+    if (when == armed_) {
+      return;
+    }
+    armed_ = when;
+    itimerspec spec{};
+    if (when != time_point::max()) {
+      auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    when.time_since_epoch())
+                    .count();
+      // a zero time would disarm the timer
+      ns = ns <= 0 ? 1 : ns;
+      spec.it_value.tv_sec = static_cast<time_t>(ns / 1000000000);
+      spec.it_value.tv_nsec = static_cast<long>(ns % 1000000000);
+    }
+    ::timerfd_settime(timer_fd_, TFD_TIMER_ABSTIME, &spec, nullptr);
+  }
+
+  void take_due_timers(time_point now) {
+    while (!timers_.empty() && timers_.top().when <= now) {
+      auto op = timers_.top().op;
+      timers_.pop();
+      op->signal_ = detail::epoll_signal::value;
+      ready_.push(op);
+    }
+    arm();
+  }
+
+  void ready(const epoll_event& e) {
+    if (e.data.ptr == &wake_fd_ || e.data.ptr == &timer_fd_) {
+      std::uint64_t count;
+      auto drained =
+          ::read(*static_cast<int*>(e.data.ptr), &count, sizeof(count));
+      (void)drained;
+      if (e.data.ptr == &timer_fd_) {
+        // rearmed when the due timers are taken
+        armed_ = time_point::max();
+      }
+      return;
+    }
+    auto state = static_cast<detail::epoll_fd_state*>(e.data.ptr);
+    if (state->removed) {
+      return;
+    }
+    // errors and hang ups are delivered as readiness, the read or write
+    // that follows reports them
+    const std::uint32_t closed = EPOLLERR | EPOLLHUP;
+    if (e.events & (EPOLLIN | EPOLLRDHUP | closed)) {
+      if (state->readers.empty()) {
+        state->readable = true;
+      }
+      ready_.splice(state->readers);
+    }
+    if (e.events & (EPOLLOUT | closed)) {
+      if (state->writers.empty()) {
+        state->writable = true;
+      }
+      ready_.splice(state->writers);
+    }
+  }
+};
+
+//
+// the executor delivers itself to the receivers of its tasks
+//
+
+class epoll_executor {
+  epoll_context* context_;
+
+ public:
+  using properties = property_set<is_time<>, is_fifo_sequence<>>;
+
+  explicit epoll_executor(epoll_context& context) : context_(&context) {}
+
+  epoll_context& context() const {
+    return *context_;
+  }
+
+  epoll_context::time_point top() {
+    return epoll_context::clock::now();
+  }
+  epoll_context::task schedule();
+  epoll_context::task schedule(epoll_context::time_point tp);
+
+  friend bool operator==(const epoll_executor& l, const epoll_executor& r) {
+    return l.context_ == r.context_;
+  }
+  friend bool operator!=(const epoll_executor& l, const epoll_executor& r) {
+    return !(l == r);
+  }
+};
+
+class epoll_context::task {
+  epoll_context* context_;
+  bool timed_;
+  time_point when_;
+
+ public:
+  using properties =
+      property_set<is_sender<>, is_never_blocking<>, is_single<>>;
+
+  task(epoll_context& context, bool timed, time_point when)
+      : context_(&context), timed_(timed), when_(when) {}
+
+  PUSHMI_TEMPLATE(class Out)
+  (requires ReceiveValue<Out&, epoll_executor>&&
+       ReceiveError<Out, std::exception_ptr>) //
+  void submit(Out out) {
+    auto op = detail::epoll_receiver_op<Out, epoll_executor>::make(
+        std::move(out), epoll_executor{*context_});
+    if (timed_) {
+      context_->post_at(when_, op);
+    } else {
+      context_->post(op);
+    }
+  }
+};
+
+template <bool Write>
+class epoll_context::readiness_sender {
+  epoll_context* context_;
+  int fd_;
+
+ public:
+  using properties =
+      property_set<is_sender<>, is_never_blocking<>, is_single<>>;
+
+  readiness_sender(epoll_context& context, int fd)
+      : context_(&context), fd_(fd) {}
+
+  PUSHMI_TEMPLATE(class Out)
+  (requires ReceiveValue<Out&, int>&& ReceiveError<Out, std::exception_ptr>) //
+  void submit(Out out) {
+    context_->post_when_ready(
+        fd_,
+        Write,
+        detail::epoll_receiver_op<Out, int>::make(std::move(out), fd_));
+  }
+};
+
+namespace detail {
+
+//
+// the state of a readable_stream is shared by the up receiver given to the
+// out receiver and by the op that waits for the fd. it is only used on the
+// run() thread.
+//
+
+template <class Out>
+class epoll_stream : public epoll_op {
+ public:
+  epoll_stream(epoll_context& context, int fd, std::size_t chunk, Out out)
+      : epoll_op(&complete_impl),
+        context_(&context),
+        fd_(fd),
+        chunk_(chunk),
+        out_(std::move(out)) {}
+
+  epoll_context* context_;
+  int fd_;
+  std::size_t chunk_;
+  Out out_;
+  std::ptrdiff_t requested_ = 0;
+  bool started_ = false;
+  bool stopped_ = false;
+  // holds this stream while it waits for fd
+  std::shared_ptr<epoll_stream> waiting_;
+
+  void stop() {
+    if (stopped_) {
+      return;
+    }
+    stopped_ = true;
+    // a stream that waits for fd holds itself, stop waiting so that it is
+    // released now rather than when fd becomes readable or is removed. the
+    // caller holds a reference, so this is not destroyed here.
+    if (!!waiting_ && context_->cancel_when_ready(fd_, false, this)) {
+      waiting_.reset();
+    }
+    ::pushmi::set_done(out_);
+  }
+  void start(const std::shared_ptr<epoll_stream>& self);
+  void fail(std::exception_ptr e) {
+    if (!stopped_) {
+      stopped_ = true;
+      ensure_started();
+      ::pushmi::set_error(out_, std::move(e));
+    }
+  }
+  // the context completed a task without running it, it is being
+  // destroyed and must not be used again.
+  void abandon() {
+    if (!stopped_) {
+      stopped_ = true;
+      ensure_started();
+      ::pushmi::set_done(out_);
+    }
+  }
+
+  // reads until the requests are met, fd would block or fd has ended
+  void pump(const std::shared_ptr<epoll_stream>& self) {
+    while (!stopped_ && requested_ > 0) {
+      std::vector<char> chunk(chunk_);
+      auto n = ::read(fd_, chunk.data(), chunk.size());
+      if (n > 0) {
+        chunk.resize(static_cast<std::size_t>(n));
+        --requested_;
+        ::pushmi::set_value(out_, std::move(chunk));
+      } else if (n == 0) {
+        stop();
+      } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+        if (!waiting_) {
+          waiting_ = self;
+          context_->post_when_ready(fd_, false, this);
+        }
+        return;
+      } else if (errno != EINTR) {
+        stopped_ = true;
+        ::pushmi::set_error(
+            out_,
+            std::make_exception_ptr(
+                std::system_error(errno, std::system_category(), "read")));
+      }
+    }
+  }
+
+ private:
+  // out must be started before it is signalled done or error
+  void ensure_started() {
+    if (!started_) {
+      started_ = true;
+      ::pushmi::set_starting(out_, receiver<>{});
+    }
+  }
+
+  static void
+  complete_impl(epoll_op* op, epoll_signal signal, std::exception_ptr e) {
+    auto self = std::move(static_cast<epoll_stream*>(op)->waiting_);
+    if (signal == epoll_signal::value) {
+      self->pump(self);
+    } else if (signal == epoll_signal::error) {
+      self->fail(std::move(e));
+    } else {
+      self->stop();
+    }
+  }
+};
+
+// runs f with the stream on the run() thread. a task that is completed
+// without a value, because the context was destroyed first, abandons the
+// stream so that its out receiver is still signalled.
+template <class Stream, class F>
+struct epoll_stream_task {
+  using properties = property_set<is_receiver<>>;
+
+  std::shared_ptr<Stream> s_;
+  F f_;
+  bool ran_ = false;
+
+  template <class Exec>
+  void value(Exec&&) {
+    ran_ = true;
+    f_(s_);
+  }
+  void error(std::exception_ptr e) noexcept {
+    s_->fail(std::move(e));
+  }
+  void done() {
+    if (!ran_) {
+      s_->abandon();
+    }
+  }
+};
+
+template <class Stream, class F>
+epoll_stream_task<Stream, F> make_epoll_stream_task(
+    std::shared_ptr<Stream> s,
+    F f) {
+  return {std::move(s), std::move(f)};
+}
+
+template <class Stream>
+struct epoll_stream_up {
+  using properties = properties_t<receiver<>>;
+
+  std::shared_ptr<Stream> s_;
+
+  void value(std::ptrdiff_t requested) {
+    if (requested < 1) {
+      return;
+    }
+    auto ex = s_->context_->executor();
+    ::pushmi::submit(
+        ::pushmi::schedule(ex),
+        make_epoll_stream_task(s_, [requested](auto& self) {
+          self->requested_ += requested;
+          self->pump(self);
+        }));
+  }
+  template <class E>
+  void error(E) noexcept {
+    done();
+  }
+  void done() {
+    auto ex = s_->context_->executor();
+    ::pushmi::submit(
+        ::pushmi::schedule(ex),
+        make_epoll_stream_task(s_, [](auto& self) { self->stop(); }));
+  }
+};
+
+template <class Out>
+void epoll_stream<Out>::start(const std::shared_ptr<epoll_stream>& self) {
+  if (!started_) {
+    started_ = true;
+    ::pushmi::set_starting(
+        out_, ::pushmi::make_receiver(epoll_stream_up<epoll_stream>{self}));
+  }
+}
+
+} // namespace detail
+
+class epoll_context::stream_sender {
+  epoll_context* context_;
+  int fd_;
+  std::size_t chunk_;
+
+ public:
+  using properties = property_set<
+      is_sender<>,
+      is_flow<>,
+      is_many<>,
+      is_never_blocking<>>;
+
+  stream_sender(epoll_context& context, int fd, std::size_t chunk)
+      : context_(&context), fd_(fd), chunk_(chunk) {}
+
+  PUSHMI_TEMPLATE(class Out)
+  (requires ReceiveValue<Out&, std::vector<char>>&&
+       ReceiveError<Out, std::exception_ptr>) //
+  void submit(Out out) {
+    using stream_t = detail::epoll_stream<Out>;
+    auto alloc = ::pushmi::get_allocator(out);
+    auto s = std::allocate_shared<stream_t>(
+        alloc, *context_, fd_, chunk_, std::move(out));
+    // the out receiver is only used on the run() thread. when the context
+    // is destroyed before the start runs, out is signalled done.
+    auto ex = context_->executor();
+    ::pushmi::submit(
+        ::pushmi::schedule(ex),
+        detail::make_epoll_stream_task(
+            s, [](auto& self) { self->start(self); }));
+  }
+};
+
+inline epoll_executor epoll_context::executor() {
+  return epoll_executor{*this};
+}
+
+inline epoll_context::readiness_sender<false> epoll_context::when_readable(
+    int fd) {
+  return {*this, fd};
+}
+inline epoll_context::readiness_sender<true> epoll_context::when_writable(
+    int fd) {
+  return {*this, fd};
+}
+inline epoll_context::stream_sender epoll_context::readable_stream(
+    int fd,
+    std::size_t chunk_size) {
+  return {*this, fd, chunk_size};
+}
+
+inline epoll_context::task epoll_executor::schedule() {
+  return {*context_, false, {}};
+}
+inline epoll_context::task epoll_executor::schedule(
+    epoll_context::time_point tp) {
+  return {*context_, true, tp};
+}
+
+} // namespace pushmi
+
+#endif // defined(__linux__)
@@ -17,6 +17,7 @@
 
 #include <functional>
 #include <future>
+#include <memory>
 
 #include <pushmi/forwards.h>
 #include <pushmi/properties.h>
@@ -75,6 +76,14 @@ PUSHMI_TEMPLATE(class SD)
   return sd.make_strand();
 }
 
+PUSHMI_TEMPLATE(class SD)
+(requires //
+ requires(std::declval<SD&>().get_allocator())) //
+    auto get_allocator(SD& sd) //
+    noexcept(noexcept(sd.get_allocator())) {
+  return sd.get_allocator();
+}
+
 PUSHMI_TEMPLATE(class SD, class Out)
 (requires //
  requires(std::declval<SD>().submit(std::declval<Out>()))) //
@@ -83,6 +92,22 @@ PUSHMI_TEMPLATE(class SD, class Out)
   ((SD &&) sd).submit((Out &&) out);
 }
 
+PUSHMI_TEMPLATE(class SD, class Out)
+(requires //
+ requires(std::declval<SD>().connect(std::declval<Out>()))) //
+    auto connect(SD&& sd, Out&& out) //
+    noexcept(noexcept(((SD &&) sd).connect((Out &&) out))) {
+  return ((SD &&) sd).connect((Out &&) out);
+}
+
+PUSHMI_TEMPLATE(class Op)
+(requires //
+ requires(std::declval<Op&>().start())) //
+    void start(Op& op) //
+    noexcept(noexcept(op.start())) {
+  op.start();
+}
+
 PUSHMI_TEMPLATE(class SD)
 (requires //
  requires(std::declval<SD&>().top())) //
@@ -158,6 +183,14 @@ PUSHMI_TEMPLATE(class SD)
   return make_strand(*sd);
 }
 
+PUSHMI_TEMPLATE(class SD)
+(requires //
+ requires(get_allocator(*std::declval<SD>()))) //
+    auto get_allocator(SD&& sd) //
+    noexcept(noexcept(get_allocator(*sd))) {
+  return get_allocator(*sd);
+}
+
 PUSHMI_TEMPLATE(class SD, class Out)
 (requires //
  requires(submit(*std::declval<SD>(), std::declval<Out>()))) //
@@ -166,6 +199,22 @@ PUSHMI_TEMPLATE(class SD, class Out)
   submit(*sd, (Out &&) out);
 }
 
+PUSHMI_TEMPLATE(class SD, class Out)
+(requires //
+ requires(connect(*std::declval<SD>(), std::declval<Out>()))) //
+    auto connect(SD&& sd, Out&& out) //
+    noexcept(noexcept(connect(*sd, (Out &&) out))) {
+  return connect(*sd, (Out &&) out);
+}
+
+PUSHMI_TEMPLATE(class Op)
+(requires //
+ requires(start(*std::declval<Op>()))) //
+    void start(Op&& op) //
+    noexcept(noexcept(start(*op))) {
+  start(*op);
+}
+
 PUSHMI_TEMPLATE(class SD)
 (requires //
  requires(top(*std::declval<SD>()))) //
@@ -334,6 +383,31 @@ struct make_strand_fn {
   }
 };
 
+template <class SD, class = void>
+struct has_allocator : std::false_type {};
+template <class SD>
+struct has_allocator<
+    SD,
+    void_t<decltype(get_allocator(std::declval<SD&>()))>>
+    : std::true_type {};
+
+// a receiver that has no allocator gets std::allocator
+struct get_allocator_fn {
+  PUSHMI_TEMPLATE(class SD)
+  (requires has_allocator<SD>::value) //
+      auto
+      operator()(SD& sd) const //
+      noexcept(noexcept(get_allocator(sd))) {
+    return get_allocator(sd);
+  }
+  PUSHMI_TEMPLATE(class SD)
+  (requires not has_allocator<SD>::value) //
+      std::allocator<char>
+      operator()(SD&) const noexcept {
+    return {};
+  }
+};
+
 struct do_submit_fn {
   PUSHMI_TEMPLATE(class SD, class Out)
   (requires //
@@ -345,6 +419,74 @@ struct do_submit_fn {
   }
 };
 
+//
+// connect(sender, receiver) returns an operation state and start(op) starts
+// the operation. the operation state can be moved until it is started, and
+// must then stay at the same address until the receiver has been signalled.
+// a sender can therefore keep the state of the operation in the operation
+// state, on the stack of the caller or inside of a parent operation state,
+// instead of in a heap allocation.
+//
+// a sender that only supports submit is connected to an operation state that
+// holds the sender and the receiver and submits them when it is started.
+//
+
+template <class SD, class Out>
+struct submit_operation {
+  SD sd_;
+  Out out_;
+  void start() {
+    submit(std::move(sd_), std::move(out_));
+  }
+};
+
+template <class SD, class Out, class = void>
+struct has_connect : std::false_type {};
+template <class SD, class Out>
+struct has_connect<
+    SD,
+    Out,
+    void_t<decltype(connect(std::declval<SD>(), std::declval<Out>()))>>
+    : std::true_type {};
+
+template <class SD, class Out, class = void>
+struct has_submit : std::false_type {};
+template <class SD, class Out>
+struct has_submit<
+    SD,
+    Out,
+    void_t<decltype(submit(std::declval<SD>(), std::declval<Out>()))>>
+    : std::true_type {};
+
+struct do_connect_fn {
+  PUSHMI_TEMPLATE(class SD, class Out)
+  (requires has_connect<SD, Out>::value) //
+      auto
+      operator()(SD&& s, Out&& out) const //
+      noexcept(noexcept(connect((SD &&) s, (Out &&) out))) {
+    return connect((SD &&) s, (Out &&) out);
+  }
+  PUSHMI_TEMPLATE(class SD, class Out)
+  (requires not has_connect<SD, Out>::value &&
+       has_submit<std::decay_t<SD>, std::decay_t<Out>>::value) //
+      auto
+      operator()(SD&& s, Out&& out) const {
+    return submit_operation<std::decay_t<SD>, std::decay_t<Out>>{(SD &&) s,
+                                                                 (Out &&) out};
+  }
+};
+
+struct do_start_fn {
+  PUSHMI_TEMPLATE(class Op)
+  (requires //
+   requires(start(std::declval<Op&>()))) //
+      void
+      operator()(Op& op) const //
+      noexcept(noexcept(start(op))) {
+    start(op);
+  }
+};
+
 struct do_schedule_fn {
   PUSHMI_TEMPLATE(class SD, class... VN)
   (requires //
@@ -375,11 +517,25 @@ PUSHMI_INLINE_VAR constexpr __adl::set_value_fn set_value{};
 PUSHMI_INLINE_VAR constexpr __adl::set_starting_fn set_starting{};
 PUSHMI_INLINE_VAR constexpr __adl::get_executor_fn get_executor{};
 PUSHMI_INLINE_VAR constexpr __adl::make_strand_fn make_strand{};
+PUSHMI_INLINE_VAR constexpr __adl::get_allocator_fn get_allocator{};
 PUSHMI_INLINE_VAR constexpr __adl::do_submit_fn submit{};
+PUSHMI_INLINE_VAR constexpr __adl::do_connect_fn connect{};
+PUSHMI_INLINE_VAR constexpr __adl::do_start_fn start{};
 PUSHMI_INLINE_VAR constexpr __adl::do_schedule_fn schedule{};
 PUSHMI_INLINE_VAR constexpr __adl::get_top_fn now{};
 PUSHMI_INLINE_VAR constexpr __adl::get_top_fn top{};
 
+// the type of the operation state returned by connect(sd, out)
+template <class SD, class Out>
+using operation_state_t =
+    decltype(::pushmi::connect(std::declval<SD>(), std::declval<Out>()));
+
+// the allocator of SD rebound to T, used for the state that is allocated on
+// behalf of a receiver.
+template <class T, class SD>
+using allocator_for_t = typename std::allocator_traits<std::decay_t<decltype(
+    ::pushmi::get_allocator(std::declval<SD&>()))>>::template rebind_alloc<T>;
+
 template <class T>
 struct property_set_traits<T*> : property_set_traits<T> {};
 
@@ -162,6 +162,19 @@ class flow_single_sender<Data, DSF> {
   void submit(Out out) {
     sf_(data_, std::move(out));
   }
+
+  PUSHMI_TEMPLATE(class Out, class SF = DSF)
+    (requires requires(std::declval<SF&>().connect(
+        std::declval<Data&>(), std::declval<Out>())))
+  auto connect(Out out) & {
+    return sf_.connect(data_, std::move(out));
+  }
+  PUSHMI_TEMPLATE(class Out, class SF = DSF)
+    (requires requires(std::declval<SF&>().connect(
+        std::declval<Data&&>(), std::declval<Out>())))
+  auto connect(Out out) && {
+    return sf_.connect(std::move(data_), std::move(out));
+  }
 };
 
 template <>
@@ -0,0 +1,310 @@
+/*
+ * Copyright 2018-present Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <thread>
+
+#include <pushmi/executor.h>
+
+namespace pushmi {
+
+//
+// instrumented(ex, sink) wraps an executor so that every item it runs
+// reports how long it waited in the queue, from submit to the start of
+// set_value, and how long it ran, from the start of set_value to set_done.
+// the wrapper has the properties of ex and forwards schedule() and top(), so
+// it can stand in for ex.
+//
+// sink is a pointer, or a smart pointer, to an object with
+// record(queue_delay, run_time). executor_stats is such an object.
+//
+
+// durations in power of two buckets. bucket 0 counts zero and bucket i counts
+// the durations from 2^(i-1) to 2^i - 1 nanoseconds.
+struct duration_histogram {
+  static constexpr int bucket_count = 65;
+
+  std::array<std::uint64_t, bucket_count> buckets{};
+  std::uint64_t count = 0;
+  std::uint64_t total_ns = 0;
+  std::uint64_t max_ns = 0;
+
+  static int bucket_of(std::uint64_t ns) noexcept {
+    int bucket = 0;
+    while (ns != 0) {
+      ns >>= 1;
+      ++bucket;
+    }
+    return bucket;
+  }
+
+  double mean_ns() const noexcept {
+    return count == 0 ? 0.0 : static_cast<double>(total_ns) / count;
+  }
+
+  // the top of the bucket that holds the percentile, so at most twice the
+  // exact value
+  std::uint64_t percentile_ns(double percent) const noexcept {
+    auto target = static_cast<std::uint64_t>(percent / 100.0 * count + 0.5);
+    target = target == 0 ? 1 : target;
+    std::uint64_t seen = 0;
+    for (int i = 0; i < bucket_count; ++i) {
+      seen += buckets[i];
+      if (seen >= target) {
+        auto top = i == 0 ? 0 : i == 64 ? ~std::uint64_t{0}
+                                        : (std::uint64_t{1} << i) - 1;
+        return top < max_ns ? top : max_ns;
+      }
+    }
+    return max_ns;
+  }
+};
+
+// a sink that keeps histograms of the queue delay and the run time.
+//
+// record() is lock-free. each thread records into one of a few shards chosen
+// by its thread id, so that threads seldom write the same cache lines. the
+// histograms are summed over the shards when they are read.
+class executor_stats {
+  static constexpr int shard_count = 16;
+
+  struct histogram {
+    std::array<std::atomic<std::uint64_t>, duration_histogram::bucket_count>
+        buckets;
+    std::atomic<std::uint64_t> count;
+    std::atomic<std::uint64_t> total_ns;
+    std::atomic<std::uint64_t> max_ns;
+
+    void reset() noexcept {
+      for (auto& b : buckets) {
+        b.store(0, std::memory_order_relaxed);
+      }
+      count.store(0, std::memory_order_relaxed);
+      total_ns.store(0, std::memory_order_relaxed);
+      max_ns.store(0, std::memory_order_relaxed);
+    }
+    void record(std::uint64_t ns) noexcept {
+      buckets[duration_histogram::bucket_of(ns)].fetch_add(
+          1, std::memory_order_relaxed);
+      count.fetch_add(1, std::memory_order_relaxed);
+      total_ns.fetch_add(ns, std::memory_order_relaxed);
+      auto max = max_ns.load(std::memory_order_relaxed);
+      while (ns > max &&
+             !max_ns.compare_exchange_weak(
+                 max, ns, std::memory_order_relaxed)) {
+      }
+    }
+    void add_to(duration_histogram& h) const noexcept {
+      for (int i = 0; i < duration_histogram::bucket_count; ++i) {
+        h.buckets[i] += buckets[i].load(std::memory_order_relaxed);
+      }
+      h.count += count.load(std::memory_order_relaxed);
+      h.total_ns += total_ns.load(std::memory_order_relaxed);
+      auto max = max_ns.load(std::memory_order_relaxed);
+      h.max_ns = max > h.max_ns ? max : h.max_ns;
+    }
+  };
+
+  struct shard {
+    histogram queue_delay;
+    histogram run_time;
+    // keeps the next shard off of the last cache line of this one
+    char padding[64];
+  };
+
+  std::array<shard, shard_count> shards_;
+
+  static shard& this_thread_shard(executor_stats& stats) noexcept {
+    static thread_local const std::size_t index =
+        std::hash<std::thread::id>{}(std::this_thread::get_id()) % shard_count;
+    return stats.shards_[index];
+  }
+
+  static std::uint64_t to_ns(std::chrono::nanoseconds d) noexcept {
+    return d.count() < 0 ? 0 : static_cast<std::uint64_t>(d.count());
+  }
+
+ public:
+  executor_stats() noexcept {
+    reset();
+  }
+  executor_stats(const executor_stats&) = delete;
+  executor_stats& operator=(const executor_stats&) = delete;
+
+  void record(
+      std::chrono::nanoseconds queue_delay,
+      std::chrono::nanoseconds run_time) noexcept {
+    auto& s = this_thread_shard(*this);
+    s.queue_delay.record(to_ns(queue_delay));
+    s.run_time.record(to_ns(run_time));
+  }
+
+  // the time from submit to the start of set_value
+  duration_histogram queue_delay() const noexcept {
+    duration_histogram h;
+    for (auto& s : shards_) {
+      s.queue_delay.add_to(h);
+    }
+    return h;
+  }
+  // the time from the start of set_value to set_done
+  duration_histogram run_time() const noexcept {
+    duration_histogram h;
+    for (auto& s : shards_) {
+      s.run_time.add_to(h);
+    }
+    return h;
+  }
+
+  // not synchronized with record(), items that complete during the reset
+  // may be partly kept.
+  void reset() noexcept {
+    for (auto& s : shards_) {
+      s.queue_delay.reset();
+      s.run_time.reset();
+    }
+  }
+};
+
+namespace detail {
+
+using instrumented_clock = std::chrono::steady_clock;
+
+template <class Out, class Sink>
+class instrumented_receiver {
+  Out out_;
+  Sink sink_;
+  instrumented_clock::time_point submitted_;
+  instrumented_clock::time_point started_{};
+
+ public:
+  using properties = property_set<is_receiver<>>;
+
+  instrumented_receiver(
+      Out out,
+      Sink sink,
+      instrumented_clock::time_point submitted)
+      : out_(std::move(out)), sink_(std::move(sink)), submitted_(submitted) {}
+
+  // the allocator of out, for the state allocated on its behalf
+  PUSHMI_TEMPLATE(class O = Out)
+  (requires //
+   requires(::pushmi::get_allocator(std::declval<O&>()))) //
+  auto get_allocator() {
+    return ::pushmi::get_allocator(out_);
+  }
+
+  template <class... VN>
+  void value(VN&&... vn) {
+    started_ = instrumented_clock::now();
+    set_value(out_, (VN &&) vn...);
+  }
+  template <class E>
+  void error(E e) noexcept {
+    set_error(out_, std::move(e));
+  }
+  void done() {
+    if (started_ != instrumented_clock::time_point{}) {
+      auto finished = instrumented_clock::now();
+      sink_->record(
+          std::chrono::duration_cast<std::chrono::nanoseconds>(
+              started_ - submitted_),
+          std::chrono::duration_cast<std::chrono::nanoseconds>(
+              finished - started_));
+    }
+    set_done(out_);
+  }
+};
+
+} // namespace detail
+
+template <class Task, class Sink>
+class instrumented_task {
+  Task task_;
+  Sink sink_;
+
+ public:
+  using properties = properties_t<Task>;
+
+  instrumented_task(Task task, Sink sink)
+      : task_(std::move(task)), sink_(std::move(sink)) {}
+
+  PUSHMI_TEMPLATE(class Out)
+  (requires Receiver<Out>) //
+  void submit(Out out) && {
+    ::pushmi::submit(
+        std::move(task_),
+        detail::instrumented_receiver<Out, Sink>{
+            std::move(out), sink_, detail::instrumented_clock::now()});
+  }
+};
+
+template <class Exec, class Sink>
+class instrumented_executor {
+  Exec ex_;
+  Sink sink_;
+
+  template <class Task>
+  instrumented_task<Task, Sink> make_task(Task task) {
+    return {std::move(task), sink_};
+  }
+
+ public:
+  using properties = properties_t<Exec>;
+
+  instrumented_executor(Exec ex, Sink sink)
+      : ex_(std::move(ex)), sink_(std::move(sink)) {}
+
+  const Exec& base() const {
+    return ex_;
+  }
+  const Sink& sink() const {
+    return sink_;
+  }
+
+  PUSHMI_TEMPLATE(class E = Exec)
+  (requires //
+   requires(::pushmi::top(std::declval<E&>()))) //
+  auto top() {
+    return ::pushmi::top(ex_);
+  }
+
+  PUSHMI_TEMPLATE(class E = Exec)
+  (requires //
+   requires(::pushmi::schedule(std::declval<E&>()))) //
+  auto schedule() {
+    return make_task(::pushmi::schedule(ex_));
+  }
+  PUSHMI_TEMPLATE(class CV, class E = Exec)
+  (requires //
+   requires(::pushmi::schedule(std::declval<E&>(), std::declval<CV>()))) //
+  auto schedule(CV cv) {
+    return make_task(::pushmi::schedule(ex_, std::move(cv)));
+  }
+};
+
+PUSHMI_TEMPLATE(class Exec, class Sink)
+(requires Executor<Exec>) //
+auto instrumented(Exec ex, Sink sink) {
+  return instrumented_executor<Exec, Sink>{std::move(ex), std::move(sink)};
+}
+
+} // namespace pushmi
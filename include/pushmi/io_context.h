@@ -0,0 +1,390 @@
+/*
+ * Copyright 2018-present Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <exception>
+#include <memory>
+#include <system_error>
+#include <type_traits>
+#include <utility>
+
+#include <experimental/net>
+
+#include <pushmi/executor.h>
+#include <pushmi/receiver.h>
+
+//
+// adapts a networking ts io_context (external/networking-ts-impl) to pushmi.
+//
+// io_context_executor is a time executor for the threads that call
+// io_context::run(). schedule() posts an item to the io_context and
+// schedule(tp) waits for tp with a steady_timer.
+//
+// async_read_some, async_write_some, async_accept and async_connect are
+// single senders for the same operations on a socket or an acceptor. the
+// receiver is signalled from the completion handler of the operation, on
+// the io_context thread that ran it, and the operation is allocated with the
+// allocator of the receiver. so is the steady_timer of schedule(tp).
+//
+// an operation that completes with an error signals set_error with a
+// std::system_error. an operation that was cancelled, and a read at the end
+// of the stream, signal set_done. the socket and the buffers must outlive
+// the operation, as they must for the io_context.
+//
+
+namespace pushmi {
+
+namespace detail {
+
+namespace net = std::experimental::net;
+
+//
+// the completion handlers of the senders. the io_context uses the nested
+// allocator_type to allocate the operation.
+//
+
+template <class Out>
+class net_handler {
+ public:
+  using allocator_type = std::decay_t<decltype(
+      ::pushmi::get_allocator(std::declval<Out&>()))>;
+
+  explicit net_handler(Out out)
+      : alloc_(::pushmi::get_allocator(out)), out_(std::move(out)) {}
+
+  allocator_type get_allocator() const noexcept {
+    return alloc_;
+  }
+
+ protected:
+  template <class... VN>
+  void succeed(VN&&... vn) {
+    ::pushmi::set_value(out_, (VN &&) vn...);
+    ::pushmi::set_done(out_);
+  }
+  void done() {
+    ::pushmi::set_done(out_);
+  }
+  void fail(std::error_code ec) {
+    if (ec == std::errc::operation_canceled) {
+      ::pushmi::set_done(out_);
+    } else {
+      ::pushmi::set_error(
+          out_, std::make_exception_ptr(std::system_error(ec)));
+    }
+  }
+
+ private:
+  allocator_type alloc_;
+  Out out_;
+};
+
+template <class Out, class Exec>
+class net_schedule_handler : net_handler<Out> {
+  Exec ex_;
+
+ public:
+  using typename net_handler<Out>::allocator_type;
+  using net_handler<Out>::get_allocator;
+
+  net_schedule_handler(Out out, Exec ex)
+      : net_handler<Out>(std::move(out)), ex_(std::move(ex)) {}
+
+  // from post
+  void operator()() {
+    this->succeed(ex_);
+  }
+  // from steady_timer::async_wait
+  void operator()(std::error_code ec) {
+    if (ec) {
+      this->fail(ec);
+    } else {
+      this->succeed(ex_);
+    }
+  }
+};
+
+// the timer must live until its handler is called, so the handler owns it
+template <class Out, class Exec>
+class net_timer_handler : net_schedule_handler<Out, Exec> {
+  std::shared_ptr<net::steady_timer> timer_;
+
+ public:
+  using typename net_handler<Out>::allocator_type;
+  using net_handler<Out>::get_allocator;
+
+  net_timer_handler(
+      Out out,
+      Exec ex,
+      std::shared_ptr<net::steady_timer> timer)
+      : net_schedule_handler<Out, Exec>(std::move(out), std::move(ex)),
+        timer_(std::move(timer)) {}
+
+  void operator()(std::error_code ec) {
+    net_schedule_handler<Out, Exec>::operator()(ec);
+  }
+};
+
+template <class Out>
+class net_transfer_handler : net_handler<Out> {
+  bool read_;
+
+ public:
+  using typename net_handler<Out>::allocator_type;
+  using net_handler<Out>::get_allocator;
+
+  net_transfer_handler(Out out, bool read)
+      : net_handler<Out>(std::move(out)), read_(read) {}
+
+  void operator()(std::error_code ec, std::size_t transferred) {
+    if (read_ && ec == net::stream_errc::eof) {
+      this->done();
+    } else if (ec) {
+      this->fail(ec);
+    } else {
+      this->succeed(transferred);
+    }
+  }
+};
+
+template <class Out>
+class net_accept_handler : net_handler<Out> {
+ public:
+  using typename net_handler<Out>::allocator_type;
+  using net_handler<Out>::get_allocator;
+
+  explicit net_accept_handler(Out out) : net_handler<Out>(std::move(out)) {}
+
+  template <class Socket>
+  void operator()(std::error_code ec, Socket socket) {
+    if (ec) {
+      this->fail(ec);
+    } else {
+      this->succeed(std::move(socket));
+    }
+  }
+};
+
+template <class Out, class Endpoint>
+class net_connect_handler : net_handler<Out> {
+  Endpoint endpoint_;
+
+ public:
+  using typename net_handler<Out>::allocator_type;
+  using net_handler<Out>::get_allocator;
+
+  net_connect_handler(Out out, Endpoint endpoint)
+      : net_handler<Out>(std::move(out)), endpoint_(std::move(endpoint)) {}
+
+  void operator()(std::error_code ec) {
+    if (ec) {
+      this->fail(ec);
+    } else {
+      this->succeed(endpoint_);
+    }
+  }
+};
+
+class io_context_task;
+
+} // namespace detail
+
+class io_context_executor {
+  std::experimental::net::io_context* context_;
+
+ public:
+  // the io_context may be run by several threads at once
+  using properties = property_set<is_time<>, is_concurrent_sequence<>>;
+
+  explicit io_context_executor(std::experimental::net::io_context& context)
+      : context_(&context) {}
+
+  std::experimental::net::io_context& context() const {
+    return *context_;
+  }
+
+  std::chrono::steady_clock::time_point top() {
+    return std::chrono::steady_clock::now();
+  }
+  detail::io_context_task schedule();
+  detail::io_context_task schedule(std::chrono::steady_clock::time_point tp);
+
+  friend bool operator==(
+      const io_context_executor& l,
+      const io_context_executor& r) {
+    return l.context_ == r.context_;
+  }
+  friend bool operator!=(
+      const io_context_executor& l,
+      const io_context_executor& r) {
+    return !(l == r);
+  }
+};
+
+namespace detail {
+
+class io_context_task {
+  std::experimental::net::io_context* context_;
+  bool timed_;
+  std::chrono::steady_clock::time_point when_;
+
+ public:
+  using properties =
+      property_set<is_sender<>, is_never_blocking<>, is_single<>>;
+
+  io_context_task(
+      std::experimental::net::io_context& context,
+      bool timed,
+      std::chrono::steady_clock::time_point when)
+      : context_(&context), timed_(timed), when_(when) {}
+
+  PUSHMI_TEMPLATE(class Out)
+  (requires ReceiveValue<Out&, io_context_executor>&&
+       ReceiveError<Out, std::exception_ptr>) //
+  void submit(Out out) {
+    io_context_executor ex{*context_};
+    auto alloc = ::pushmi::get_allocator(out);
+    if (timed_) {
+      auto timer =
+          std::allocate_shared<net::steady_timer>(alloc, *context_, when_);
+      auto& t = *timer;
+      t.async_wait(net_timer_handler<Out, io_context_executor>{
+          std::move(out), ex, std::move(timer)});
+    } else {
+      context_->get_executor().post(
+          net_schedule_handler<Out, io_context_executor>{std::move(out), ex},
+          alloc);
+    }
+  }
+};
+
+template <class Socket, class Buffers, bool Read>
+class net_transfer_sender {
+  Socket* socket_;
+  Buffers buffers_;
+
+ public:
+  using properties =
+      property_set<is_sender<>, is_never_blocking<>, is_single<>>;
+
+  net_transfer_sender(Socket& socket, Buffers buffers)
+      : socket_(&socket), buffers_(std::move(buffers)) {}
+
+  PUSHMI_TEMPLATE(class Out)
+  (requires ReceiveValue<Out&, std::size_t>&&
+       ReceiveError<Out, std::exception_ptr>) //
+  void submit(Out out) {
+    start(
+        std::integral_constant<bool, Read>{},
+        net_transfer_handler<Out>{std::move(out), Read});
+  }
+
+ private:
+  template <class Handler>
+  void start(std::true_type, Handler handler) {
+    socket_->async_read_some(buffers_, std::move(handler));
+  }
+  template <class Handler>
+  void start(std::false_type, Handler handler) {
+    socket_->async_write_some(buffers_, std::move(handler));
+  }
+};
+
+template <class Acceptor>
+class net_accept_sender {
+  Acceptor* acceptor_;
+
+ public:
+  using socket_type = typename Acceptor::protocol_type::socket;
+  using properties =
+      property_set<is_sender<>, is_never_blocking<>, is_single<>>;
+
+  explicit net_accept_sender(Acceptor& acceptor) : acceptor_(&acceptor) {}
+
+  PUSHMI_TEMPLATE(class Out)
+  (requires ReceiveValue<Out&, socket_type>&&
+       ReceiveError<Out, std::exception_ptr>) //
+  void submit(Out out) {
+    acceptor_->async_accept(net_accept_handler<Out>{std::move(out)});
+  }
+};
+
+template <class Socket>
+class net_connect_sender {
+  using endpoint_type = typename Socket::endpoint_type;
+  Socket* socket_;
+  endpoint_type endpoint_;
+
+ public:
+  using properties =
+      property_set<is_sender<>, is_never_blocking<>, is_single<>>;
+
+  net_connect_sender(Socket& socket, endpoint_type endpoint)
+      : socket_(&socket), endpoint_(std::move(endpoint)) {}
+
+  PUSHMI_TEMPLATE(class Out)
+  (requires ReceiveValue<Out&, endpoint_type>&&
+       ReceiveError<Out, std::exception_ptr>) //
+  void submit(Out out) {
+    socket_->async_connect(
+        endpoint_,
+        net_connect_handler<Out, endpoint_type>{std::move(out), endpoint_});
+  }
+};
+
+} // namespace detail
+
+inline detail::io_context_task io_context_executor::schedule() {
+  return {*context_, false, {}};
+}
+inline detail::io_context_task io_context_executor::schedule(
+    std::chrono::steady_clock::time_point tp) {
+  return {*context_, true, tp};
+}
+
+// delivers the number of bytes read into buffers
+template <class Socket, class MutableBuffers>
+detail::net_transfer_sender<Socket, MutableBuffers, true> async_read_some(
+    Socket& socket,
+    MutableBuffers buffers) {
+  return {socket, std::move(buffers)};
+}
+
+// delivers the number of bytes written from buffers
+template <class Socket, class ConstBuffers>
+detail::net_transfer_sender<Socket, ConstBuffers, false> async_write_some(
+    Socket& socket,
+    ConstBuffers buffers) {
+  return {socket, std::move(buffers)};
+}
+
+// delivers the accepted socket
+template <class Acceptor>
+detail::net_accept_sender<Acceptor> async_accept(Acceptor& acceptor) {
+  return detail::net_accept_sender<Acceptor>{acceptor};
+}
+
+// delivers endpoint once socket is connected to it
+template <class Socket>
+detail::net_connect_sender<Socket> async_connect(
+    Socket& socket,
+    typename Socket::endpoint_type endpoint) {
+  return {socket, std::move(endpoint)};
+}
+
+} // namespace pushmi
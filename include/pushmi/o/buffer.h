@@ -0,0 +1,497 @@
+/*
+ * Copyright 2018-present Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <exception>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <pushmi/detail/opt.h>
+#include <pushmi/executor.h>
+#include <pushmi/flow_receiver.h>
+#include <pushmi/o/extension_operators.h>
+#include <pushmi/piping.h>
+#include <pushmi/receiver.h>
+
+namespace pushmi {
+
+namespace detail {
+
+// translates requests for buffers from the downstream into requests for
+// values from the upstream. the first request also asks for the values
+// that are needed to fill the first buffer beyond one per_buffer_ step.
+template <class Up>
+struct buffer_up {
+  using properties = property_set<is_receiver<>>;
+
+  Up up_;
+  std::ptrdiff_t per_buffer_;
+  std::ptrdiff_t first_;
+
+  void value(std::ptrdiff_t requested) {
+    if (requested < 1) {
+      return;
+    }
+    constexpr auto max = std::numeric_limits<std::ptrdiff_t>::max();
+    auto total = requested > max / per_buffer_ ? max : requested * per_buffer_;
+    if (first_ > 0) {
+      total = total > max - first_ ? max : total + first_;
+    } else {
+      total += first_;
+    }
+    first_ = 0;
+    ::pushmi::set_value(up_, total);
+  }
+  template <class E>
+  void error(E e) noexcept {
+    ::pushmi::set_error(up_, std::move(e));
+  }
+  void done() {
+    ::pushmi::set_done(up_);
+  }
+};
+
+template <class Up>
+auto make_buffer_up(Up up, std::size_t per_buffer, std::ptrdiff_t first)
+    -> buffer_up<Up> {
+  return {std::move(up), static_cast<std::ptrdiff_t>(per_buffer), first};
+}
+
+template <class T, class Out>
+struct buffer_data : flow_receiver<> {
+  buffer_data(Out out, std::size_t count, std::size_t skip, bool partial)
+      : out_(std::move(out)), count_(count), skip_(skip), partial_(partial) {
+    values_.reserve(count_);
+  }
+
+  using properties = properties_t<Out>;
+  using flow_receiver<>::value;
+  using flow_receiver<>::error;
+  using flow_receiver<>::done;
+
+  template <class Up>
+  void starting(Up&& up) {
+    set_starting(
+        out_,
+        make_buffer_up(
+            std::decay_t<Up>{(Up &&) up},
+            skip_,
+            static_cast<std::ptrdiff_t>(count_) -
+                static_cast<std::ptrdiff_t>(skip_)));
+  }
+
+  Out out_;
+  std::size_t count_;
+  std::size_t skip_;
+  // emit the values left over when the upstream is done
+  bool partial_;
+  // values to drop before the next window starts, when skip_ > count_
+  std::size_t gap_ = 0;
+  std::vector<T> values_;
+};
+
+template <class T>
+struct buffer_count_impl {
+  struct on_value_impl {
+    template <class Data, class... VN>
+    void operator()(Data& data, VN&&... vn) const {
+      if (data.gap_ > 0) {
+        --data.gap_;
+        return;
+      }
+      data.values_.emplace_back((VN &&) vn...);
+      if (data.values_.size() < data.count_) {
+        return;
+      }
+      // state must be updated before out.value is called, since it may
+      // re-enter this receiver.
+      if (data.skip_ < data.count_) {
+        std::vector<T> window{data.values_};
+        data.values_.erase(
+            data.values_.begin(), data.values_.begin() + data.skip_);
+        set_value(data.out_, std::move(window));
+      } else {
+        data.gap_ = data.skip_ - data.count_;
+        std::vector<T> buffer;
+        buffer.reserve(data.count_);
+        buffer.swap(data.values_);
+        set_value(data.out_, std::move(buffer));
+      }
+    }
+  };
+  struct on_error_impl {
+    template <class Data, class E>
+    void operator()(Data& data, E e) const noexcept {
+      data.values_.clear();
+      set_error(data.out_, std::move(e));
+    }
+  };
+  struct on_done_impl {
+    template <class Data>
+    void operator()(Data& data) const {
+      if (data.partial_ && !data.values_.empty()) {
+        auto buffer = std::move(data.values_);
+        data.values_.clear();
+        set_value(data.out_, std::move(buffer));
+      }
+      set_done(data.out_);
+    }
+  };
+  template <class In>
+  struct submit_impl {
+    std::size_t count_;
+    std::size_t skip_;
+    bool partial_;
+    PUSHMI_TEMPLATE(class SIn, class Out)
+    (requires Receiver<Out>) //
+        void
+        operator()(SIn&& in, Out out) const {
+      ::pushmi::submit(
+          (In &&) in,
+          ::pushmi::detail::receiver_from_fn<In>()(
+              buffer_data<T, Out>{std::move(out), count_, skip_, partial_},
+              on_value_impl{},
+              on_error_impl{},
+              on_done_impl{}));
+    }
+  };
+  struct adapt_impl {
+    std::size_t count_;
+    std::size_t skip_;
+    bool partial_;
+    PUSHMI_TEMPLATE(class In)
+    (requires Sender<In, is_many<>>) //
+        auto
+        operator()(In in) const {
+      return ::pushmi::detail::sender_from(
+          std::move(in), submit_impl<In>{count_, skip_, partial_});
+    }
+  };
+};
+
+// buffer<T>(count) emits consecutive, non-overlapping vectors of count
+// values. the values left over when the upstream is done are emitted as a
+// shorter vector.
+template <class T>
+struct buffer_fn {
+  auto operator()(std::size_t count) const {
+    count = count < 1 ? 1 : count;
+    return typename buffer_count_impl<T>::adapt_impl{count, count, true};
+  }
+};
+
+// window<T>(count, skip) emits a vector of count values after every skip
+// values. skip < count produces sliding (overlapping) windows, skip == count
+// produces tumbling windows and skip > count drops the values between
+// windows. only complete windows are emitted.
+template <class T>
+struct window_fn {
+  auto operator()(std::size_t count) const {
+    return (*this)(count, count);
+  }
+  auto operator()(std::size_t count, std::size_t skip) const {
+    count = count < 1 ? 1 : count;
+    skip = skip < 1 ? 1 : skip;
+    return typename buffer_count_impl<T>::adapt_impl{count, skip, false};
+  }
+};
+
+//
+// buffer_time collects values until the duration has passed since the first
+// value in the buffer, or until the buffer holds max_count values. a single
+// timer is armed on the time executor for each buffer.
+//
+// signals arrive from the upstream and from the timer on different threads
+// so the state is shared and guarded. the lock is recursive because out may
+// request more values from inside of the value signal.
+//
+
+template <class T, class Out, class Exec, class Dur>
+struct buffer_time_shared
+    : std::enable_shared_from_this<buffer_time_shared<T, Out, Exec, Dur>> {
+  using up_t = any_receiver<std::exception_ptr, std::ptrdiff_t>;
+
+  buffer_time_shared(Out out, Exec exec, Dur after, std::size_t max_count)
+      : out_(std::move(out)),
+        exec_(std::move(exec)),
+        after_(after),
+        max_count_(max_count) {}
+
+  Out out_;
+  Exec exec_;
+  Dur after_;
+  std::size_t max_count_;
+  std::recursive_mutex lock_;
+  std::vector<T> values_;
+  ::pushmi::detail::opt<up_t> up_;
+  // identifies the current buffer, so that the timer for a buffer that was
+  // already emitted is ignored.
+  std::size_t buffer_ = 0;
+  bool armed_ = false;
+  bool done_ = false;
+
+  // the up receiver passed to the output
+  struct up_receiver {
+    using properties = property_set<is_receiver<>>;
+
+    // weak, the output owns this receiver and the state owns the output
+    std::weak_ptr<buffer_time_shared> s_;
+
+    void value(std::ptrdiff_t requested) {
+      if (auto s = s_.lock()) {
+        s->request(requested);
+      }
+    }
+    template <class E>
+    void error(E) noexcept {
+      done();
+    }
+    void done() {
+      if (auto s = s_.lock()) {
+        s->cancel();
+      }
+    }
+  };
+
+  // a buffer can be emitted for every value, so each requested buffer is
+  // one requested value. downstream receivers that request ahead get full
+  // buffers.
+  void starting(up_t up) {
+    std::unique_lock<std::recursive_mutex> guard{lock_};
+    up_ = std::move(up);
+    set_starting(
+        out_, make_buffer_up(up_receiver{this->shared_from_this()}, 1, 0));
+  }
+  void request(std::ptrdiff_t requested) {
+    std::unique_lock<std::recursive_mutex> guard{lock_};
+    if (!done_ && !!up_) {
+      set_value(*up_, requested);
+    }
+  }
+  void cancel() {
+    std::unique_lock<std::recursive_mutex> guard{lock_};
+    auto up = std::move(up_);
+    up_ = ::pushmi::detail::opt<up_t>{};
+    if (!!up) {
+      set_done(*up);
+    }
+  }
+
+  template <class... VN>
+  void value(VN&&... vn) {
+    std::unique_lock<std::recursive_mutex> guard{lock_};
+    if (done_) {
+      return;
+    }
+    values_.emplace_back((VN &&) vn...);
+    if (values_.size() >= max_count_) {
+      flush();
+    } else if (!armed_) {
+      arm();
+    }
+  }
+  template <class E>
+  void error(E e) noexcept {
+    std::unique_lock<std::recursive_mutex> guard{lock_};
+    if (done_) {
+      return;
+    }
+    done_ = true;
+    values_.clear();
+    up_ = ::pushmi::detail::opt<up_t>{};
+    set_error(out_, std::move(e));
+  }
+  void done() {
+    std::unique_lock<std::recursive_mutex> guard{lock_};
+    if (done_) {
+      return;
+    }
+    flush();
+    done_ = true;
+    up_ = ::pushmi::detail::opt<up_t>{};
+    set_done(out_);
+  }
+  void expired(std::size_t buffer) {
+    std::unique_lock<std::recursive_mutex> guard{lock_};
+    if (done_ || buffer != buffer_) {
+      return;
+    }
+    flush();
+  }
+  // the timer could not be scheduled, so the buffer would never be emitted.
+  // the error is delivered and the input is cancelled.
+  template <class E>
+  void timer_error(std::size_t buffer, E e) noexcept {
+    std::unique_lock<std::recursive_mutex> guard{lock_};
+    if (done_ || buffer != buffer_) {
+      return;
+    }
+    done_ = true;
+    values_.clear();
+    auto up = std::move(up_);
+    up_ = ::pushmi::detail::opt<up_t>{};
+    if (!!up) {
+      set_done(*up);
+    }
+    set_error(out_, std::move(e));
+  }
+
+ private:
+  struct expired_fn {
+    std::shared_ptr<buffer_time_shared> s_;
+    std::size_t buffer_;
+    void operator()(any) {
+      s_->expired(buffer_);
+    }
+  };
+  void arm() {
+    armed_ = true;
+    ::pushmi::submit(
+        ::pushmi::schedule(exec_, ::pushmi::now(exec_) + after_),
+        ::pushmi::make_receiver(
+            expired_fn{this->shared_from_this(), buffer_},
+            [s = this->shared_from_this(), buffer = buffer_](auto e) noexcept {
+              s->timer_error(buffer, std::move(e));
+            }));
+  }
+  void flush() {
+    ++buffer_;
+    armed_ = false;
+    if (values_.empty()) {
+      return;
+    }
+    std::vector<T> buffer;
+    buffer.swap(values_);
+    set_value(out_, std::move(buffer));
+  }
+};
+
+template <class T, class Out, class Exec, class Dur>
+struct buffer_time_data : flow_receiver<> {
+  using shared_t = buffer_time_shared<T, Out, Exec, Dur>;
+
+  buffer_time_data(Out out, Exec exec, Dur after, std::size_t max_count)
+      : s_(std::make_shared<shared_t>(
+            std::move(out),
+            std::move(exec),
+            after,
+            max_count)) {}
+
+  using properties = properties_t<Out>;
+  using flow_receiver<>::value;
+  using flow_receiver<>::error;
+  using flow_receiver<>::done;
+
+  template <class Up>
+  void starting(Up&& up) {
+    // up may own this receiver, copy the state out before moving it.
+    auto s = s_;
+    s->starting(typename shared_t::up_t{(Up &&) up});
+  }
+
+  std::shared_ptr<shared_t> s_;
+};
+
+template <class T>
+struct buffer_time_fn {
+ private:
+  struct on_value_impl {
+    template <class Data, class... VN>
+    void operator()(Data& data, VN&&... vn) const {
+      data.s_->value((VN &&) vn...);
+    }
+  };
+  struct on_error_impl {
+    template <class Data, class E>
+    void operator()(Data& data, E e) const noexcept {
+      data.s_->error(std::move(e));
+    }
+  };
+  struct on_done_impl {
+    template <class Data>
+    void operator()(Data& data) const {
+      data.s_->done();
+    }
+  };
+  template <class In, class Exec, class Dur>
+  struct submit_impl {
+    Exec exec_;
+    Dur after_;
+    std::size_t max_count_;
+    PUSHMI_TEMPLATE(class SIn, class Out)
+    (requires Receiver<Out>) //
+        void
+        operator()(SIn&& in, Out out) const {
+      ::pushmi::submit(
+          (In &&) in,
+          ::pushmi::detail::receiver_from_fn<In>()(
+              buffer_time_data<T, Out, Exec, Dur>{
+                  std::move(out), exec_, after_, max_count_},
+              on_value_impl{},
+              on_error_impl{},
+              on_done_impl{}));
+    }
+  };
+  template <class Exec, class Dur>
+  struct adapt_impl {
+    Exec exec_;
+    Dur after_;
+    std::size_t max_count_;
+    PUSHMI_TEMPLATE(class In)
+    (requires Sender<In, is_many<>>) //
+        auto
+        operator()(In in) const {
+      return ::pushmi::detail::sender_from(
+          std::move(in),
+          submit_impl<In, Exec, Dur>{exec_, after_, max_count_});
+    }
+  };
+
+ public:
+  PUSHMI_TEMPLATE(class Dur, class Exec)
+  (requires TimeExecutor<Exec>) //
+      auto
+      operator()(Dur after, Exec exec) const {
+    return (*this)(
+        std::move(after),
+        std::move(exec),
+        std::numeric_limits<std::size_t>::max());
+  }
+  PUSHMI_TEMPLATE(class Dur, class Exec)
+  (requires TimeExecutor<Exec>) //
+      auto
+      operator()(Dur after, Exec exec, std::size_t max_count) const {
+    return adapt_impl<Exec, Dur>{
+        std::move(exec), std::move(after), max_count < 1 ? 1 : max_count};
+  }
+};
+
+} // namespace detail
+
+namespace operators {
+
+template <class T>
+PUSHMI_INLINE_VAR constexpr detail::buffer_fn<T> buffer{};
+template <class T>
+PUSHMI_INLINE_VAR constexpr detail::window_fn<T> window{};
+template <class T>
+PUSHMI_INLINE_VAR constexpr detail::buffer_time_fn<T> buffer_time{};
+
+} // namespace operators
+
+} // namespace pushmi
@@ -18,6 +18,7 @@
 #include <pushmi/boosters.h>
 #include <pushmi/concepts.h>
 #include <pushmi/detail/functional.h>
+#include <pushmi/detail/trace.h>
 #include <pushmi/executor.h>
 #include <pushmi/inline.h>
 #include <pushmi/trampoline.h>
@@ -31,6 +32,7 @@
 #include <pushmi/receiver.h>
 #include <pushmi/single_sender.h>
 #include <pushmi/traits.h>
+#include <exception>
 #include <tuple>
 
 namespace pushmi {
@@ -69,6 +71,20 @@ PUSHMI_TEMPLATE(class F, class Tuple)
 
 namespace detail {
 
+// the operators that join several senders deliver every error as an
+// exception_ptr
+inline std::exception_ptr as_exception_ptr(std::exception_ptr e) {
+  return e;
+}
+template <class E>
+std::exception_ptr as_exception_ptr(E e) {
+  return std::make_exception_ptr(std::move(e));
+}
+
+} // namespace detail
+
+namespace detail {
+
 template <bool IsFlow = false>
 struct make_receiver;
 template <>
@@ -79,12 +95,14 @@ struct make_receiver<true> : construct_deduced<flow_receiver> {};
 template <class Cardinality, bool IsFlow>
 struct receiver_from_impl {
   using MakeReceiver = make_receiver<IsFlow>;
+
+ private:
   template <class... AN>
-  using receiver_type = ::pushmi::invoke_result_t<MakeReceiver&, AN...>;
+  using made_type = ::pushmi::invoke_result_t<MakeReceiver&, AN...>;
   PUSHMI_TEMPLATE(class... Ts)
   (requires Invocable<MakeReceiver&, Ts...>) //
-      auto
-      operator()(std::tuple<Ts...> args) const {
+      static auto
+      make(std::tuple<Ts...> args) {
     return ::pushmi::apply(MakeReceiver(), std::move(args));
   }
   PUSHMI_TEMPLATE(
@@ -93,19 +111,32 @@ struct receiver_from_impl {
       class... Fns)
   (requires And<SemiMovable<F0>, SemiMovable<Fns>...>&& Invocable<MakeReceiver&, Ts...>&&
        Invocable<
-           const receiver_from_impl&,
-           receiver_type<Ts...>,
+           MakeReceiver&,
+           made_type<Ts...>,
            F0, Fns...>) //
-      auto
-      operator()(std::tuple<Ts...> args, F0 f0, Fns... fns) const {
-    return (*this)((*this)(std::move(args)), std::move(f0), std::move(fns)...);
+      static auto
+      make(std::tuple<Ts...> args, F0 f0, Fns... fns) {
+    return MakeReceiver()(make(std::move(args)), std::move(f0), std::move(fns)...);
   }
   PUSHMI_TEMPLATE(class Out, class... Fns)
   (requires not is_v<Out, std::tuple>&& And<MoveConstructible<Fns&&>...>) //
-      auto
-      operator()(Out&& out, Fns&&... fns) const {
+      static auto
+      make(Out&& out, Fns&&... fns) {
     return MakeReceiver()((Out&&)out, (Fns&&)fns...);
   }
+
+ public:
+  template <class... AN>
+  using receiver_type = decltype(::pushmi::detail::trace_receiver(
+      std::declval<made_type<AN...>>()));
+  // when tracing, the receiver is named after the operator being submitted
+  PUSHMI_TEMPLATE(class... AN)
+  (requires requires(receiver_from_impl::make(std::declval<AN>()...))) //
+      auto
+      operator()(AN&&... an) const {
+    return ::pushmi::detail::trace_receiver(
+        receiver_from_impl::make((AN&&)an...));
+  }
 };
 
 template <PUSHMI_TYPE_CONSTRAINT(Sender) In>
@@ -140,7 +171,8 @@ PUSHMI_INLINE_VAR constexpr struct sender_from_fn {
     using MakeSender = make_sender<
         property_set_index_t<properties_t<In>, is_single<>>,
         property_query_v<properties_t<In>, is_flow<>>>;
-    return MakeSender{}(std::move(in), (FN &&) fn...);
+    return MakeSender{}(
+        std::move(in), ::pushmi::detail::trace_submit((FN &&) fn)...);
   }
 } const sender_from{};
 
@@ -0,0 +1,64 @@
+/*
+ * Copyright 2018-present Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <limits>
+
+#include <pushmi/o/merge.h>
+
+namespace pushmi {
+
+namespace detail {
+
+// flat_map and concat_map map each value of a many sender to an inner sender
+// and submit at most max_concurrent of the inner senders at a time. when the
+// input is a flow sender it is only asked for a value when there is a free
+// inner slot.
+template <bool Ordered, class... TN>
+struct flat_map_fn {
+  PUSHMI_TEMPLATE(class F)
+  (requires SemiMovable<F>) //
+      auto
+      operator()(F f) const {
+    return (*this)(std::move(f), std::numeric_limits<std::size_t>::max());
+  }
+  PUSHMI_TEMPLATE(class F)
+  (requires SemiMovable<F>) //
+      auto
+      operator()(F f, std::size_t max_concurrent) const {
+    return typename merge_all_fn<TN...>::template adapt_impl<F>{
+        std::move(f), max_concurrent < 1 ? 1 : max_concurrent, Ordered};
+  }
+};
+
+} // namespace detail
+
+namespace operators {
+
+// flat_map<TN...>(f, max_concurrent) delivers the values of the inner
+// senders in the order that they arrive.
+template <class... TN>
+PUSHMI_INLINE_VAR constexpr detail::flat_map_fn<false, TN...> flat_map{};
+
+// concat_map<TN...>(f, max_concurrent) delivers the values of the inner
+// senders in the order of the values that selected them. values from inner
+// senders that complete early are held until the earlier inners complete.
+template <class... TN>
+PUSHMI_INLINE_VAR constexpr detail::flat_map_fn<true, TN...> concat_map{};
+
+} // namespace operators
+
+} // namespace pushmi
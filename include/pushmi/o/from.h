@@ -148,8 +148,9 @@ PUSHMI_INLINE_VAR constexpr struct flow_from_fn {
         void
         operator()(Out out) {
       using Producer = flow_from_producer<I, S, Out, Exec>;
-      auto p = std::make_shared<Producer>(
-          begin_, end_, std::move(out), exec_, false);
+      auto alloc = ::pushmi::get_allocator(out);
+      auto p = std::allocate_shared<Producer>(
+          alloc, begin_, end_, std::move(out), exec_, false);
 
       ::pushmi::submit(
           ::pushmi::schedule(exec_), make_receiver([p](auto) {
@@ -0,0 +1,759 @@
+/*
+ * Copyright 2018-present Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <tuple>
+#include <vector>
+
+#include <pushmi/flow_many_sender.h>
+#include <pushmi/many_sender.h>
+#include <pushmi/o/extension_operators.h>
+#include <pushmi/o/submit.h>
+#include <pushmi/piping.h>
+#include <pushmi/receiver.h>
+
+namespace pushmi {
+
+namespace detail {
+
+inline std::ptrdiff_t merge_saturating_add(std::ptrdiff_t l, std::ptrdiff_t r) {
+  return std::numeric_limits<std::ptrdiff_t>::max() - l < r
+      ? std::numeric_limits<std::ptrdiff_t>::max()
+      : l + r;
+}
+
+//
+// merge_shared is the state shared by the receivers of all the inputs that
+// are merged into one output receiver.
+//
+// the inputs are signaled concurrently. every signal updates the state under
+// lock_ and then calls drain(). drain() is entered by one thread at a time
+// (the wip_ counter admits the first caller and counts the callers that
+// arrived while it was running) and that thread makes all the calls into the
+// output and into the up receivers of the inputs, without holding lock_.
+//
+// the demand of the output (requested_) and cancellation are atomics, so
+// request() and cancel() do not take lock_, they update the atomic and call
+// drain(). a value, error or done from an input still takes lock_ because it
+// updates several structures together (the queue of the input, the arrival
+// order, the slot and the demand outstanding at the input) that drain() also
+// reads and rebalances. the lock is only held while that bookkeeping is
+// updated, never while calling a receiver, so it is held for a short time
+// and only contended by inputs that signal at the same time.
+//
+// the demand requested by the output is split across the inputs that are
+// started and accept requests. demand that was sent to an input that
+// completes without using it is split across the remaining inputs.
+//
+// inputs that do not accept requests (many or single senders) deliver their
+// values as they arrive and those values are queued until requested.
+//
+// when ordered, the values are delivered in the order that the inputs were
+// added. the values of the inputs behind the oldest input are queued until
+// it completes and only the oldest input is sent demand.
+//
+template <class Out, class... TN>
+struct merge_shared : std::enable_shared_from_this<merge_shared<Out, TN...>> {
+  using up_t = any_receiver<std::exception_ptr, std::ptrdiff_t>;
+  using value_t = std::tuple<TN...>;
+  static constexpr std::size_t npos = std::numeric_limits<std::size_t>::max();
+
+  struct input {
+    std::size_t id_ = 0;
+    ::pushmi::detail::opt<up_t> up_;
+    std::deque<value_t> values_;
+    // demand sent to this input that has not been delivered yet
+    std::ptrdiff_t outstanding_ = 0;
+    // the input accepts requests through up_
+    bool demand_ = false;
+    bool started_ = false;
+    bool done_ = false;
+    bool live_ = false;
+  };
+
+  // an inner sender that is waiting for a free slot.
+  struct pending_base {
+    virtual ~pending_base() {}
+    virtual bool demand() const = 0;
+    virtual void submit(merge_shared& s, std::size_t slot, std::size_t id) = 0;
+  };
+  template <class S>
+  struct pending : pending_base {
+    explicit pending(S s) : s_(std::move(s)) {}
+    S s_;
+    bool demand() const override {
+      return merge_shared::template accepts_demand<S>();
+    }
+    void submit(merge_shared& s, std::size_t slot, std::size_t id) override {
+      s.submit_input(std::move(s_), slot, id);
+    }
+  };
+
+  // the up receiver passed to the output
+  struct merge_up {
+    using properties = property_set<is_receiver<>>;
+
+    std::shared_ptr<merge_shared> s_;
+
+    void value(std::ptrdiff_t requested) {
+      s_->request(requested);
+    }
+    template <class E>
+    void error(E) noexcept {
+      s_->cancel();
+    }
+    void done() {
+      s_->cancel();
+    }
+  };
+
+  // single senders only support cancellation through their up receiver
+  template <class Up>
+  struct single_up {
+    using properties = property_set<is_receiver<>>;
+
+    Up up_;
+
+    void value(std::ptrdiff_t) {}
+    template <class E>
+    void error(E e) noexcept {
+      ::pushmi::set_error(up_, std::move(e));
+    }
+    void done() {
+      ::pushmi::set_done(up_);
+    }
+  };
+
+  template <bool IsFlow, bool IsMany>
+  struct input_receiver {
+    using properties = std::conditional_t<
+        IsFlow,
+        property_set<is_receiver<>, is_flow<>>,
+        property_set<is_receiver<>>>;
+
+    std::shared_ptr<merge_shared> s_;
+    std::size_t slot_;
+    std::size_t id_;
+
+    template <class... VN>
+    void value(VN&&... vn) {
+      s_->input_value(slot_, id_, !IsMany, (VN &&) vn...);
+    }
+    template <class E>
+    void error(E e) noexcept {
+      s_->input_error(slot_, id_, as_exception_ptr(std::move(e)));
+    }
+    void done() {
+      s_->input_done(slot_, id_);
+    }
+    PUSHMI_TEMPLATE(class Up)
+    (requires IsMany && ReceiveValue<Up, std::ptrdiff_t>)
+    void starting(Up&& up) {
+      // up may own this receiver, copy the state out before moving it.
+      auto s = s_;
+      s->input_starting(slot_, id_, up_t{(Up &&) up});
+    }
+    PUSHMI_TEMPLATE(class Up)
+    (requires not IsMany && Receiver<Up>)
+    void starting(Up&& up) {
+      auto s = s_;
+      s->input_starting(
+          slot_, id_, up_t{single_up<std::decay_t<Up>>{(Up &&) up}});
+    }
+  };
+
+  // receives the inner senders. Selector maps each value to an inner sender.
+  template <bool IsFlow, class Selector>
+  struct outer_receiver {
+    using properties = std::conditional_t<
+        IsFlow,
+        property_set<is_receiver<>, is_flow<>>,
+        property_set<is_receiver<>>>;
+
+    std::shared_ptr<merge_shared> s_;
+    Selector select_;
+
+    template <class... VN>
+    void value(VN&&... vn) {
+      s_->add(select_((VN &&) vn...));
+    }
+    template <class E>
+    void error(E e) noexcept {
+      s_->outer_error(as_exception_ptr(std::move(e)));
+    }
+    void done() {
+      s_->outer_done();
+    }
+    PUSHMI_TEMPLATE(class Up)
+    (requires ReceiveValue<Up, std::ptrdiff_t>)
+    void starting(Up&& up) {
+      auto s = s_;
+      s->outer_starting(up_t{(Up &&) up});
+    }
+  };
+
+  merge_shared(Out out, std::size_t max_concurrent, bool ordered = false)
+      : out_(std::move(out)),
+        max_concurrent_(max_concurrent),
+        ordered_(ordered) {}
+
+  Out out_;
+  std::size_t max_concurrent_;
+  bool ordered_;
+  std::atomic<int> wip_{0};
+  std::mutex lock_;
+  // deque so that references to inputs are stable while inputs are added.
+  std::deque<input> inputs_;
+  std::vector<std::size_t> free_;
+  // the slot of each queued value in arrival order
+  std::deque<std::size_t> arrivals_;
+  // the slot of each live input in the order they were added, when ordered
+  std::deque<std::size_t> order_;
+  std::deque<std::unique_ptr<pending_base>> pending_;
+  std::size_t next_id_ = 0;
+  std::size_t live_ = 0;
+  // request() adds to requested_ and only the thread in drain() takes from it
+  std::atomic<std::ptrdiff_t> requested_{0};
+  std::ptrdiff_t queued_ = 0;
+  // rotates the input that receives the remainder of a split
+  std::size_t next_ = 0;
+  ::pushmi::detail::opt<up_t> outer_up_;
+  std::ptrdiff_t outer_outstanding_ = 0;
+  bool outer_done_ = false;
+  std::atomic<bool> cancelled_{false};
+  bool errored_ = false;
+  bool terminated_ = false;
+  std::exception_ptr error_;
+  // only used by the thread in drain()
+  std::vector<std::pair<up_t*, std::ptrdiff_t>> requests_;
+
+  template <class S>
+  static constexpr bool accepts_demand() {
+    return property_query_v<properties_t<S>, is_flow<>, is_many<>>;
+  }
+
+  // must be called before any input is added
+  void start(std::true_type /*flow*/) {
+    set_starting(out_, merge_up{this->shared_from_this()});
+  }
+  void start(std::false_type /*flow*/) {
+    requested_ = std::numeric_limits<std::ptrdiff_t>::max();
+  }
+
+  template <class S>
+  void add(S s) {
+    std::unique_lock<std::mutex> guard{lock_};
+    if (outer_outstanding_ > 0) {
+      --outer_outstanding_;
+    }
+    if (terminated_ || cancelled_ || errored_) {
+      return;
+    }
+    if (live_ >= max_concurrent_ || !pending_.empty()) {
+      pending_.push_back(
+          std::unique_ptr<pending_base>{new pending<S>{std::move(s)}});
+      return;
+    }
+    auto slot = allocate(accepts_demand<S>());
+    auto id = inputs_[slot].id_;
+    guard.unlock();
+    submit_input(std::move(s), slot, id);
+  }
+
+  template <class S>
+  void submit_input(S s, std::size_t slot, std::size_t id) {
+    using PS = properties_t<S>;
+    ::pushmi::submit(
+        std::move(s),
+        input_receiver<
+            property_query_v<PS, is_flow<>>,
+            property_query_v<PS, is_many<>>>{
+            this->shared_from_this(), slot, id});
+  }
+
+  void request(std::ptrdiff_t requested) {
+    if (requested < 1) {
+      return;
+    }
+    auto expected = requested_.load();
+    while (!requested_.compare_exchange_weak(
+        expected, merge_saturating_add(expected, requested))) {
+    }
+    drain();
+  }
+
+  void cancel() {
+    cancelled_.store(true);
+    drain();
+  }
+
+  template <class... VN>
+  void input_value(std::size_t slot, std::size_t id, bool last, VN&&... vn) {
+    std::unique_lock<std::mutex> guard{lock_};
+    auto& in = inputs_[slot];
+    if (terminated_ || !in.live_ || in.id_ != id || in.done_) {
+      return;
+    }
+    in.values_.emplace_back((VN &&) vn...);
+    if (!ordered_) {
+      arrivals_.push_back(slot);
+    }
+    ++queued_;
+    if (in.outstanding_ > 0) {
+      --in.outstanding_;
+    }
+    // single senders are complete once they deliver a value
+    in.done_ = last;
+    guard.unlock();
+    drain();
+  }
+
+  void input_error(std::size_t slot, std::size_t id, std::exception_ptr e) {
+    std::unique_lock<std::mutex> guard{lock_};
+    auto& in = inputs_[slot];
+    if (terminated_ || !in.live_ || in.id_ != id || in.done_) {
+      return;
+    }
+    in.done_ = true;
+    if (!errored_) {
+      errored_ = true;
+      error_ = e;
+    }
+    guard.unlock();
+    drain();
+  }
+
+  void input_done(std::size_t slot, std::size_t id) {
+    std::unique_lock<std::mutex> guard{lock_};
+    auto& in = inputs_[slot];
+    if (terminated_ || !in.live_ || in.id_ != id || in.done_) {
+      return;
+    }
+    in.done_ = true;
+    guard.unlock();
+    drain();
+  }
+
+  void input_starting(std::size_t slot, std::size_t id, up_t up) {
+    std::unique_lock<std::mutex> guard{lock_};
+    auto& in = inputs_[slot];
+    if (terminated_ || cancelled_ || errored_ || !in.live_ || in.id_ != id) {
+      guard.unlock();
+      set_done(up);
+      return;
+    }
+    in.up_ = std::move(up);
+    in.started_ = true;
+    guard.unlock();
+    drain();
+  }
+
+  void outer_starting(up_t up) {
+    std::unique_lock<std::mutex> guard{lock_};
+    if (terminated_ || cancelled_ || errored_) {
+      guard.unlock();
+      set_done(up);
+      return;
+    }
+    outer_up_ = std::move(up);
+    guard.unlock();
+    drain();
+  }
+
+  void outer_error(std::exception_ptr e) {
+    std::unique_lock<std::mutex> guard{lock_};
+    outer_done_ = true;
+    if (!errored_) {
+      errored_ = true;
+      error_ = e;
+    }
+    guard.unlock();
+    drain();
+  }
+
+  void outer_done() {
+    std::unique_lock<std::mutex> guard{lock_};
+    outer_done_ = true;
+    guard.unlock();
+    drain();
+  }
+
+  void drain() {
+    if (wip_.fetch_add(1) != 0) {
+      return;
+    }
+    int missed = 1;
+    for (;;) {
+      step();
+      missed = wip_.fetch_sub(missed) - missed;
+      if (missed == 0) {
+        break;
+      }
+    }
+  }
+
+ private:
+  std::size_t allocate(bool demand) {
+    std::size_t slot;
+    if (!free_.empty()) {
+      slot = free_.back();
+      free_.pop_back();
+      inputs_[slot] = input{};
+    } else {
+      slot = inputs_.size();
+      inputs_.emplace_back();
+    }
+    auto& in = inputs_[slot];
+    in.id_ = next_id_++;
+    in.demand_ = demand;
+    in.live_ = true;
+    ++live_;
+    if (ordered_) {
+      order_.push_back(slot);
+    }
+    return slot;
+  }
+
+  // release the slots of inputs that are complete and delivered.
+  void collect() {
+    for (std::size_t slot = 0; slot < inputs_.size(); ++slot) {
+      auto& in = inputs_[slot];
+      if (in.live_ && in.done_ && in.values_.empty()) {
+        in.live_ = false;
+        in.up_ = ::pushmi::detail::opt<up_t>{};
+        free_.push_back(slot);
+        --live_;
+        if (ordered_) {
+          order_.erase(std::find(order_.begin(), order_.end(), slot));
+        }
+      }
+    }
+  }
+
+  std::size_t next_value() {
+    if (ordered_) {
+      // only the oldest input is delivered, it is removed by collect()
+      if (order_.empty() || inputs_[order_.front()].values_.empty()) {
+        return npos;
+      }
+      return order_.front();
+    }
+    if (arrivals_.empty()) {
+      return npos;
+    }
+    auto slot = arrivals_.front();
+    arrivals_.pop_front();
+    return slot;
+  }
+
+  // split the demand that is not assigned to an input across the started
+  // inputs that accept requests.
+  void distribute() {
+    if (ordered_) {
+      distribute_ordered();
+      return;
+    }
+    std::ptrdiff_t assigned = queued_;
+    std::ptrdiff_t eligible = 0;
+    for (auto& in : inputs_) {
+      if (!in.live_) {
+        continue;
+      }
+      assigned = merge_saturating_add(assigned, in.outstanding_);
+      eligible += in.demand_ && in.started_ && !in.done_;
+    }
+    auto requested = requested_.load();
+    if (eligible == 0 || requested <= assigned) {
+      return;
+    }
+    auto unassigned = requested - assigned;
+    auto share = unassigned / eligible;
+    auto remainder = unassigned % eligible;
+    auto size = inputs_.size();
+    for (std::size_t n = 0; n < size; ++n) {
+      auto& in = inputs_[(next_ + n) % size];
+      if (!in.live_ || !in.demand_ || !in.started_ || in.done_) {
+        continue;
+      }
+      auto amount = share + (remainder > 0 ? 1 : 0);
+      remainder -= remainder > 0 ? 1 : 0;
+      if (amount > 0) {
+        in.outstanding_ = merge_saturating_add(in.outstanding_, amount);
+        requests_.emplace_back(&*in.up_, amount);
+      }
+    }
+    next_ = (next_ + 1) % size;
+  }
+
+  // the oldest input is sent the demand that it has not already satisfied.
+  void distribute_ordered() {
+    if (order_.empty()) {
+      return;
+    }
+    auto& in = inputs_[order_.front()];
+    if (!in.demand_ || !in.started_ || in.done_) {
+      return;
+    }
+    auto assigned = merge_saturating_add(
+        static_cast<std::ptrdiff_t>(in.values_.size()), in.outstanding_);
+    auto requested = requested_.load();
+    if (requested <= assigned) {
+      return;
+    }
+    auto amount = requested - assigned;
+    in.outstanding_ = merge_saturating_add(in.outstanding_, amount);
+    requests_.emplace_back(&*in.up_, amount);
+  }
+
+  std::ptrdiff_t outer_request() {
+    if (!outer_up_ || outer_done_) {
+      return 0;
+    }
+    if (max_concurrent_ == npos) {
+      if (outer_outstanding_ > 0) {
+        return 0;
+      }
+      return outer_outstanding_ = std::numeric_limits<std::ptrdiff_t>::max();
+    }
+    auto busy = live_ + pending_.size() +
+        static_cast<std::size_t>(outer_outstanding_);
+    if (busy >= max_concurrent_) {
+      return 0;
+    }
+    auto requested = static_cast<std::ptrdiff_t>(max_concurrent_ - busy);
+    outer_outstanding_ += requested;
+    return requested;
+  }
+
+  void terminate(std::unique_lock<std::mutex>& guard) {
+    terminated_ = true;
+    std::vector<up_t> ups;
+    for (auto& in : inputs_) {
+      if (in.live_ && !in.done_ && !!in.up_) {
+        ups.push_back(std::move(*in.up_));
+      }
+      in.up_ = ::pushmi::detail::opt<up_t>{};
+      in.values_.clear();
+    }
+    if (!!outer_up_ && !outer_done_) {
+      ups.push_back(std::move(*outer_up_));
+    }
+    outer_up_ = ::pushmi::detail::opt<up_t>{};
+    arrivals_.clear();
+    order_.clear();
+    pending_.clear();
+    guard.unlock();
+    for (auto& up : ups) {
+      set_done(up);
+    }
+    if (errored_) {
+      set_error(out_, error_);
+    } else {
+      set_done(out_);
+    }
+  }
+
+  void step() {
+    std::unique_lock<std::mutex> guard{lock_};
+    for (;;) {
+      if (terminated_) {
+        return;
+      }
+      if (errored_ || cancelled_) {
+        terminate(guard);
+        return;
+      }
+      collect();
+      if (requested_.load() > 0) {
+        auto slot = next_value();
+        if (slot != npos) {
+          auto& in = inputs_[slot];
+          auto v = std::move(in.values_.front());
+          in.values_.pop_front();
+          --queued_;
+          --requested_;
+          guard.unlock();
+          ::pushmi::apply(
+              ::pushmi::set_value,
+              std::tuple_cat(std::tuple<Out&>{out_}, std::move(v)));
+          guard.lock();
+          continue;
+        }
+      }
+      if (!pending_.empty() && live_ < max_concurrent_) {
+        auto p = std::move(pending_.front());
+        pending_.pop_front();
+        auto slot = allocate(p->demand());
+        auto id = inputs_[slot].id_;
+        guard.unlock();
+        p->submit(*this, slot, id);
+        guard.lock();
+        continue;
+      }
+      if (outer_done_ && live_ == 0 && pending_.empty()) {
+        terminated_ = true;
+        guard.unlock();
+        set_done(out_);
+        return;
+      }
+      requests_.clear();
+      distribute();
+      auto outer = outer_request();
+      guard.unlock();
+      // the up receivers of live inputs are only released by this thread
+      for (auto& r : requests_) {
+        set_value(*r.first, r.second);
+      }
+      if (outer > 0) {
+        set_value(*outer_up_, outer);
+      }
+      return;
+    }
+  }
+};
+
+template <class... TN>
+struct merge_fn {
+ private:
+  template <class... SN>
+  struct out_impl {
+    std::tuple<SN...> sn_;
+    template <class Shared>
+    struct add_all {
+      Shared* s_;
+      void operator()(SN&... sn) const {
+        (void)std::initializer_list<int>{(s_->add(sn), 0)...};
+      }
+    };
+    PUSHMI_TEMPLATE(class Out)
+    (requires ReceiveError<Out, std::exception_ptr>) //
+        void
+        operator()(Out out) {
+      using Shared = merge_shared<Out, TN...>;
+      auto s = std::make_shared<Shared>(
+          std::move(out), std::numeric_limits<std::size_t>::max());
+      s->start(bool_<property_query_v<properties_t<Out>, is_flow<>>>{});
+      // copy the senders so that the merge can be submitted again
+      ::pushmi::apply(add_all<Shared>{s.get()}, sn_);
+      s->outer_done();
+    }
+  };
+
+ public:
+  PUSHMI_TEMPLATE(class... SN)
+  (requires And<Sender<SN, is_many<>, is_flow<>>...>) //
+      auto
+      operator()(SN... sn) const {
+    return make_flow_many_sender(
+        out_impl<SN...>{std::tuple<SN...>{std::move(sn)...}});
+  }
+  PUSHMI_TEMPLATE(class... SN)
+  (requires And<Sender<SN>...> && not And<Sender<SN, is_many<>, is_flow<>>...>) //
+      auto
+      operator()(SN... sn) const {
+    return make_many_sender(
+        out_impl<SN...>{std::tuple<SN...>{std::move(sn)...}});
+  }
+};
+
+struct merge_identity {
+  template <class S>
+  S operator()(S s) const {
+    return s;
+  }
+};
+
+template <class... TN>
+struct merge_all_fn {
+ private:
+  template <class In, class Selector>
+  struct out_impl {
+    In in_;
+    Selector select_;
+    std::size_t max_concurrent_;
+    bool ordered_;
+    PUSHMI_TEMPLATE(class Out)
+    (requires ReceiveError<Out, std::exception_ptr>) //
+        void
+        operator()(Out out) {
+      using Shared = merge_shared<Out, TN...>;
+      constexpr bool IsFlow = property_query_v<properties_t<In>, is_flow<>>;
+      auto s = std::make_shared<Shared>(
+          std::move(out), max_concurrent_, ordered_);
+      s->start(bool_<IsFlow>{});
+      ::pushmi::submit(
+          in_,
+          typename Shared::template outer_receiver<IsFlow, Selector>{
+              s, select_});
+    }
+  };
+
+ public:
+  // the implementation for operators that map each value to an inner sender.
+  template <class Selector>
+  struct adapt_impl {
+    Selector select_;
+    std::size_t max_concurrent_;
+    bool ordered_;
+    PUSHMI_TEMPLATE(class In)
+    (requires Sender<In, is_many<>, is_flow<>>) //
+        auto
+        operator()(In in) const {
+      return make_flow_many_sender(out_impl<In, Selector>{
+          std::move(in), select_, max_concurrent_, ordered_});
+    }
+    PUSHMI_TEMPLATE(class In)
+    (requires Sender<In, is_many<>> && not Flow<In>) //
+        auto
+        operator()(In in) const {
+      return make_many_sender(out_impl<In, Selector>{
+          std::move(in), select_, max_concurrent_, ordered_});
+    }
+  };
+
+  auto operator()() const {
+    return (*this)(std::numeric_limits<std::size_t>::max());
+  }
+  auto operator()(std::size_t max_concurrent) const {
+    return adapt_impl<merge_identity>{
+        merge_identity{}, max_concurrent < 1 ? 1 : max_concurrent, false};
+  }
+};
+
+} // namespace detail
+
+namespace operators {
+
+// merge<TN...>(senders...) delivers the values of all the senders to one
+// receiver as they arrive. the result is a flow_many sender when all the
+// senders are flow_many senders.
+template <class... TN>
+PUSHMI_INLINE_VAR constexpr detail::merge_fn<TN...> merge{};
+
+// merge_all<TN...>(max_concurrent) merges the senders delivered by a many
+// sender, with at most max_concurrent of them submitted at a time.
+template <class... TN>
+PUSHMI_INLINE_VAR constexpr detail::merge_all_fn<TN...> merge_all{};
+
+} // namespace operators
+
+} // namespace pushmi
@@ -43,8 +43,9 @@ struct on_fn {
       auto exec = ::pushmi::make_strand(ef_);
       submit(
           ::pushmi::schedule(exec),
-          ::pushmi::make_receiver(on_value_impl<std::decay_t<In>, Out>{
-              (In&&) in, std::move(out)}));
+          ::pushmi::detail::trace_receiver(
+              ::pushmi::make_receiver(on_value_impl<std::decay_t<In>, Out>{
+                  (In&&) in, std::move(out)})));
     }
   };
   template <class Factory>
@@ -0,0 +1,125 @@
+/*
+ * Copyright 2018-present Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <exception>
+#include <tuple>
+
+#include <pushmi/detail/opt.h>
+#include <pushmi/executor.h>
+#include <pushmi/o/flat_map.h>
+#include <pushmi/single_sender.h>
+
+namespace pushmi {
+
+namespace detail {
+
+// calls f with the values on the executor and delivers the result and then
+// done. an exception thrown by f is delivered as the error.
+template <class Out, class F, class Args>
+struct parallel_transform_run {
+  using properties = property_set<is_receiver<>>;
+
+  Out out_;
+  F f_;
+  Args args_;
+
+  template <class Exec>
+  void value(Exec&&) {
+    using result_t = decltype(::pushmi::apply(f_, std::move(args_)));
+    ::pushmi::detail::opt<result_t> result;
+    try {
+      result = ::pushmi::apply(f_, std::move(args_));
+    } catch (...) {
+      ::pushmi::set_error(out_, std::current_exception());
+      return;
+    }
+    ::pushmi::set_value(out_, std::move(*result));
+    ::pushmi::set_done(out_);
+  }
+  template <class E>
+  void error(E e) noexcept {
+    ::pushmi::set_error(out_, std::move(e));
+  }
+  void done() {
+    ::pushmi::set_done(out_);
+  }
+};
+
+template <class F, class Exec, class Args>
+struct parallel_transform_task {
+  F f_;
+  Exec exec_;
+  Args args_;
+  PUSHMI_TEMPLATE(class Out)
+  (requires Receiver<Out>) //
+      void
+      operator()(Out out) {
+    ::pushmi::submit(
+        ::pushmi::schedule(exec_),
+        parallel_transform_run<Out, F, Args>{std::move(out), f_, args_});
+  }
+};
+
+// maps each value to a single sender that calls f on the executor.
+template <class F, class Exec>
+struct parallel_transform_select {
+  F f_;
+  Exec exec_;
+  template <class... VN>
+  auto operator()(VN&&... vn) const {
+    using Args = std::tuple<std::decay_t<VN>...>;
+    return make_single_sender(parallel_transform_task<F, Exec, Args>{
+        f_, exec_, Args{(VN &&) vn...}});
+  }
+};
+
+// parallel_transform runs f for up to max_in_flight values at once on a
+// concurrent executor. ordered results are held in the slots of concat_map
+// until the earlier values are delivered.
+template <bool Ordered, class... TN>
+struct parallel_transform_fn {
+  PUSHMI_TEMPLATE(class Exec, class... FN)
+  (requires Executor<Exec>) //
+      auto
+      operator()(Exec exec, std::size_t max_in_flight, FN... fn) const {
+    auto f = ::pushmi::overload(std::move(fn)...);
+    using F = decltype(f);
+    return flat_map_fn<Ordered, TN...>{}(
+        parallel_transform_select<F, Exec>{std::move(f), std::move(exec)},
+        max_in_flight);
+  }
+};
+
+} // namespace detail
+
+namespace operators {
+
+// parallel_transform<TN...>(exec, max_in_flight, f) delivers the results in
+// the order of the values.
+template <class... TN>
+PUSHMI_INLINE_VAR constexpr detail::parallel_transform_fn<true, TN...>
+    parallel_transform{};
+
+// parallel_transform_unordered<TN...>(exec, max_in_flight, f) delivers the
+// results in the order that they are computed.
+template <class... TN>
+PUSHMI_INLINE_VAR constexpr detail::parallel_transform_fn<false, TN...>
+    parallel_transform_unordered{};
+
+} // namespace operators
+
+} // namespace pushmi
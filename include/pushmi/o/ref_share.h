@@ -0,0 +1,468 @@
+/*
+ * Copyright 2018-present Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <exception>
+#include <limits>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <tuple>
+#include <vector>
+
+#include <pushmi/detail/opt.h>
+#include <pushmi/flow_receiver.h>
+#include <pushmi/o/extension_operators.h>
+#include <pushmi/o/submit.h>
+#include <pushmi/receiver.h>
+
+namespace pushmi {
+
+namespace detail {
+
+// ref_share connects to the upstream flow_many sender when the first
+// receiver is submitted and cancels the upstream, through the up receiver
+// that the upstream passed to set_starting, when the last receiver cancels.
+//
+// The upstream is only asked for as many values as every current receiver
+// has requested (the minimum across receivers), and a value is only
+// delivered to receivers with outstanding demand. Once the upstream
+// completes, the next receiver submitted starts a new connection.
+//
+// every signal updates the state under lock_ and then calls drain().
+// drain() is entered by one thread at a time (the wip_ counter admits the
+// first caller and counts the callers that arrived while it was running) and
+// that thread makes all the calls into the receivers and into the upstream,
+// without holding lock_. values from the upstream are queued until drain()
+// delivers them, so a receiver or upstream that signals back from another
+// thread, or from inside of a signal, never waits for lock_ to be released
+// by a signal that is waiting for it.
+template <class In, class... TN>
+struct ref_share_shared
+    : std::enable_shared_from_this<ref_share_shared<In, TN...>> {
+  using receiver_t = any_flow_receiver<
+      std::exception_ptr,
+      std::ptrdiff_t,
+      std::exception_ptr,
+      TN...>;
+  using up_t = any_receiver<std::exception_ptr, std::ptrdiff_t>;
+
+  struct subscriber {
+    std::size_t id;
+    receiver_t out;
+    // the upstream connection that this receiver shares
+    std::size_t connection;
+    std::ptrdiff_t requested;
+    bool started;
+    bool ended;
+    // ended has been delivered to out
+    bool signalled;
+    bool errored;
+    std::exception_ptr error;
+  };
+
+  // a value from the upstream, or its completion when value is empty
+  struct upstream_event {
+    std::size_t connection;
+    ::pushmi::detail::opt<std::tuple<TN...>> value;
+    bool errored;
+    std::exception_ptr error;
+  };
+
+  explicit ref_share_shared(In in) : in_(std::move(in)) {}
+
+  In in_;
+  std::atomic<int> wip_{0};
+  std::mutex lock_;
+  // only the thread in drain() removes receivers, so it can signal them
+  // without holding lock_.
+  std::list<subscriber> receivers_;
+  std::size_t next_id_ = 0;
+  std::deque<upstream_event> events_;
+  bool connected_ = false;
+  // incremented for each connection so that signals from a cancelled
+  // upstream are dropped.
+  std::size_t connection_ = 0;
+  // shared so that drain() can signal it without holding lock_
+  std::shared_ptr<up_t> up_;
+  std::ptrdiff_t upstream_requested_ = 0;
+  // the up receivers of disconnected upstreams that drain() will cancel
+  std::deque<std::shared_ptr<up_t>> cancels_;
+  // only used by the thread in drain()
+  std::vector<receiver_t*> recipients_;
+
+  struct up_receiver {
+    using properties = property_set<is_receiver<>>;
+
+    std::shared_ptr<ref_share_shared> s;
+    std::size_t id;
+
+    void value(std::ptrdiff_t requested) {
+      s->request(id, requested);
+    }
+    template <class E>
+    void error(E) noexcept {
+      s->cancel(id);
+    }
+    void done() {
+      s->cancel(id);
+    }
+  };
+
+  struct upstream_receiver {
+    using properties = property_set<is_receiver<>, is_flow<>>;
+
+    std::shared_ptr<ref_share_shared> s;
+    std::size_t connection;
+
+    PUSHMI_TEMPLATE(class... VN)
+    (requires And<SemiMovable<VN>...>)
+    void value(VN&&... vn) {
+      s->value(connection, (VN &&) vn...);
+    }
+    PUSHMI_TEMPLATE(class E)
+    (requires SemiMovable<E>)
+    void error(E e) noexcept {
+      s->error(connection, std::move(e));
+    }
+    void done() {
+      s->done(connection);
+    }
+    PUSHMI_TEMPLATE(class Up)
+    (requires ReceiveValue<Up, std::ptrdiff_t>&&
+         ReceiveError<Up, std::exception_ptr>)
+    void starting(Up&& up) {
+      // up may own this receiver, copy the state out before moving it.
+      auto shared = s;
+      shared->starting(connection, up_t{(Up &&) up});
+    }
+  };
+
+  PUSHMI_TEMPLATE(class Out)
+  (requires ReceiveError<Out, std::exception_ptr>)
+  void submit(Out out) {
+    std::unique_lock<std::mutex> guard(lock_);
+    auto id = next_id_++;
+    bool connect = !connected_;
+    if (connect) {
+      connected_ = true;
+      ++connection_;
+      up_.reset();
+      upstream_requested_ = 0;
+    }
+    auto connection = connection_;
+    receivers_.push_back(subscriber{id,
+                                    receiver_t{std::move(out)},
+                                    connection,
+                                    0,
+                                    false,
+                                    false,
+                                    false,
+                                    false,
+                                    {}});
+    guard.unlock();
+    // delivers set_starting
+    drain();
+    if (connect) {
+      ::pushmi::submit(
+          in_, upstream_receiver{this->shared_from_this(), connection});
+    }
+  }
+
+  void request(std::size_t id, std::ptrdiff_t requested) {
+    if (requested < 1) {
+      return;
+    }
+    std::unique_lock<std::mutex> guard(lock_);
+    for (auto& sub : receivers_) {
+      if (sub.id == id && !sub.ended) {
+        sub.requested =
+            std::numeric_limits<std::ptrdiff_t>::max() - sub.requested <
+                requested
+            ? std::numeric_limits<std::ptrdiff_t>::max()
+            : sub.requested + requested;
+        break;
+      }
+    }
+    guard.unlock();
+    drain();
+  }
+
+  void cancel(std::size_t id) {
+    std::unique_lock<std::mutex> guard(lock_);
+    for (auto& sub : receivers_) {
+      if (sub.id == id && !sub.ended) {
+        sub.ended = true;
+        break;
+      }
+    }
+    if (!live()) {
+      disconnect();
+    }
+    guard.unlock();
+    drain();
+  }
+
+  void starting(std::size_t connection, up_t up) {
+    std::unique_lock<std::mutex> guard(lock_);
+    if (!connected_ || connection != connection_) {
+      guard.unlock();
+      // cancelled before the upstream started
+      set_done(up);
+      return;
+    }
+    up_ = std::make_shared<up_t>(std::move(up));
+    if (!live()) {
+      disconnect();
+    }
+    guard.unlock();
+    drain();
+  }
+
+  template <class... VN>
+  void value(std::size_t connection, VN&&... vn) {
+    std::unique_lock<std::mutex> guard(lock_);
+    if (!connected_ || connection != connection_) {
+      return;
+    }
+    --upstream_requested_;
+    events_.push_back(upstream_event{
+        connection, std::tuple<TN...>{(VN &&) vn...}, false, {}});
+    guard.unlock();
+    drain();
+  }
+
+  template <class E>
+  void error(std::size_t connection, E e) noexcept {
+    std::unique_lock<std::mutex> guard(lock_);
+    if (!connected_ || connection != connection_) {
+      return;
+    }
+    complete();
+    events_.push_back(upstream_event{
+        connection, {}, true, as_exception_ptr(std::move(e))});
+    guard.unlock();
+    drain();
+  }
+
+  void done(std::size_t connection) {
+    std::unique_lock<std::mutex> guard(lock_);
+    if (!connected_ || connection != connection_) {
+      return;
+    }
+    complete();
+    events_.push_back(upstream_event{connection, {}, false, {}});
+    guard.unlock();
+    drain();
+  }
+
+  void drain() {
+    if (wip_.fetch_add(1) != 0) {
+      return;
+    }
+    int missed = 1;
+    for (;;) {
+      step();
+      missed = wip_.fetch_sub(missed) - missed;
+      if (missed == 0) {
+        break;
+      }
+    }
+  }
+
+ private:
+  // the receivers of the current connection that have not ended
+  bool live() const {
+    for (auto& sub : receivers_) {
+      if (sub.connection == connection_ && !sub.ended) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  // the upstream has completed, the next submit will connect again.
+  void complete() {
+    connected_ = false;
+    up_.reset();
+    upstream_requested_ = 0;
+  }
+
+  // the last receiver has left, cancel the upstream.
+  void disconnect() {
+    if (!connected_) {
+      return;
+    }
+    connected_ = false;
+    upstream_requested_ = 0;
+    if (!!up_) {
+      cancels_.push_back(std::move(up_));
+      up_.reset();
+    }
+    // when the upstream has not started yet, starting() will find
+    // connected_ false and cancel it.
+  }
+
+  // delivers one signal at a time, in this order: set_starting to new
+  // receivers, the end of receivers that have ended, cancellation of
+  // disconnected upstreams, the queued upstream signals and, once those are
+  // all delivered, a request for the values that every receiver can accept.
+  void step() {
+    std::unique_lock<std::mutex> guard(lock_);
+    for (;;) {
+      receivers_.remove_if(
+          [](const subscriber& sub) { return sub.signalled; });
+
+      auto sub = std::find_if(
+          receivers_.begin(), receivers_.end(), [](const subscriber& sub) {
+            return !sub.started;
+          });
+      if (sub != receivers_.end()) {
+        sub->started = true;
+        auto id = sub->id;
+        guard.unlock();
+        set_starting(sub->out, up_receiver{this->shared_from_this(), id});
+        guard.lock();
+        continue;
+      }
+
+      sub = std::find_if(
+          receivers_.begin(), receivers_.end(), [](const subscriber& sub) {
+            return sub.ended && !sub.signalled;
+          });
+      if (sub != receivers_.end()) {
+        // removed by the next pass, not before out is signalled
+        auto errored = sub->errored;
+        auto e = sub->error;
+        guard.unlock();
+        if (errored) {
+          set_error(sub->out, std::move(e));
+        } else {
+          set_done(sub->out);
+        }
+        guard.lock();
+        sub->signalled = true;
+        continue;
+      }
+
+      if (!cancels_.empty()) {
+        auto up = std::move(cancels_.front());
+        cancels_.pop_front();
+        guard.unlock();
+        set_done(*up);
+        guard.lock();
+        continue;
+      }
+
+      if (!events_.empty()) {
+        auto event = std::move(events_.front());
+        events_.pop_front();
+        if (!event.value) {
+          for (auto& s : receivers_) {
+            if (s.connection == event.connection && !s.ended) {
+              s.ended = true;
+              s.errored = event.errored;
+              s.error = event.error;
+            }
+          }
+          continue;
+        }
+        recipients_.clear();
+        for (auto& s : receivers_) {
+          if (s.connection == event.connection && s.started && !s.ended &&
+              s.requested > 0) {
+            --s.requested;
+            recipients_.push_back(&s.out);
+          }
+        }
+        guard.unlock();
+        for (auto out : recipients_) {
+          ::pushmi::apply(
+              [out](const TN&... vn) { set_value(*out, vn...); },
+              ::pushmi::detail::as_const(*event.value));
+        }
+        guard.lock();
+        continue;
+      }
+
+      // ask the upstream for the values that every receiver can accept.
+      if (!connected_ || !up_) {
+        return;
+      }
+      std::ptrdiff_t target = std::numeric_limits<std::ptrdiff_t>::max();
+      for (auto& s : receivers_) {
+        if (s.connection == connection_ && !s.ended) {
+          target = std::min(target, s.requested);
+        }
+      }
+      if (target <= upstream_requested_) {
+        return;
+      }
+      auto requested = target - upstream_requested_;
+      upstream_requested_ = target;
+      auto up = up_;
+      guard.unlock();
+      set_value(*up, requested);
+      guard.lock();
+    }
+  }
+};
+
+template <class In, class... TN>
+struct ref_share_sender {
+  using properties = property_set<is_sender<>, is_flow<>, is_many<>>;
+
+  std::shared_ptr<ref_share_shared<In, TN...>> s;
+
+  PUSHMI_TEMPLATE(class Out)
+  (requires ReceiveError<Out, std::exception_ptr>&&
+       FlowUpTo<Out, any_receiver<std::exception_ptr, std::ptrdiff_t>>)
+  void submit(Out out) {
+    s->submit(std::move(out));
+  }
+};
+
+template <class... TN>
+struct ref_share_fn {
+ private:
+  struct impl {
+    PUSHMI_TEMPLATE(class In)
+    (requires FlowSender<In, is_many<>>)
+    auto operator()(In in) const {
+      return ref_share_sender<In, TN...>{
+          std::make_shared<ref_share_shared<In, TN...>>(std::move(in))};
+    }
+  };
+
+ public:
+  auto operator()() const {
+    return impl{};
+  }
+};
+
+} // namespace detail
+
+namespace operators {
+
+template <class... TN>
+PUSHMI_INLINE_VAR constexpr detail::ref_share_fn<TN...> ref_share{};
+
+} // namespace operators
+
+} // namespace pushmi
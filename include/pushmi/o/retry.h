@@ -0,0 +1,186 @@
+/*
+ * Copyright 2018-present Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <exception>
+#include <memory>
+#include <random>
+
+#include <pushmi/executor.h>
+#include <pushmi/o/extension_operators.h>
+#include <pushmi/o/submit.h>
+#include <pushmi/receiver.h>
+
+namespace pushmi {
+
+// retry_policy describes how often and how soon retry submits the input
+// again after an error.
+struct retry_policy {
+  // the number of times that the input is submitted, including the first
+  std::size_t max_attempts = 3;
+  // the delay before the second attempt
+  std::chrono::nanoseconds initial_delay = std::chrono::milliseconds(10);
+  // each delay is the previous delay times the multiplier
+  double multiplier = 2.0;
+  // no delay is longer than max_delay
+  std::chrono::nanoseconds max_delay = std::chrono::seconds(10);
+  // each delay is reduced by a random fraction in [0, jitter) so that the
+  // retries of many failed requests are spread out.
+  double jitter = 0.0;
+
+  // the delay before the attempt that follows 'attempt' failures
+  template <class URNG>
+  std::chrono::nanoseconds delay(std::size_t attempt, URNG& g) const {
+    double d = static_cast<double>(initial_delay.count());
+    double limit = static_cast<double>(max_delay.count());
+    for (std::size_t n = 1; n < attempt && d < limit; ++n) {
+      d *= multiplier;
+    }
+    d = std::min(d, limit);
+    if (jitter > 0.0) {
+      d -= d * jitter * std::uniform_real_distribution<double>{0.0, 1.0}(g);
+    }
+    return std::chrono::nanoseconds{static_cast<std::int64_t>(d)};
+  }
+};
+
+namespace detail {
+
+//
+// retry_shared holds the input so that it can be submitted again. a new
+// receiver is submitted for each attempt, after the previous attempt has
+// delivered its error.
+//
+// the delay is a timer on the time executor, no thread waits for it.
+//
+template <class In, class Out, class Exec>
+struct retry_shared
+    : std::enable_shared_from_this<retry_shared<In, Out, Exec>> {
+  retry_shared(In in, Out out, Exec exec, retry_policy policy)
+      : in_(std::move(in)),
+        out_(std::move(out)),
+        exec_(std::move(exec)),
+        policy_(std::move(policy)),
+        random_(static_cast<std::uint_fast32_t>(
+            std::chrono::steady_clock::now().time_since_epoch().count())) {}
+
+  In in_;
+  Out out_;
+  Exec exec_;
+  retry_policy policy_;
+  std::minstd_rand random_;
+  std::size_t attempt_ = 0;
+
+  struct attempt_receiver {
+    using properties = property_set<is_receiver<>>;
+
+    std::shared_ptr<retry_shared> s_;
+
+    template <class... VN>
+    void value(VN&&... vn) {
+      set_value(s_->out_, (VN &&) vn...);
+    }
+    template <class E>
+    void error(E e) noexcept {
+      s_->failed(std::move(e));
+    }
+    void done() {
+      set_done(s_->out_);
+    }
+  };
+
+  struct resubmit_fn {
+    std::shared_ptr<retry_shared> s_;
+    void operator()(any) {
+      s_->submit();
+    }
+  };
+
+  void submit() {
+    ++attempt_;
+    ::pushmi::submit(in_, attempt_receiver{this->shared_from_this()});
+  }
+
+  template <class E>
+  void failed(E e) noexcept {
+    if (attempt_ >= policy_.max_attempts) {
+      set_error(out_, std::move(e));
+      return;
+    }
+    // failed() is called from error(), so an exception from scheduling the
+    // next attempt is delivered instead of escaping
+    try {
+      auto delay = policy_.delay(attempt_, random_);
+      ::pushmi::submit(
+          ::pushmi::schedule(exec_, ::pushmi::now(exec_) + delay),
+          ::pushmi::make_receiver(
+              resubmit_fn{this->shared_from_this()},
+              [s = this->shared_from_this()](auto e) noexcept {
+                set_error(s->out_, std::move(e));
+              }));
+    } catch (...) {
+      set_error(out_, std::current_exception());
+    }
+  }
+};
+
+struct retry_fn {
+ private:
+  template <class In, class Exec>
+  struct submit_impl {
+    Exec exec_;
+    retry_policy policy_;
+    PUSHMI_TEMPLATE(class SIn, class Out)
+    (requires Receiver<Out>) //
+        void
+        operator()(SIn&& in, Out out) const {
+      std::make_shared<retry_shared<In, Out, Exec>>(
+          (SIn &&) in, std::move(out), exec_, policy_)
+          ->submit();
+    }
+  };
+  template <class Exec>
+  struct adapt_impl {
+    Exec exec_;
+    retry_policy policy_;
+    PUSHMI_TEMPLATE(class In)
+    (requires Sender<In> && not Flow<In>) //
+        auto
+        operator()(In in) const {
+      return ::pushmi::detail::sender_from(
+          std::move(in), submit_impl<In, Exec>{exec_, policy_});
+    }
+  };
+
+ public:
+  PUSHMI_TEMPLATE(class Exec)
+  (requires TimeExecutor<Exec>) //
+      auto
+      operator()(retry_policy policy, Exec exec) const {
+    return adapt_impl<Exec>{std::move(exec), std::move(policy)};
+  }
+};
+
+} // namespace detail
+
+namespace operators {
+PUSHMI_INLINE_VAR constexpr detail::retry_fn retry{};
+} // namespace operators
+
+} // namespace pushmi
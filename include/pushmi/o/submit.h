@@ -16,6 +16,7 @@
 #pragma once
 
 #include <pushmi/boosters.h>
+#include <pushmi/detail/futex.h>
 #include <pushmi/detail/opt.h>
 #include <pushmi/o/extension_operators.h>
 #include <pushmi/o/schedule.h>
@@ -48,8 +49,10 @@ struct submit_fn {
         operator()(In&& in) {
       using maker_t = ::pushmi::detail::receiver_from_fn<std::decay_t<In>>;
       using receiver_t = invoke_result_t<maker_t, std::tuple<AN...>&&>;
-      receiver_t out{
-          maker_t{}(std::move(args_))};
+      receiver_t out = [&] {
+        trace_operator_scope scope{"submit"};
+        return maker_t{}(std::move(args_));
+      }();
       ::pushmi::submit((In &&) in, std::move(out));
     }
   };
@@ -63,11 +66,42 @@ struct submit_fn {
 
 struct blocking_submit_fn {
  private:
+  // lock_state packs the done bit, the parked bit and the count of nested
+  // executors that are still running into one word. completion is one
+  // atomic operation, the waiting thread spins for a while and only then
+  // parks, and a completion only makes a syscall when it has parked.
   struct lock_state {
-    bool done{false};
-    std::atomic<int> nested{0};
-    std::mutex lock;
-    std::condition_variable signaled;
+    static constexpr int done_bit = 1;
+    static constexpr int parked_bit = 2;
+    static constexpr int nested_one = 4;
+
+    std::atomic<int> word{0};
+
+    static bool ready(int w) noexcept {
+      return (w & done_bit) != 0 && w < nested_one;
+    }
+    void nest() noexcept {
+      word.fetch_add(nested_one, std::memory_order_relaxed);
+    }
+    void unnest() noexcept {
+      signal(
+          word.fetch_sub(nested_one, std::memory_order_acq_rel) - nested_one);
+    }
+    void complete() noexcept {
+      signal(word.fetch_or(done_bit, std::memory_order_acq_rel) | done_bit);
+    }
+    void wait() noexcept {
+      ::pushmi::detail::spin_then_park(word, parked_bit, &lock_state::ready);
+    }
+
+   private:
+    // the waiter may return and destroy this state as soon as the word is
+    // ready, so only the address of the word is used to wake it.
+    void signal(int w) noexcept {
+      if (ready(w) && (w & parked_bit) != 0) {
+        ::pushmi::detail::futex_wake(word);
+      }
+    }
   };
 
   template<class Task>
@@ -125,7 +159,7 @@ struct blocking_submit_fn {
     PUSHMI_TEMPLATE(class Out)
     (requires Receiver<Out>) //
         void submit(Out out) && {
-      ++state_->nested;
+      state_->nest();
       ::pushmi::submit(
           std::move(t_), nested_receiver_impl<Out>{state_, std::move(out)});
     }
@@ -150,9 +184,7 @@ struct blocking_submit_fn {
     template <class E>
     void error(E&& e) noexcept {
       set_error(out_, (E &&) e);
-      if (--state_->nested == 0) {
-        state_->signaled.notify_all();
-      }
+      state_->unnest();
     }
     void done() {
       std::exception_ptr e;
@@ -161,9 +193,7 @@ struct blocking_submit_fn {
       } catch (...) {
         e = std::current_exception();
       }
-      if (--state_->nested == 0) {
-        state_->signaled.notify_all();
-      }
+      state_->unnest();
       if (e) {
         std::rethrow_exception(e);
       }
@@ -188,12 +218,9 @@ struct blocking_submit_fn {
             std::decay_t<Value>>>) //
         void
         operator()(Out out, Value&& v) const {
-      ++state_->nested;
+      state_->nest();
       set_value(out, nested_executor_impl_fn{}(state_, (Value &&) v));
-      if (--state_->nested == 0) {
-        std::unique_lock<std::mutex> guard{state_->lock};
-        state_->signaled.notify_all();
-      }
+      state_->unnest();
     }
     PUSHMI_TEMPLATE(class Out, class... VN)
     (requires True<>&& ReceiveValue<Out, VN...> &&
@@ -210,9 +237,7 @@ struct blocking_submit_fn {
         void
         operator()(Out out, E e) const noexcept {
       set_error(out, std::move(e));
-      std::unique_lock<std::mutex> guard{state_->lock};
-      state_->done = true;
-      state_->signaled.notify_all();
+      state_->complete();
     }
   };
   struct on_done_impl {
@@ -222,9 +247,7 @@ struct blocking_submit_fn {
         void
         operator()(Out out) const {
       set_done(out);
-      std::unique_lock<std::mutex> guard{state_->lock};
-      state_->done = true;
-      state_->signaled.notify_all();
+      state_->complete();
     }
   };
 
@@ -272,11 +295,13 @@ struct blocking_submit_fn {
 
       auto make = receiver_impl<std::decay_t<In>>{};
       auto submit = submit_impl<In>{};
-      submit((In &&) in, make(&state, std::move(args_)));
+      auto out = [&] {
+        trace_operator_scope scope{"blocking_submit"};
+        return make(&state, std::move(args_));
+      }();
+      submit((In &&) in, std::move(out));
 
-      std::unique_lock<std::mutex> guard{state.lock};
-      state.signaled.wait(
-          guard, [&] { return state.done && state.nested.load() == 0; });
+      state.wait();
     }
   };
 
@@ -0,0 +1,368 @@
+/*
+ * Copyright 2018-present Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <memory>
+#include <mutex>
+
+#include <pushmi/executor.h>
+#include <pushmi/flow_receiver.h>
+#include <pushmi/o/extension_operators.h>
+#include <pushmi/o/submit.h>
+#include <pushmi/receiver.h>
+
+namespace pushmi {
+
+namespace detail {
+
+enum class throttle_mode {
+  // emit the latest value once no value has arrived for the duration
+  debounce,
+  // emit a value and drop the values that arrive within the duration
+  first,
+  // emit the latest value at the end of the duration after a value arrives
+  last
+};
+
+//
+// throttle_shared holds the state of debounce, throttle_first and
+// throttle_last. there is at most one timer pending for each instance,
+// debounce moves its deadline forward and re-arms the same timer when it
+// expires early instead of scheduling a timer for every value.
+//
+// for flow senders every value that is dropped or replaced is replaced by a
+// request for one more value, so that the values emitted match the demand.
+//
+template <throttle_mode Mode, class T, class Out, class Exec, class Dur>
+struct throttle_shared
+    : std::enable_shared_from_this<throttle_shared<Mode, T, Out, Exec, Dur>> {
+  using up_t = any_receiver<std::exception_ptr, std::ptrdiff_t>;
+  using time_point = time_point_t<Exec>;
+
+  throttle_shared(Out out, Exec exec, Dur after)
+      : out_(std::move(out)), exec_(std::move(exec)), after_(after) {}
+
+  Out out_;
+  Exec exec_;
+  Dur after_;
+  // the lock is recursive because values can be delivered and requested
+  // from inside of the signals that are delivered under the lock.
+  std::recursive_mutex lock_;
+  ::pushmi::detail::opt<T> latest_;
+  ::pushmi::detail::opt<up_t> up_;
+  // debounce emits at deadline_, throttle_first drops values until deadline_
+  time_point deadline_{};
+  bool gated_ = false;
+  // identifies the current timer, so that a timer that was armed before
+  // completion is ignored.
+  std::size_t timer_ = 0;
+  bool armed_ = false;
+  bool done_ = false;
+
+  // the up receiver passed to the output
+  struct up_receiver {
+    using properties = property_set<is_receiver<>>;
+
+    // weak, the output owns this receiver and the state owns the output
+    std::weak_ptr<throttle_shared> s_;
+
+    void value(std::ptrdiff_t requested) {
+      if (auto s = s_.lock()) {
+        s->request(requested);
+      }
+    }
+    template <class E>
+    void error(E) noexcept {
+      done();
+    }
+    void done() {
+      if (auto s = s_.lock()) {
+        s->cancel();
+      }
+    }
+  };
+
+  void starting(up_t up) {
+    std::unique_lock<std::recursive_mutex> guard{lock_};
+    up_ = std::move(up);
+    set_starting(out_, up_receiver{this->shared_from_this()});
+  }
+
+  void request(std::ptrdiff_t requested) {
+    std::unique_lock<std::recursive_mutex> guard{lock_};
+    if (!done_ && !!up_) {
+      set_value(*up_, requested);
+    }
+  }
+
+  // the output cancelled, the pending value and timer are dropped and the
+  // signals that arrive after this are ignored.
+  void cancel() {
+    std::unique_lock<std::recursive_mutex> guard{lock_};
+    if (done_) {
+      return;
+    }
+    auto up = std::move(up_);
+    complete();
+    if (!!up) {
+      set_done(*up);
+    }
+  }
+
+  template <class V>
+  void value(V&& v) {
+    std::unique_lock<std::recursive_mutex> guard{lock_};
+    if (done_) {
+      return;
+    }
+    auto now = ::pushmi::now(exec_);
+    switch (Mode) {
+      case throttle_mode::debounce:
+        replace((V &&) v);
+        deadline_ = now + after_;
+        if (!armed_) {
+          arm(deadline_);
+        }
+        break;
+      case throttle_mode::first:
+        if (gated_ && now < deadline_) {
+          replenish();
+          break;
+        }
+        gated_ = true;
+        deadline_ = now + after_;
+        set_value(out_, (V &&) v);
+        break;
+      case throttle_mode::last:
+        replace((V &&) v);
+        if (!armed_) {
+          arm(now + after_);
+        }
+        break;
+    }
+  }
+  template <class E>
+  void error(E e) noexcept {
+    std::unique_lock<std::recursive_mutex> guard{lock_};
+    if (done_) {
+      return;
+    }
+    complete();
+    set_error(out_, std::move(e));
+  }
+  void done() {
+    std::unique_lock<std::recursive_mutex> guard{lock_};
+    if (done_) {
+      return;
+    }
+    // the latest value is not dropped when the input completes early
+    emit();
+    complete();
+    set_done(out_);
+  }
+  void expired(std::size_t timer) {
+    std::unique_lock<std::recursive_mutex> guard{lock_};
+    if (done_ || timer != timer_) {
+      return;
+    }
+    armed_ = false;
+    if (Mode == throttle_mode::debounce && ::pushmi::now(exec_) < deadline_) {
+      // a value arrived since the timer was armed
+      arm(deadline_);
+      return;
+    }
+    emit();
+  }
+  // the timer could not be scheduled, so nothing would be emitted again.
+  // the error is delivered and the input is cancelled.
+  template <class E>
+  void timer_error(std::size_t timer, E e) noexcept {
+    std::unique_lock<std::recursive_mutex> guard{lock_};
+    if (done_ || timer != timer_) {
+      return;
+    }
+    auto up = std::move(up_);
+    complete();
+    if (!!up) {
+      set_done(*up);
+    }
+    set_error(out_, std::move(e));
+  }
+
+ private:
+  struct expired_fn {
+    std::shared_ptr<throttle_shared> s_;
+    std::size_t timer_;
+    void operator()(any) {
+      s_->expired(timer_);
+    }
+  };
+  void arm(time_point at) {
+    armed_ = true;
+    ::pushmi::submit(
+        ::pushmi::schedule(exec_, at),
+        ::pushmi::make_receiver(
+            expired_fn{this->shared_from_this(), timer_},
+            [s = this->shared_from_this(), timer = timer_](auto e) noexcept {
+              s->timer_error(timer, std::move(e));
+            }));
+  }
+  template <class V>
+  void replace(V&& v) {
+    if (!!latest_) {
+      replenish();
+    }
+    latest_ = T{(V &&) v};
+  }
+  void replenish() {
+    if (!!up_) {
+      set_value(*up_, 1);
+    }
+  }
+  void emit() {
+    if (!latest_) {
+      return;
+    }
+    auto v = std::move(*latest_);
+    latest_ = ::pushmi::detail::opt<T>{};
+    set_value(out_, std::move(v));
+  }
+  void complete() {
+    done_ = true;
+    ++timer_;
+    armed_ = false;
+    latest_ = ::pushmi::detail::opt<T>{};
+    up_ = ::pushmi::detail::opt<up_t>{};
+  }
+};
+
+template <throttle_mode Mode, class T, class Out, class Exec, class Dur>
+struct throttle_data : flow_receiver<> {
+  using shared_t = throttle_shared<Mode, T, Out, Exec, Dur>;
+
+  throttle_data(Out out, Exec exec, Dur after)
+      : s_(std::make_shared<shared_t>(
+            std::move(out),
+            std::move(exec),
+            after)) {}
+
+  using properties = properties_t<Out>;
+  using flow_receiver<>::value;
+  using flow_receiver<>::error;
+  using flow_receiver<>::done;
+
+  template <class Up>
+  void starting(Up&& up) {
+    // up may own this receiver, copy the state out before moving it.
+    auto s = s_;
+    s->starting(typename shared_t::up_t{(Up &&) up});
+  }
+
+  std::shared_ptr<shared_t> s_;
+};
+
+template <throttle_mode Mode, class T>
+struct throttle_fn {
+ private:
+  struct on_value_impl {
+    template <class Data, class V>
+    void operator()(Data& data, V&& v) const {
+      data.s_->value((V &&) v);
+    }
+  };
+  struct on_error_impl {
+    template <class Data, class E>
+    void operator()(Data& data, E e) const noexcept {
+      data.s_->error(std::move(e));
+    }
+  };
+  struct on_done_impl {
+    template <class Data>
+    void operator()(Data& data) const {
+      data.s_->done();
+    }
+  };
+  template <class In, class Exec, class Dur>
+  struct submit_impl {
+    Exec exec_;
+    Dur after_;
+    PUSHMI_TEMPLATE(class SIn, class Out)
+    (requires Receiver<Out>) //
+        void
+        operator()(SIn&& in, Out out) const {
+      ::pushmi::submit(
+          (In &&) in,
+          ::pushmi::detail::receiver_from_fn<In>()(
+              throttle_data<Mode, T, Out, Exec, Dur>{
+                  std::move(out), exec_, after_},
+              on_value_impl{},
+              on_error_impl{},
+              on_done_impl{}));
+    }
+  };
+  template <class Exec, class Dur>
+  struct adapt_impl {
+    Exec exec_;
+    Dur after_;
+    PUSHMI_TEMPLATE(class In)
+    (requires Sender<In, is_many<>>) //
+        auto
+        operator()(In in) const {
+      return ::pushmi::detail::sender_from(
+          std::move(in), submit_impl<In, Exec, Dur>{exec_, after_});
+    }
+  };
+
+ public:
+  PUSHMI_TEMPLATE(class Dur, class Exec)
+  (requires TimeExecutor<Exec>) //
+      auto
+      operator()(Dur after, Exec exec) const {
+    return adapt_impl<Exec, Dur>{std::move(exec), std::move(after)};
+  }
+};
+
+} // namespace detail
+
+namespace operators {
+
+// debounce<T>(d, exec) delivers a value once no other value has arrived
+// for d.
+template <class T>
+PUSHMI_INLINE_VAR constexpr detail::
+    throttle_fn<detail::throttle_mode::debounce, T>
+        debounce{};
+
+// throttle_first<T>(d, exec) delivers a value and then drops values until
+// d has passed.
+template <class T>
+PUSHMI_INLINE_VAR constexpr detail::throttle_fn<detail::throttle_mode::first, T>
+    throttle_first{};
+
+// throttle_last<T>(d, exec) delivers the latest value d after the first
+// value that arrived since the last delivery.
+template <class T>
+PUSHMI_INLINE_VAR constexpr detail::throttle_fn<detail::throttle_mode::last, T>
+    throttle_last{};
+
+// sample<T>(d, exec) is throttle_last<T>(d, exec).
+template <class T>
+PUSHMI_INLINE_VAR constexpr detail::throttle_fn<detail::throttle_mode::last, T>
+    sample{};
+
+} // namespace operators
+
+} // namespace pushmi
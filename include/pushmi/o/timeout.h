@@ -0,0 +1,349 @@
+/*
+ * Copyright 2018-present Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <stdexcept>
+#include <type_traits>
+
+#include <pushmi/executor.h>
+#include <pushmi/flow_receiver.h>
+#include <pushmi/o/extension_operators.h>
+#include <pushmi/o/submit.h>
+#include <pushmi/receiver.h>
+
+namespace pushmi {
+
+// the error delivered by timeout when the timer expires first
+struct timeout_error : std::runtime_error {
+  timeout_error() : std::runtime_error("pushmi::timeout expired") {}
+};
+
+namespace detail {
+
+// the timer of an executor whose connected timers can be cancelled
+struct timeout_timer {
+  virtual ~timeout_timer() {}
+  virtual void cancel() = 0;
+};
+
+template <class Op>
+struct timeout_connected_timer : timeout_timer {
+  explicit timeout_connected_timer(Op op) : op_(std::move(op)) {}
+  void cancel() override {
+    op_.cancel();
+  }
+  Op op_;
+};
+
+template <class Sender, class Out, class = void>
+struct has_cancellable_connect : std::false_type {};
+template <class Sender, class Out>
+struct has_cancellable_connect<
+    Sender,
+    Out,
+    void_t<decltype(::pushmi::connect(std::declval<Sender>(), std::declval<Out>())
+                        .cancel())>> : std::true_type {};
+
+//
+// timeout_shared races the input against a timer. the first signal claims
+// owner_ with one compare-exchange, no lock is taken on either path.
+//
+// the timer keeps the state alive, so that an input that drops its
+// receiver still times out. the winner moves the output out of the state to
+// deliver the last signal.
+//
+// when the executor supports it, the timer is connected and held in timer_,
+// and the input cancels it when the input wins, or when the output cancels.
+// timer_state_ makes sure that the timer is cancelled once, after it has
+// been started. other timers stay pending until they expire and only hold
+// the state and a moved-from output until then.
+//
+// the up receiver of a flow input is guarded by up_state_. starting()
+// publishes it and the one call that moves up_state_ to cancelled, from the
+// timer, the output, or the completion of the input, is the only one that
+// touches it afterwards.
+//
+template <class Out>
+struct timeout_shared {
+  using up_t = any_receiver<std::exception_ptr, std::ptrdiff_t>;
+
+  enum owner : int { none, input, timer, output };
+  enum up_state : int { empty, stored, cancelled };
+  enum timer_state : int { unarmed, armed, disarmed };
+
+  explicit timeout_shared(Out out) : out_(std::move(out)) {}
+
+  Out out_;
+  std::atomic<int> owner_{none};
+  std::atomic<int> up_state_{empty};
+  ::pushmi::detail::opt<up_t> up_;
+  std::unique_ptr<timeout_timer> timer_;
+  std::atomic<int> timer_state_{unarmed};
+
+  bool claim(int by) {
+    int expected = none;
+    return owner_.compare_exchange_strong(expected, by) || expected == by;
+  }
+
+  template <class... VN>
+  void value(VN&&... vn) {
+    if (claim(input)) {
+      disarm();
+      set_value(out_, (VN &&) vn...);
+    }
+  }
+  template <class E>
+  void error(E e) noexcept {
+    if (claim(input)) {
+      disarm();
+      release_up(false);
+      auto out = std::move(out_);
+      set_error(out, std::move(e));
+    }
+  }
+  void done() {
+    if (claim(input)) {
+      disarm();
+      release_up(false);
+      auto out = std::move(out_);
+      set_done(out);
+    }
+  }
+  void expired() {
+    if (claim(timer)) {
+      release_up(true);
+      auto out = std::move(out_);
+      set_error(out, std::make_exception_ptr(timeout_error{}));
+    }
+  }
+  // the output cancelled, it is not signalled after this
+  void cancel() {
+    if (claim(output)) {
+      disarm();
+    }
+    release_up(true);
+  }
+  // called once timer_ has been started
+  void started() {
+    int expected = unarmed;
+    if (!timer_state_.compare_exchange_strong(expected, armed)) {
+      // disarmed before it was started
+      timer_->cancel();
+    }
+  }
+  void disarm() {
+    if (timer_state_.exchange(disarmed) == armed) {
+      timer_->cancel();
+    }
+  }
+  void starting(up_t up) {
+    up_ = std::move(up);
+    int expected = empty;
+    if (!up_state_.compare_exchange_strong(expected, stored)) {
+      // the timer expired before the input started
+      release(true);
+    }
+  }
+  // moves up_state_ to cancelled and cancels the input when asked to.
+  void release_up(bool cancel) {
+    if (up_state_.exchange(cancelled) == stored) {
+      release(cancel);
+    }
+  }
+
+ private:
+  void release(bool cancel) {
+    auto up = std::move(*up_);
+    up_ = ::pushmi::detail::opt<up_t>{};
+    if (cancel) {
+      set_done(up);
+    }
+  }
+};
+
+// the up receiver passed to the output, it only supports cancellation.
+template <class Out>
+struct timeout_up {
+  using properties = property_set<is_receiver<>>;
+
+  // weak, the output owns this receiver and the state owns the output
+  std::weak_ptr<timeout_shared<Out>> s_;
+
+  void value(std::ptrdiff_t) {}
+  template <class E>
+  void error(E) noexcept {
+    done();
+  }
+  void done() {
+    if (auto s = s_.lock()) {
+      s->cancel();
+    }
+  }
+};
+
+// the receiver of a connected timer. it is held by the timer in the state,
+// so it releases the state once the timer has been signalled.
+template <class Out>
+struct timeout_timer_receiver {
+  using properties = property_set<is_receiver<>>;
+
+  std::shared_ptr<timeout_shared<Out>> s_;
+
+  void value(any) {
+    s_->expired();
+  }
+  template <class E>
+  void error(E) noexcept {
+    done();
+  }
+  void done() {
+    // may destroy the state, and this receiver with it
+    auto s = std::move(s_);
+  }
+};
+
+template <class Out>
+struct timeout_data : flow_receiver<> {
+  using shared_t = timeout_shared<Out>;
+
+  explicit timeout_data(std::shared_ptr<shared_t> s) : s_(std::move(s)) {}
+
+  using properties = properties_t<Out>;
+  using flow_receiver<>::value;
+  using flow_receiver<>::error;
+  using flow_receiver<>::done;
+
+  template <class Up>
+  void starting(Up&& up) {
+    // up may own this receiver, copy the state out before moving it.
+    auto s = s_;
+    set_starting(s->out_, timeout_up<Out>{s});
+    s->starting(typename shared_t::up_t{(Up &&) up});
+  }
+
+  std::shared_ptr<shared_t> s_;
+};
+
+struct timeout_fn {
+ private:
+  struct on_value_impl {
+    template <class Data, class... VN>
+    void operator()(Data& data, VN&&... vn) const {
+      data.s_->value((VN &&) vn...);
+    }
+  };
+  struct on_error_impl {
+    template <class Data, class E>
+    void operator()(Data& data, E e) const noexcept {
+      data.s_->error(std::move(e));
+    }
+  };
+  struct on_done_impl {
+    template <class Data>
+    void operator()(Data& data) const {
+      data.s_->done();
+    }
+  };
+  template <class Out>
+  struct expired_fn {
+    std::shared_ptr<timeout_shared<Out>> s_;
+    void operator()(any) {
+      s_->expired();
+    }
+  };
+  template <class In, class Exec, class Dur>
+  struct submit_impl {
+    Exec exec_;
+    Dur after_;
+    PUSHMI_TEMPLATE(class SIn, class Out)
+    (requires ReceiveError<Out, std::exception_ptr>) //
+        void
+        operator()(SIn&& in, Out out) const {
+      auto s = std::make_shared<timeout_shared<Out>>(std::move(out));
+      auto exec = exec_;
+      // the deadline is measured from the submit, not from the end of an
+      // input that runs inline.
+      auto at = ::pushmi::now(exec) + after_;
+      ::pushmi::submit(
+          (In &&) in,
+          ::pushmi::detail::receiver_from_fn<In>()(
+              timeout_data<Out>{s},
+              on_value_impl{},
+              on_error_impl{},
+              on_done_impl{}));
+      if (s->owner_.load() != timeout_shared<Out>::none) {
+        // completed inline, no timer is needed.
+        return;
+      }
+      using timer_t = decltype(::pushmi::schedule(exec, at));
+      arm(::pushmi::schedule(exec, at),
+          std::move(s),
+          has_cancellable_connect<timer_t, timeout_timer_receiver<Out>>{});
+    }
+
+   private:
+    template <class Timer, class Out>
+    static void
+    arm(Timer timer, std::shared_ptr<timeout_shared<Out>> s, std::true_type) {
+      using op_t = decltype(::pushmi::connect(
+          std::move(timer), timeout_timer_receiver<Out>{s}));
+      auto connected = std::make_unique<timeout_connected_timer<op_t>>(
+          ::pushmi::connect(std::move(timer), timeout_timer_receiver<Out>{s}));
+      auto& op = connected->op_;
+      s->timer_ = std::move(connected);
+      ::pushmi::start(op);
+      s->started();
+    }
+    template <class Timer, class Out>
+    static void
+    arm(Timer timer, std::shared_ptr<timeout_shared<Out>> s, std::false_type) {
+      ::pushmi::submit(
+          std::move(timer),
+          ::pushmi::make_receiver(
+              expired_fn<Out>{std::move(s)}, [](auto) noexcept {}));
+    }
+  };
+  template <class Exec, class Dur>
+  struct adapt_impl {
+    Exec exec_;
+    Dur after_;
+    PUSHMI_TEMPLATE(class In)
+    (requires Sender<In, is_single<>>) //
+        auto
+        operator()(In in) const {
+      return ::pushmi::detail::sender_from(
+          std::move(in), submit_impl<In, Exec, Dur>{exec_, after_});
+    }
+  };
+
+ public:
+  PUSHMI_TEMPLATE(class Dur, class Exec)
+  (requires TimeExecutor<Exec>) //
+      auto
+      operator()(Dur after, Exec exec) const {
+    return adapt_impl<Exec, Dur>{std::move(exec), std::move(after)};
+  }
+};
+
+} // namespace detail
+
+namespace operators {
+PUSHMI_INLINE_VAR constexpr detail::timeout_fn timeout{};
+} // namespace operators
+
+} // namespace pushmi
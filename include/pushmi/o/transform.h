@@ -135,10 +135,12 @@ struct transform_fn {
       // copy 'f_' to allow multiple calls to connect to multiple 'in'
       ::pushmi::submit(
           (In &&) in,
-          transform_on<
-              F,
-              Cardinality,
-              property_query_v<properties_t<In>, is_flow<>>>{f_}((Out &&) out));
+          ::pushmi::detail::trace_receiver(
+              transform_on<
+                  F,
+                  Cardinality,
+                  property_query_v<properties_t<In>, is_flow<>>>{f_}(
+                  (Out &&) out)));
     }
   };
 
@@ -32,12 +32,15 @@ struct via_fn_base {
     return *this;
   }
 };
-template <class Exec, class Out>
+// OutPtr is a shared_ptr to the receiver when the input is submitted and a
+// pointer into the operation state when it is connected.
+template <class Exec, class OutPtr>
 struct via_fn_data : flow_receiver<>, via_fn_base<Exec> {
-  via_fn_data(Out out, Exec exec)
-      : via_fn_base<Exec>(std::move(exec)), out_(std::make_shared<Out>(std::move(out))) {}
+  via_fn_data(OutPtr out, Exec exec)
+      : via_fn_base<Exec>(std::move(exec)), out_(std::move(out)) {}
 
-  using properties = properties_t<Out>;
+  using properties =
+      properties_t<std::decay_t<decltype(*std::declval<OutPtr&>())>>;
   using flow_receiver<>::value;
   using flow_receiver<>::error;
   using flow_receiver<>::done;
@@ -45,7 +48,7 @@ struct via_fn_data : flow_receiver<>, via_fn_base<Exec> {
   template <class Up>
   struct impl {
     Up up_;
-    std::shared_ptr<Out> out_;
+    OutPtr out_;
     void operator()(any) {
       set_starting(out_, std::move(up_));
     }
@@ -60,22 +63,23 @@ struct via_fn_data : flow_receiver<>, via_fn_base<Exec> {
         ::pushmi::make_receiver(impl<std::decay_t<Up>>{
             (Up &&) up, out_}));
   }
-  std::shared_ptr<Out> out_;
+  OutPtr out_;
 };
 
 template <class Out, class Exec>
-auto make_via_fn_data(Out out, Exec ex) -> via_fn_data<Exec, Out> {
-  return {std::move(out), std::move(ex)};
+auto make_via_fn_data(Out out, Exec ex)
+    -> via_fn_data<Exec, std::shared_ptr<Out>> {
+  auto alloc = ::pushmi::get_allocator(out);
+  return {std::allocate_shared<Out>(alloc, std::move(out)), std::move(ex)};
 }
 
 struct via_fn {
  private:
-  template <class Out>
   struct on_value_impl {
-    template <class V>
+    template <class V, class OutPtr>
     struct impl {
       V v_;
-      std::shared_ptr<Out> out_;
+      OutPtr out_;
       void operator()(any) {
         set_value(out_, std::move(v_));
       }
@@ -87,16 +91,16 @@ struct via_fn {
       }
       submit(
         ::pushmi::schedule(data.via_fn_base_ref().exec_),
-          ::pushmi::make_receiver(impl<std::decay_t<V>>{
-              (V &&) v, data.out_}));
+          ::pushmi::make_receiver(
+              impl<std::decay_t<V>, decltype(data.out_)>{(V &&) v,
+                                                         data.out_}));
     }
   };
-  template <class Out>
   struct on_error_impl {
-    template <class E>
+    template <class E, class OutPtr>
     struct impl {
       E e_;
-      std::shared_ptr<Out> out_;
+      OutPtr out_;
       void operator()(any) noexcept {
         set_error(out_, std::move(e_));
       }
@@ -110,13 +114,14 @@ struct via_fn {
       submit(
         ::pushmi::schedule(data.via_fn_base_ref().exec_),
           ::pushmi::make_receiver(
-              impl<E>{std::move(e), std::move(data.out_)}));
+              impl<E, decltype(data.out_)>{std::move(e),
+                                           std::move(data.out_)}));
     }
   };
-  template <class Out>
   struct on_done_impl {
+    template <class OutPtr>
     struct impl {
-      std::shared_ptr<Out> out_;
+      OutPtr out_;
       void operator()(any) {
         set_done(out_);
       }
@@ -130,7 +135,25 @@ struct via_fn {
       submit(
           ::pushmi::schedule(data.via_fn_base_ref().exec_),
           ::pushmi::make_receiver(
-              impl{std::move(data.out_)}));
+              impl<decltype(data.out_)>{std::move(data.out_)}));
+    }
+  };
+  // the operation state of a connected via holds the receiver, so that
+  // the signals that are scheduled on the executor refer to it with a
+  // pointer instead of sharing a heap allocation.
+  template <class In, class Exec, class Out>
+  struct operation {
+    In in_;
+    Exec exec_;
+    Out out_;
+    void start() {
+      ::pushmi::submit(
+          std::move(in_),
+          ::pushmi::detail::receiver_from_fn<In>()(
+              via_fn_data<Exec, Out*>{std::addressof(out_), std::move(exec_)},
+              on_value_impl{},
+              on_error_impl{},
+              on_done_impl{}));
     }
   };
   template <class In, class Factory>
@@ -145,9 +168,17 @@ struct via_fn {
           (In &&) in,
           ::pushmi::detail::receiver_from_fn<std::decay_t<In>>()(
               make_via_fn_data(std::move(out), std::move(exec)),
-              on_value_impl<Out>{},
-              on_error_impl<Out>{},
-              on_done_impl<Out>{}));
+              on_value_impl{},
+              on_error_impl{},
+              on_done_impl{}));
+    }
+    PUSHMI_TEMPLATE(class SIn, class Out)
+    (requires Receiver<Out>) //
+        auto
+        connect(SIn&& in, Out out) const {
+      auto exec = ::pushmi::make_strand(ef_);
+      return operation<std::decay_t<In>, decltype(exec), Out>{
+          (SIn &&) in, std::move(exec), std::move(out)};
     }
   };
   template <class Factory>
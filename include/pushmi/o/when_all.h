@@ -0,0 +1,296 @@
+/*
+ * Copyright 2018-present Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <tuple>
+#include <utility>
+
+#include <pushmi/o/extension_operators.h>
+#include <pushmi/o/submit.h>
+#include <pushmi/receiver.h>
+#include <pushmi/single_sender.h>
+
+namespace pushmi {
+
+namespace detail {
+
+// the up receiver of one flow branch. starting() publishes it and the one
+// call that moves state_ to released, either to cancel it or because the
+// branch completed, is the only one that touches it afterwards.
+struct when_up {
+  using up_t = any_receiver<std::exception_ptr, std::ptrdiff_t>;
+  enum state : int { empty, stored, released };
+
+  ::pushmi::detail::opt<up_t> up_;
+  std::atomic<int> state_{empty};
+
+  void starting(up_t up) {
+    up_ = std::move(up);
+    int expected = empty;
+    if (!state_.compare_exchange_strong(expected, stored)) {
+      // cancelled before the branch started
+      release(true);
+    }
+  }
+  void release_up(bool cancel) {
+    if (state_.exchange(released) == stored) {
+      release(cancel);
+    }
+  }
+
+ private:
+  void release(bool cancel) {
+    auto up = std::move(*up_);
+    up_ = ::pushmi::detail::opt<up_t>{};
+    if (cancel) {
+      set_done(up);
+    }
+  }
+};
+
+// the receiver of branch I of a combinator. State is allocated once for all
+// the branches and deletes itself when the last branch completes, so the
+// branches hold a plain pointer.
+template <class State, std::size_t I, bool IsFlow>
+struct when_receiver {
+  using properties = std::conditional_t<
+      IsFlow,
+      property_set<is_receiver<>, is_flow<>>,
+      property_set<is_receiver<>>>;
+
+  State* s_;
+
+  template <class... VN>
+  void value(VN&&... vn) {
+    s_->template value<I>((VN &&) vn...);
+  }
+  template <class E>
+  void error(E e) noexcept {
+    s_->ups_[I].release_up(false);
+    s_->error(as_exception_ptr(std::move(e)));
+    s_->arrive();
+  }
+  void done() {
+    s_->ups_[I].release_up(false);
+    s_->arrive();
+  }
+  PUSHMI_TEMPLATE(class Up)
+  (requires Receiver<Up>)
+  void starting(Up&& up) {
+    s_->ups_[I].starting(typename when_up::up_t{(Up &&) up});
+  }
+};
+
+template <class State, class... SN>
+struct when_submit {
+  State* s_;
+  void operator()(SN&... sn) const {
+    submit_all(std::index_sequence_for<SN...>{}, sn...);
+  }
+  template <std::size_t... Is>
+  void submit_all(std::index_sequence<Is...>, SN&... sn) const {
+    // the state can be deleted as soon as the last branch is submitted
+    (void)std::initializer_list<int>{
+        (::pushmi::submit(
+             sn,
+             when_receiver<
+                 State,
+                 Is,
+                 property_query_v<properties_t<SN>, is_flow<>>>{s_}),
+         0)...};
+  }
+};
+
+//
+// when_all_state counts down the branches that have not completed with one
+// atomic. the first error claims the output, cancels the flow branches and
+// is delivered at once. otherwise the last branch to complete delivers the
+// values of all the branches as one std::tuple, or done when a branch
+// completed without a value.
+//
+template <class Out, class... TN>
+struct when_all_state {
+  explicit when_all_state(Out out) : out_(std::move(out)) {}
+
+  Out out_;
+  std::tuple<::pushmi::detail::opt<TN>...> values_;
+  std::array<when_up, sizeof...(TN)> ups_;
+  std::atomic<std::size_t> count_{sizeof...(TN)};
+  std::atomic<bool> claimed_{false};
+
+  template <std::size_t I, class V>
+  void value(V&& v) {
+    std::get<I>(values_) =
+        std::tuple_element_t<I, std::tuple<TN...>>{(V &&) v};
+  }
+  void error(std::exception_ptr e) {
+    if (!claimed_.exchange(true)) {
+      for (auto& up : ups_) {
+        up.release_up(true);
+      }
+      set_error(out_, std::move(e));
+    }
+  }
+  void arrive() {
+    if (count_.fetch_sub(1) != 1) {
+      return;
+    }
+    if (!claimed_.exchange(true)) {
+      finish(std::index_sequence_for<TN...>{});
+    }
+    delete this;
+  }
+
+ private:
+  template <std::size_t... Is>
+  void finish(std::index_sequence<Is...>) {
+    bool all = true;
+    (void)std::initializer_list<int>{
+        (all = all && !!std::get<Is>(values_), 0)...};
+    if (all) {
+      set_value(out_, std::tuple<TN...>{std::move(*std::get<Is>(values_))...});
+    }
+    set_done(out_);
+  }
+};
+
+//
+// when_any_state delivers the first value and cancels the other flow
+// branches that are still running. when every branch completes without a value the
+// first error, or done, is delivered by the last branch.
+//
+template <class Out, std::size_t N>
+struct when_any_state {
+  explicit when_any_state(Out out) : out_(std::move(out)) {}
+
+  Out out_;
+  std::array<when_up, N> ups_;
+  std::atomic<std::size_t> count_{N};
+  std::atomic<bool> claimed_{false};
+  std::atomic<bool> errored_{false};
+  std::exception_ptr error_;
+
+  template <std::size_t I, class... VN>
+  void value(VN&&... vn) {
+    if (!claimed_.exchange(true)) {
+      // the winner completes by itself, cancelling it would signal its up
+      // receiver while it is still delivering the value
+      for (std::size_t i = 0; i < N; ++i) {
+        if (i != I) {
+          ups_[i].release_up(true);
+        }
+      }
+      set_value(out_, (VN &&) vn...);
+      set_done(out_);
+    }
+  }
+  void error(std::exception_ptr e) {
+    if (!errored_.exchange(true)) {
+      error_ = std::move(e);
+    }
+  }
+  void arrive() {
+    if (count_.fetch_sub(1) != 1) {
+      return;
+    }
+    if (!claimed_.exchange(true)) {
+      if (errored_.load()) {
+        set_error(out_, std::move(error_));
+      } else {
+        set_done(out_);
+      }
+    }
+    delete this;
+  }
+};
+
+template <class... TN>
+struct when_all_fn {
+ private:
+  template <class... SN>
+  struct out_impl {
+    std::tuple<SN...> sn_;
+    PUSHMI_TEMPLATE(class Out)
+    (requires ReceiveError<Out, std::exception_ptr>&&
+         ReceiveValue<Out, std::tuple<TN...>>) //
+        void
+        operator()(Out out) {
+      using State = when_all_state<Out, TN...>;
+      // one allocation for all the branches, deleted by the last one
+      auto s = new State{std::move(out)};
+      ::pushmi::apply(when_submit<State, SN...>{s}, sn_);
+    }
+  };
+
+ public:
+  PUSHMI_TEMPLATE(class... SN)
+  (requires sizeof...(SN) == sizeof...(TN) &&
+       And<Sender<SN, is_single<>>...>) //
+      auto
+      operator()(SN... sn) const {
+    return make_single_sender(
+        out_impl<SN...>{std::tuple<SN...>{std::move(sn)...}});
+  }
+};
+
+struct when_any_fn {
+ private:
+  template <class... SN>
+  struct out_impl {
+    std::tuple<SN...> sn_;
+    PUSHMI_TEMPLATE(class Out)
+    (requires ReceiveError<Out, std::exception_ptr>) //
+        void
+        operator()(Out out) {
+      using State = when_any_state<Out, sizeof...(SN)>;
+      auto s = new State{std::move(out)};
+      ::pushmi::apply(when_submit<State, SN...>{s}, sn_);
+    }
+  };
+
+ public:
+  PUSHMI_TEMPLATE(class... SN)
+  (requires sizeof...(SN) != 0 && And<Sender<SN, is_single<>>...>) //
+      auto
+      operator()(SN... sn) const {
+    return make_single_sender(
+        out_impl<SN...>{std::tuple<SN...>{std::move(sn)...}});
+  }
+};
+
+} // namespace detail
+
+namespace operators {
+
+// when_all<TN...>(sn...) delivers a std::tuple<TN...> of the values of all
+// the single senders, TN being the value type of each sender, once they have
+// all completed. the state lives until every branch has signalled value, error
+// or done, so a branch that never completes (or a flow branch that ignores
+// cancellation) holds the state forever and when_all never completes.
+template <class... TN>
+PUSHMI_INLINE_VAR constexpr detail::when_all_fn<TN...> when_all{};
+
+// when_any(sn...) delivers the first value from any of the single senders
+// and cancels the flow senders that have not completed. the state lives
+// until every branch has completed, so a branch that never completes holds
+// it forever, although the first value has already been delivered.
+PUSHMI_INLINE_VAR constexpr detail::when_any_fn when_any{};
+
+} // namespace operators
+
+} // namespace pushmi
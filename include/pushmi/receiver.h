@@ -271,6 +271,14 @@ class receiver<Data, DVF, DEF, DDF> {
     return data_;
   }
 
+  // the allocator of the data, for the state allocated on its behalf
+  PUSHMI_TEMPLATE(class D = Data)
+  (requires //
+   requires(std::declval<D&>().get_allocator())) //
+  auto get_allocator() {
+    return data_.get_allocator();
+  }
+
   PUSHMI_TEMPLATE(class... VN)
   (requires Invocable<DVF&, Data&, VN...>) //
   void value(VN&&... vn) {
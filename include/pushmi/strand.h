@@ -15,6 +15,8 @@
  */
 #pragma once
 
+#include <pushmi/detail/lock_stats.h>
+#include <pushmi/detail/queue_stats.h>
 #include <pushmi/executor.h>
 #include <pushmi/single_sender.h>
 
@@ -22,6 +24,10 @@
 
 namespace pushmi {
 
+namespace detail {
+using strand_mutex = stats_mutex<strand_lock_tag>;
+} // namespace detail
+
 template <class E, class Exec>
 class strand_executor;
 
@@ -65,9 +71,11 @@ template <class E>
 class strand_queue_base
     : public std::enable_shared_from_this<strand_queue_base<E>> {
  public:
-  std::mutex lock_;
+  detail::strand_mutex lock_;
   size_t remaining_ = 0;
   std::queue<strand_item<E>> items_;
+  // shared by the strands of a factory
+  std::shared_ptr<strand_stats> stats_;
 
   virtual ~strand_queue_base() {}
 
@@ -83,7 +91,10 @@ template <class E, class Exec>
 class strand_queue : public strand_queue_base<E> {
  public:
   ~strand_queue() {}
-  strand_queue(Exec ex) : ex_(std::move(ex)) {}
+  strand_queue(Exec ex, std::shared_ptr<strand_stats> stats)
+      : ex_(std::move(ex)) {
+    this->stats_ = std::move(stats);
+  }
   Exec ex_;
 
   void dispatch() override;
@@ -98,7 +109,7 @@ class strand_queue : public strand_queue_base<E> {
     //
     // pull ready items from the queue in order.
 
-    std::unique_lock<std::mutex> guard{this->lock_};
+    std::unique_lock<detail::strand_mutex> guard{this->lock_};
 
     // only allow one at a time
     if (this->remaining_ > 0) {
@@ -115,31 +126,36 @@ class strand_queue : public strand_queue_base<E> {
     auto that = shared_from_that();
     auto subEx = strand_executor<E, Exec>{that};
 
+    std::uint64_t drained = 0;
     while (!this->items_.empty() && --this->remaining_ >= 0) {
       auto item{std::move(this->front())};
       this->items_.pop();
+      this->stats_->dequeue();
+      ++drained;
       guard.unlock();
       set_value(item.what, any_executor_ref<E>{subEx});
       set_done(item.what);
       guard.lock();
     }
+    this->stats_->batch(drained);
   }
   template <class AE>
   void error(AE e) noexcept {
-    std::unique_lock<std::mutex> guard{this->lock_};
+    std::unique_lock<detail::strand_mutex> guard{this->lock_};
 
     this->remaining_ = 0;
 
     while (!this->items_.empty()) {
       auto what{std::move(this->front().what)};
       this->items_.pop();
+      this->stats_->dequeue();
       guard.unlock();
       set_error(what, detail::as_const(e));
       guard.lock();
     }
   }
   void done() {
-    std::unique_lock<std::mutex> guard{this->lock_};
+    std::unique_lock<detail::strand_mutex> guard{this->lock_};
 
     // only allow one at a time
     if (this->remaining_ > 0) {
@@ -193,8 +209,9 @@ class strand_task {
   (requires ReceiveValue<Out&, any_executor_ref<E>>&& ReceiveError<Out, E>) //
       void submit(Out out) {
     // queue for later
-    std::unique_lock<std::mutex> guard{queue_->lock_};
+    std::unique_lock<detail::strand_mutex> guard{queue_->lock_};
     queue_->items_.push(any_receiver<E, any_executor_ref<E>>{std::move(out)});
+    queue_->stats_->enqueue(queue_->items_.size());
     if (queue_->remaining_ == 0) {
       // noone is minding the shop, send a worker
       guard.unlock();
@@ -221,31 +238,51 @@ class strand_executor {
 
 //
 // the strand executor factory produces a new fifo ordered queue each time that
-// it is called.
+// it is called. the queues are allocated with Alloc. the strands made by a
+// factory and its copies share one strand_stats, also allocated with Alloc.
 //
 
-template <class E, class Exec>
+template <class E, class Exec, class Alloc = std::allocator<char>>
 class same_strand_factory_fn {
   Exec ex_;
+  Alloc alloc_;
+  std::shared_ptr<strand_stats> stats_;
 
  public:
-  explicit same_strand_factory_fn(Exec ex) : ex_(std::move(ex)) {}
+  explicit same_strand_factory_fn(Exec ex, Alloc alloc = Alloc{})
+      : ex_(std::move(ex)),
+        alloc_(std::move(alloc)),
+        stats_(std::allocate_shared<strand_stats>(alloc_)) {}
   auto make_strand() const {
-    auto queue = std::make_shared<strand_queue<E, Exec>>(ex_);
+    auto queue =
+        std::allocate_shared<strand_queue<E, Exec>>(alloc_, ex_, stats_);
     return strand_executor<E, Exec>{queue};
   }
+
+  // the counts for all the strands made by this factory and its copies
+  strand_stats& stats() const {
+    return *stats_;
+  }
 };
 
-PUSHMI_TEMPLATE(class E = std::exception_ptr, class Provider)
+PUSHMI_TEMPLATE(
+    class E = std::exception_ptr,
+    class Provider,
+    class Alloc = std::allocator<char>)
 (requires ExecutorProvider<Provider>&&
          ConcurrentSequence<executor_t<Provider>>) //
-    auto strands(Provider ep) {
-  return same_strand_factory_fn<E, executor_t<Provider>>{get_executor(ep)};
+    auto strands(Provider ep, Alloc alloc = Alloc{}) {
+  return same_strand_factory_fn<E, executor_t<Provider>, Alloc>{
+      get_executor(ep), std::move(alloc)};
 }
-PUSHMI_TEMPLATE(class E = std::exception_ptr, class Exec)
+PUSHMI_TEMPLATE(
+    class E = std::exception_ptr,
+    class Exec,
+    class Alloc = std::allocator<char>)
 (requires Executor<Exec>&& ConcurrentSequence<Exec>) //
-    auto strands(Exec ex) {
-  return same_strand_factory_fn<E, Exec>{std::move(ex)};
+    auto strands(Exec ex, Alloc alloc = Alloc{}) {
+  return same_strand_factory_fn<E, Exec, Alloc>{std::move(ex),
+                                                std::move(alloc)};
 }
 
 } // namespace pushmi
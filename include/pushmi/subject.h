@@ -15,6 +15,7 @@
  */
 #pragma once
 
+#include <memory>
 #include <vector>
 
 #include <pushmi/concepts.h>
@@ -113,7 +114,13 @@ struct subject<PS, TN...> {
     }
   };
 
-  std::shared_ptr<subject_shared> s = std::make_shared<subject_shared>();
+  std::shared_ptr<subject_shared> s;
+
+  subject() : s(std::make_shared<subject_shared>()) {}
+  // the shared state is allocated with alloc
+  template <class Alloc>
+  subject(std::allocator_arg_t, const Alloc& alloc)
+      : s(std::allocate_shared<subject_shared>(alloc)) {}
 
   PUSHMI_TEMPLATE(class Out)
   (requires Receiver<Out>)
@@ -15,7 +15,9 @@
  */
 #pragma once
 
+#include <pushmi/detail/lock_stats.h>
 #include <pushmi/detail/opt.h>
+#include <pushmi/detail/queue_stats.h>
 #include <pushmi/executor.h>
 
 #include <algorithm>
@@ -27,24 +29,56 @@
 
 namespace pushmi {
 
+namespace detail {
+using time_source_mutex = stats_mutex<time_source_lock_tag>;
+} // namespace detail
+
 template <class E, class TP>
 class time_source_shared;
 
 template <class E, class TP, class NF, class Exec>
 class time_source_executor;
 
+//
+// the heap of each queue holds pointers to intrusive timer nodes. the node
+// of a connected operation is the operation state itself, so scheduling it
+// does not allocate. the node of a submitted receiver is allocated once,
+// with the allocator of the receiver, holds the receiver without erasing its
+// type and deletes itself after it has been signalled.
+//
+
+template <class E, class TP>
+class time_heap_node {
+ public:
+  using executor_ref = any_time_executor_ref<E, TP>;
+  using value_fn = void(time_heap_node*, executor_ref);
+  using error_fn = void(time_heap_node*, E);
+
+  time_heap_node(value_fn* v, error_fn* e) : value_(v), error_(e) {}
+
+  // delivers the executor and then done
+  void value(executor_ref ex) {
+    value_(this, std::move(ex));
+  }
+  void error(E e) {
+    error_(this, std::move(e));
+  }
+
+ private:
+  value_fn* value_;
+  error_fn* error_;
+};
+
 template <class E, class TP>
 class time_heap_item {
  public:
   using time_point = std::decay_t<TP>;
 
-  time_heap_item(
-      time_point at,
-      any_receiver<E, any_time_executor_ref<E, TP>> out)
-      : when(std::move(at)), what(std::move(out)) {}
+  time_heap_item(time_point at, time_heap_node<E, TP>* node)
+      : when(std::move(at)), what(node) {}
 
   time_point when;
-  any_receiver<E, any_time_executor_ref<E, TP>> what;
+  time_heap_node<E, TP>* what;
 };
 template <class E, class TP>
 bool operator<(const time_heap_item<E, TP>& l, const time_heap_item<E, TP>& r) {
@@ -79,6 +113,28 @@ bool operator>=(
   return !(l < r);
 }
 
+// a priority_queue that can also remove an item that has not been taken
+template <class E, class TP>
+class time_heap : public std::priority_queue<
+                      time_heap_item<E, TP>,
+                      std::vector<time_heap_item<E, TP>>,
+                      std::greater<>> {
+ public:
+  // linear in the size of the heap
+  bool remove(const time_heap_node<E, TP>* node) {
+    auto found = std::find_if(
+        this->c.begin(), this->c.end(), [node](const auto& item) {
+          return item.what == node;
+        });
+    if (found == this->c.end()) {
+      return false;
+    }
+    this->c.erase(found);
+    std::make_heap(this->c.begin(), this->c.end(), this->comp);
+    return true;
+  }
+};
+
 template <class E, class TP>
 class time_source_queue_base
     : public std::enable_shared_from_this<time_source_queue_base<E, TP>> {
@@ -86,19 +142,10 @@ class time_source_queue_base
   using time_point = std::decay_t<TP>;
   bool dispatching_ = false;
   bool pending_ = false;
-  std::priority_queue<
-      time_heap_item<E, TP>,
-      std::vector<time_heap_item<E, TP>>,
-      std::greater<>>
-      heap_;
+  time_heap<E, TP> heap_;
 
   virtual ~time_source_queue_base() {}
 
-  time_heap_item<E, TP>& top() {
-    // :(
-    return const_cast<time_heap_item<E, TP>&>(this->heap_.top());
-  }
-
   virtual void dispatch() = 0;
 };
 
@@ -139,7 +186,7 @@ class time_source_queue : public time_source_queue_base<E, TP> {
     // going back to the pending queue.
     auto start = nf_() + std::chrono::milliseconds(50);
 
-    std::unique_lock<std::mutex> guard{s->lock_};
+    std::unique_lock<detail::time_source_mutex> guard{s->lock_};
 
     if (!this->dispatching_ || this->pending_) {
       std::terminate();
@@ -150,17 +197,22 @@ class time_source_queue : public time_source_queue_base<E, TP> {
     }
     auto that = shared_from_that();
     auto subEx = time_source_executor<E, TP, NF, Exec>{s, that};
+    std::uint64_t fired = 0;
     while (!this->heap_.empty() && this->heap_.top().when <= start) {
-      auto item{std::move(this->top())};
+      auto item = this->heap_.top();
       this->heap_.pop();
       guard.unlock();
       std::this_thread::sleep_until(item.when);
-      set_value(item.what, any_time_executor_ref<E, TP>{subEx});
-      set_done(item.what);
+      s->stats_.fired(std::chrono::duration_cast<std::chrono::nanoseconds>(
+          nf_() - item.when));
+      item.what->value(any_time_executor_ref<E, TP>{subEx});
       guard.lock();
       // allows set_value to queue nested items
       --s->items_;
+      s->stats_.dequeue();
+      ++fired;
     }
+    s->stats_.batch(fired);
 
     if (this->heap_.empty()) {
       // if this is empty, tell worker to check for the done condition.
@@ -170,11 +222,12 @@ class time_source_queue : public time_source_queue_base<E, TP> {
       if (!!s->error_) {
         while (!this->heap_.empty()) {
           try {
-            auto what{std::move(this->top().what)};
+            auto what = this->heap_.top().what;
             this->heap_.pop();
             --s->items_;
+            s->stats_.dequeue();
             guard.unlock();
-            set_error(what, *s->error_);
+            what->error(*s->error_);
             guard.lock();
           } catch (...) {
             // we already have an error, ignore this one.
@@ -186,25 +239,26 @@ class time_source_queue : public time_source_queue_base<E, TP> {
   template <class AE>
   void error(AE e) noexcept {
     auto s = source_.lock();
-    std::unique_lock<std::mutex> guard{s->lock_};
+    std::unique_lock<detail::time_source_mutex> guard{s->lock_};
 
     if (!this->dispatching_ || this->pending_) {
       std::terminate();
     }
 
     while (!this->heap_.empty()) {
-      auto what{std::move(this->top().what)};
+      auto what = this->heap_.top().what;
       this->heap_.pop();
       --s->items_;
+      s->stats_.dequeue();
       guard.unlock();
-      set_error(what, detail::as_const(e));
+      what->error(detail::as_const(e));
       guard.lock();
     }
     this->dispatching_ = false;
   }
   void done() {
     auto s = source_.lock();
-    std::unique_lock<std::mutex> guard{s->lock_};
+    std::unique_lock<detail::time_source_mutex> guard{s->lock_};
 
     if (!this->dispatching_ || this->pending_) {
       std::terminate();
@@ -214,7 +268,8 @@ class time_source_queue : public time_source_queue_base<E, TP> {
     // add back to pending_ to get the remaining items dispatched
     s->pending_.push_back(this->shared_from_this());
     this->pending_ = true;
-    if (this->heap_.top().when <= s->earliest_) {
+    // the remaining items may have been cancelled
+    if (!this->heap_.empty() && this->heap_.top().when <= s->earliest_) {
       // this is the earliest, tell worker to reset earliest_
       ++s->dirty_;
       s->wake_.notify_one();
@@ -274,8 +329,8 @@ class time_source_shared_base
     : public std::enable_shared_from_this<time_source_shared_base<E, TP>> {
  public:
   using time_point = std::decay_t<TP>;
-  std::mutex lock_;
-  std::condition_variable wake_;
+  detail::time_source_mutex lock_;
+  detail::condition_variable_for<detail::time_source_mutex> wake_;
   std::thread t_;
   std::chrono::system_clock::time_point earliest_;
   bool done_;
@@ -284,6 +339,7 @@ class time_source_shared_base
   int items_;
   detail::opt<E> error_;
   std::deque<std::shared_ptr<time_source_queue_base<E, TP>>> pending_;
+  time_source_stats stats_;
 
   time_source_shared_base()
       : earliest_(std::chrono::system_clock::now() + std::chrono::hours(24)),
@@ -314,7 +370,7 @@ class time_source_shared : public time_source_shared_base<E, TP> {
     that->t_ = std::thread{&time_source_shared<E, TP>::worker, that};
   }
   static void join(std::shared_ptr<time_source_shared<E, TP>> that) {
-    std::unique_lock<std::mutex> guard{that->lock_};
+    std::unique_lock<detail::time_source_mutex> guard{that->lock_};
     that->done_ = true;
     ++that->dirty_;
     that->wake_.notify_one();
@@ -324,7 +380,7 @@ class time_source_shared : public time_source_shared_base<E, TP> {
 
   static void worker(std::shared_ptr<time_source_shared<E, TP>> that) {
     try {
-      std::unique_lock<std::mutex> guard{that->lock_};
+      std::unique_lock<detail::time_source_mutex> guard{that->lock_};
 
       // once done_, keep going until empty
       while (!that->done_ || that->items_ > 0) {
@@ -379,18 +435,19 @@ class time_source_shared : public time_source_shared_base<E, TP> {
       //
       // also dispatch errors to all items already in the queues from the
       // time thread
-      std::unique_lock<std::mutex> guard{that->lock_};
+      std::unique_lock<detail::time_source_mutex> guard{that->lock_};
       // creates a dependency that std::exception_ptr must be ConvertibleTo E
       // TODO: break this dependency rather than enforce it with concepts
       that->error_ = std::current_exception();
       for (auto& q : that->pending_) {
         while (!q->heap_.empty()) {
           try {
-            auto what{std::move(q->top().what)};
+            auto what = q->heap_.top().what;
             q->heap_.pop();
             --that->items_;
+            that->stats_.dequeue();
             guard.unlock();
-            set_error(what, *that->error_);
+            what->error(*that->error_);
             guard.lock();
           } catch (...) {
             // we already have an error, ignore this one.
@@ -403,11 +460,11 @@ class time_source_shared : public time_source_shared_base<E, TP> {
   void insert(
       std::shared_ptr<time_source_queue_base<E, TP>> queue,
       time_heap_item<E, TP> item) {
-    std::unique_lock<std::mutex> guard{this->lock_};
+    std::unique_lock<detail::time_source_mutex> guard{this->lock_};
 
     // deliver error_ and return
     if (!!this->error_) {
-      set_error(item.what, *this->error_);
+      item.what->error(*this->error_);
       return;
     }
     // once join() is called, new work queued to the executor is not safe unless
@@ -416,8 +473,9 @@ class time_source_shared : public time_source_shared_base<E, TP> {
       std::terminate();
     };
 
-    queue->heap_.push(std::move(item));
+    queue->heap_.push(item);
     ++this->items_;
+    this->stats_.enqueue(static_cast<std::uint64_t>(this->items_));
 
     if (!queue->dispatching_ && !queue->pending_) {
       // add queue to pending pending_ list if it is not already there
@@ -431,11 +489,126 @@ class time_source_shared : public time_source_shared_base<E, TP> {
       this->wake_.notify_one();
     }
   }
+
+  // removes node if it has not been taken for dispatch yet
+  bool cancel(
+      time_source_queue_base<E, TP>& queue,
+      time_heap_node<E, TP>* node) {
+    std::unique_lock<detail::time_source_mutex> guard{this->lock_};
+    if (!queue.heap_.remove(node)) {
+      return false;
+    }
+    --this->items_;
+    this->stats_.dequeue();
+    // the worker may be waiting for the last item to finish
+    ++this->dirty_;
+    this->wake_.notify_one();
+    return true;
+  }
 };
 
 template <class E, class TP, class NF, class Exec>
 class time_source_executor;
 
+//
+// the node for a submitted receiver
+//
+
+template <class E, class TP, class Out>
+class time_source_submit_node : public time_heap_node<E, TP> {
+  using node_t = time_heap_node<E, TP>;
+  using allocator_t = allocator_for_t<time_source_submit_node, Out>;
+  using traits_t = std::allocator_traits<allocator_t>;
+  Out out_;
+
+  struct deleter {
+    void operator()(time_source_submit_node* self) const {
+      allocator_t alloc{::pushmi::get_allocator(self->out_)};
+      traits_t::destroy(alloc, self);
+      traits_t::deallocate(alloc, self, 1);
+    }
+  };
+  using owner_t = std::unique_ptr<time_source_submit_node, deleter>;
+
+  static void deliver_value(node_t* node, typename node_t::executor_ref ex) {
+    owner_t self{static_cast<time_source_submit_node*>(node)};
+    ::pushmi::set_value(self->out_, std::move(ex));
+    ::pushmi::set_done(self->out_);
+  }
+  static void deliver_error(node_t* node, E e) {
+    owner_t self{static_cast<time_source_submit_node*>(node)};
+    ::pushmi::set_error(self->out_, std::move(e));
+  }
+
+ public:
+  explicit time_source_submit_node(Out out)
+      : node_t(&deliver_value, &deliver_error), out_(std::move(out)) {}
+
+  template <class SOut>
+  static node_t* make(SOut&& out) {
+    allocator_t alloc{::pushmi::get_allocator(out)};
+    auto p = traits_t::allocate(alloc, 1);
+    try {
+      traits_t::construct(alloc, p, (SOut &&) out);
+    } catch (...) {
+      traits_t::deallocate(alloc, p, 1);
+      throw;
+    }
+    return p;
+  }
+};
+
+//
+// the operation state of a connected time task is its own timer node. it
+// must not move after start() until the receiver has been signalled.
+//
+// cancel() removes a started operation that has not been taken for dispatch
+// and signals done. it returns false once the operation is being signalled.
+//
+
+template <class E, class TP, class NF, class Exec, class Out>
+class time_source_operation : time_heap_node<E, TP> {
+  using node_t = time_heap_node<E, TP>;
+  using time_point = std::decay_t<TP>;
+  time_point tp_;
+  std::shared_ptr<time_source_shared<E, time_point>> source_;
+  std::shared_ptr<time_source_queue<E, time_point, NF, Exec>> queue_;
+  Out out_;
+
+  static void deliver_value(node_t* node, typename node_t::executor_ref ex) {
+    auto self = static_cast<time_source_operation*>(node);
+    ::pushmi::set_value(self->out_, std::move(ex));
+    ::pushmi::set_done(self->out_);
+  }
+  static void deliver_error(node_t* node, E e) {
+    auto self = static_cast<time_source_operation*>(node);
+    ::pushmi::set_error(self->out_, std::move(e));
+  }
+
+ public:
+  time_source_operation(
+      time_point tp,
+      std::shared_ptr<time_source_shared<E, time_point>> source,
+      std::shared_ptr<time_source_queue<E, time_point, NF, Exec>> queue,
+      Out out)
+      : node_t(&deliver_value, &deliver_error),
+        tp_(tp),
+        source_(std::move(source)),
+        queue_(std::move(queue)),
+        out_(std::move(out)) {}
+
+  void start() {
+    source_->insert(queue_, time_heap_item<E, TP>{tp_, this});
+  }
+  bool cancel() {
+    if (!source_->cancel(*queue_, this)) {
+      return false;
+    }
+    ::pushmi::set_done(out_);
+    return true;
+  }
+};
+
 //
 // the time task will queue the work to the time ordered heap.
 //
@@ -465,7 +638,17 @@ class time_source_task {
     source_->insert(
         queue_,
         time_heap_item<E, TP>{
-            tp_, any_receiver<E, any_time_executor_ref<E, TP>>{(Out&&)out}});
+            tp_,
+            time_source_submit_node<E, TP, remove_cvref_t<Out>>::make(
+                (Out&&)out)});
+  }
+
+  PUSHMI_TEMPLATE(class Out)
+  (requires ReceiveValue<Out, any_time_executor_ref<E, TP>>&&
+       ReceiveError<Out, E>)
+  auto connect(Out out) {
+    return time_source_operation<E, TP, NF, Exec, Out>{
+        tp_, source_, queue_, std::move(out)};
   }
 };
 
@@ -505,24 +688,34 @@ class time_source_executor {
 // is called.
 //
 
-template <class E, class TP, class NF, class Factory>
+template <
+    class E,
+    class TP,
+    class NF,
+    class Factory,
+    class Alloc = std::allocator<char>>
 class time_source_executor_factory_fn {
   using time_point = std::decay_t<TP>;
   std::shared_ptr<time_source_shared<E, time_point>> source_;
   NF nf_;
   Factory ef_;
+  Alloc alloc_;
 
  public:
   time_source_executor_factory_fn(
       std::shared_ptr<time_source_shared<E, time_point>> source,
       NF nf,
-      Factory ef)
-      : source_(std::move(source)), nf_(std::move(nf)), ef_(std::move(ef)) {}
+      Factory ef,
+      Alloc alloc = Alloc{})
+      : source_(std::move(source)),
+        nf_(std::move(nf)),
+        ef_(std::move(ef)),
+        alloc_(std::move(alloc)) {}
   auto make_strand() {
     auto ex = ::pushmi::make_strand(ef_);
-    auto queue =
-        std::make_shared<time_source_queue<E, time_point, NF, decltype(ex)>>(
-            source_, nf_, std::move(ex));
+    auto queue = std::allocate_shared<
+        time_source_queue<E, time_point, NF, decltype(ex)>>(
+        alloc_, source_, nf_, std::move(ex));
     return time_source_executor<E, time_point, NF, decltype(ex)>{source_,
                                                                  queue};
   }
@@ -562,39 +755,43 @@ class time_source_same_executor_factory_fn {
 // factory. the time executor factory is a function that will return a time
 // executor when called with no arguments.
 //
-//
+// the shared state and the queues are allocated with Alloc.
 //
 
 template <
     class E = std::exception_ptr,
-    class TP = std::chrono::system_clock::time_point>
+    class TP = std::chrono::system_clock::time_point,
+    class Alloc = std::allocator<char>>
 class time_source {
  public:
   using time_point = std::decay_t<TP>;
 
  private:
+  Alloc alloc_;
   std::shared_ptr<time_source_shared<E, time_point>> source_;
 
  public:
-  time_source()
-      : source_(std::make_shared<time_source_shared<E, time_point>>()) {
+  explicit time_source(Alloc alloc = Alloc{})
+      : alloc_(std::move(alloc)),
+        source_(std::allocate_shared<time_source_shared<E, time_point>>(
+            alloc_)) {
     source_->start(source_);
   }
 
   PUSHMI_TEMPLATE(class NF, class Factory)
   (requires StrandFactory<Factory> && not Executor<Factory> && not ExecutorProvider<Factory>) //
   auto make(NF nf, Factory ef) {
-    return time_source_executor_factory_fn<E, time_point, NF, Factory>{
-        source_, std::move(nf), std::move(ef)};
+    return time_source_executor_factory_fn<E, time_point, NF, Factory, Alloc>{
+        source_, std::move(nf), std::move(ef), alloc_};
   }
   PUSHMI_TEMPLATE(class NF, class Provider)
   (requires ExecutorProvider<Provider>&&
            NeverBlocking<sender_t<executor_t<Provider>>> && not StrandFactory<Provider>) //
   auto make(NF nf, Provider ep) {
     auto ex = ::pushmi::get_executor(ep);
-    auto queue =
-        std::make_shared<time_source_queue<E, time_point, NF, decltype(ex)>>(
-            source_, nf, std::move(ex));
+    auto queue = std::allocate_shared<
+        time_source_queue<E, time_point, NF, decltype(ex)>>(
+        alloc_, source_, nf, std::move(ex));
     return time_source_same_executor_factory_fn<E, time_point, NF, decltype(ex)>{
         source_, std::move(queue), std::move(nf)};
   }
@@ -603,8 +800,8 @@ class time_source {
            NeverBlocking<sender_t<Exec>> && not StrandFactory<Exec>) //
   auto make(NF nf, Exec ex) {
     auto queue =
-        std::make_shared<time_source_queue<E, time_point, NF, Exec>>(
-            source_, nf, std::move(ex));
+        std::allocate_shared<time_source_queue<E, time_point, NF, Exec>>(
+            alloc_, source_, nf, std::move(ex));
     return time_source_same_executor_factory_fn<E, time_point, NF, Exec>{
         source_, std::move(queue), std::move(nf)};
   }
@@ -612,5 +809,10 @@ class time_source {
   void join() {
     source_->join(source_);
   }
+
+  // the counts for all the queues of this time_source
+  time_source_stats& stats() const {
+    return source_->stats_;
+  }
 };
 } // namespace pushmi
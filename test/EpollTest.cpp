@@ -0,0 +1,298 @@
+/*
+ * Copyright 2018-present Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#if defined(__linux__)
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+using namespace std::literals;
+
+#include <pushmi/o/schedule.h>
+#include <pushmi/o/submit.h>
+#include <pushmi/o/transform.h>
+
+#include <pushmi/epoll_context.h>
+
+using namespace pushmi::aliases;
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+using namespace testing;
+
+class EpollContext : public Test {
+ public:
+  ~EpollContext() override {
+    context_.stop();
+    thread_.join();
+    for (auto fd : pipe_) {
+      if (fd >= 0) {
+        ::close(fd);
+      }
+    }
+  }
+
+ protected:
+  mi::epoll_context context_;
+  std::thread thread_{[this] { context_.run(); }};
+  int pipe_[2] = {-1, -1};
+
+  void make_pipe() {
+    ASSERT_THAT(::pipe2(pipe_, O_NONBLOCK | O_CLOEXEC), Eq(0));
+  }
+
+  template <class F>
+  static void wait_for(F f) {
+    auto until = std::chrono::steady_clock::now() + 5s;
+    while (!f() && std::chrono::steady_clock::now() < until) {
+      std::this_thread::yield();
+    }
+  }
+};
+
+TEST_F(EpollContext, ScheduleRunsOnRunThread) {
+  auto ex = context_.executor();
+  static_assert(
+      mi::TimeExecutor<decltype(ex), mi::is_fifo_sequence<>>,
+      "expected the epoll executor to be a fifo time executor");
+
+  std::thread::id ran;
+  ex | op::schedule() | op::blocking_submit([&](auto) {
+    ran = std::this_thread::get_id();
+  });
+  EXPECT_THAT(ran, Eq(thread_.get_id()));
+
+  std::vector<int> order;
+  ex | op::schedule() | op::blocking_submit([&](auto nested) {
+    for (int i = 0; i < 3; ++i) {
+      nested | op::schedule() | op::submit([&, i](auto) {
+        order.push_back(i);
+      });
+    }
+  });
+  wait_for([&] { return order.size() == 3; });
+  EXPECT_THAT(order, ElementsAre(0, 1, 2))
+      << "expected that the items ran in the order that they were scheduled";
+}
+
+TEST_F(EpollContext, TimersAreOrderedInTime) {
+  auto ex = context_.executor();
+  std::vector<std::string> times;
+  std::atomic<int> pushed{0};
+  auto push = [&](int time) {
+    return v::on_value([&, time](auto) {
+      times.push_back(std::to_string(time));
+      ++pushed;
+    });
+  };
+  auto start = mi::now(ex);
+  ex | op::schedule() | op::submit(v::on_value([push](auto ex) {
+    auto now = ex | ep::now();
+    ex | op::schedule_after(40ms) | op::submit(push(40));
+    ex | op::schedule_at(now + 10ms) | op::submit(push(10));
+    ex | op::schedule_after(20ms) | op::submit(push(20));
+    ex | op::schedule() | op::submit(push(0));
+  }));
+  wait_for([&] { return pushed.load() == 4; });
+
+  EXPECT_THAT(times, ElementsAre("0", "10", "20", "40"))
+      << "expected that the items were pushed in time order not insertion order";
+  EXPECT_THAT(mi::now(ex) - start, Ge(40ms));
+}
+
+TEST_F(EpollContext, WhenReadable) {
+  make_pipe();
+  std::atomic<int> signals{0};
+  int ready = -1;
+  context_.when_readable(pipe_[0]) |
+      op::submit(
+          [&](int fd) {
+            ready = fd;
+            signals += 100;
+          },
+          [&](auto) noexcept { signals += 1000; },
+          [&]() { signals += 10; });
+
+  std::this_thread::sleep_for(10ms);
+  EXPECT_THAT(signals.load(), Eq(0))
+      << "expected that nothing is signalled before the pipe has data";
+
+  ASSERT_THAT(::write(pipe_[1], "x", 1), Eq(1));
+  wait_for([&] { return signals.load() == 110; });
+  EXPECT_THAT(signals.load(), Eq(110));
+  EXPECT_THAT(ready, Eq(pipe_[0]));
+}
+
+TEST_F(EpollContext, WhenWritable) {
+  make_pipe();
+  auto written = context_.when_writable(pipe_[1]) |
+      op::transform([](int fd) { return ::write(fd, "y", 1); }) |
+      op::get<ssize_t>;
+  EXPECT_THAT(written, Eq(1));
+
+  char c = 0;
+  EXPECT_THAT(::read(pipe_[0], &c, 1), Eq(1));
+  EXPECT_THAT(c, Eq('y'));
+}
+
+TEST_F(EpollContext, RemoveSignalsDone) {
+  make_pipe();
+  std::atomic<int> signals{0};
+  context_.when_readable(pipe_[0]) |
+      op::submit(
+          [&](int) { signals += 100; },
+          [&](auto) noexcept { signals += 1000; },
+          [&]() { signals += 10; });
+  context_.remove(pipe_[0]);
+  wait_for([&] { return signals.load() != 0; });
+  EXPECT_THAT(signals.load(), Eq(10))
+      << "expected that the waiting receiver was signalled done";
+}
+
+TEST_F(EpollContext, BadFdSignalsError) {
+  std::atomic<int> signals{0};
+  std::error_code code;
+  context_.when_readable(-1) |
+      op::submit(
+          [&](int) { signals += 100; },
+          [&](std::exception_ptr e) noexcept {
+            try {
+              std::rethrow_exception(e);
+            } catch (const std::system_error& error) {
+              code = error.code();
+            }
+            signals += 1000;
+          },
+          [&]() { signals += 10; });
+  wait_for([&] { return signals.load() != 0; });
+  EXPECT_THAT(signals.load(), Eq(1000))
+      << "expected that a fd that cannot be watched is signalled as an error";
+  EXPECT_THAT(code, Eq(std::errc::bad_file_descriptor));
+
+  // the failed fd is not kept, so it can be submitted again
+  context_.when_writable(-1) |
+      op::submit(
+          [&](int) { signals += 100; },
+          [&](auto) noexcept { signals += 1000; },
+          [&]() { signals += 10; });
+  wait_for([&] { return signals.load() != 1000; });
+  EXPECT_THAT(signals.load(), Eq(2000));
+}
+
+TEST_F(EpollContext, ReadableStreamRespectsRequests) {
+  make_pipe();
+  std::atomic<int> values{0};
+  std::atomic<int> dones{0};
+  std::string received;
+  mi::any_receiver<std::exception_ptr, std::ptrdiff_t> up;
+  std::atomic<bool> started{false};
+
+  context_.readable_stream(pipe_[0], 4) |
+      op::submit(mi::make_flow_receiver(
+          mi::on_value([&](std::vector<char> chunk) {
+            received.append(chunk.begin(), chunk.end());
+            ++values;
+          }),
+          mi::on_error([&](auto) noexcept { dones += 1000; }),
+          mi::on_done([&]() { ++dones; }),
+          mi::on_starting([&](auto u) {
+            up = mi::any_receiver<std::exception_ptr, std::ptrdiff_t>{
+                std::move(u)};
+            started = true;
+            ::mi::set_value(up, 2);
+          })));
+  wait_for([&] { return started.load(); });
+
+  ASSERT_THAT(::write(pipe_[1], "aaaabbbbcccc", 12), Eq(12));
+  wait_for([&] { return values.load() == 2; });
+  std::this_thread::sleep_for(10ms);
+  EXPECT_THAT(values.load(), Eq(2))
+      << "expected that only the requested chunks were read";
+
+  auto ex = context_.executor();
+  ex | op::schedule() | op::blocking_submit([&](auto) {
+    ::mi::set_value(up, 5);
+  });
+  wait_for([&] { return values.load() == 3; });
+  EXPECT_THAT(received, Eq("aaaabbbbcccc"));
+
+  context_.remove(pipe_[1]);
+  ::close(pipe_[1]);
+  pipe_[1] = -1;
+  wait_for([&] { return dones.load() != 0; });
+  EXPECT_THAT(dones.load(), Eq(1))
+      << "expected that the stream is done at the end of the pipe";
+  EXPECT_THAT(values.load(), Eq(3));
+}
+
+TEST_F(EpollContext, ReadableStreamCancelReleasesState) {
+  make_pipe();
+  auto token = std::make_shared<int>(0);
+  std::atomic<int> dones{0};
+  mi::any_receiver<std::exception_ptr, std::ptrdiff_t> up;
+  std::atomic<bool> started{false};
+
+  context_.readable_stream(pipe_[0]) |
+      op::submit(mi::make_flow_receiver(
+          mi::on_value([token](std::vector<char>) {}),
+          mi::on_error([&](auto) noexcept { dones += 1000; }),
+          mi::on_done([&]() { ++dones; }),
+          mi::on_starting([&](auto u) {
+            up = mi::any_receiver<std::exception_ptr, std::ptrdiff_t>{
+                std::move(u)};
+            ::mi::set_value(up, 1);
+            started = true;
+          })));
+  wait_for([&] { return started.load(); });
+
+  // the request runs on the run() thread and waits for the empty pipe
+  auto ex = context_.executor();
+  ex | op::schedule() | op::blocking_submit([](auto) {});
+  ::mi::set_done(up);
+  wait_for([&] { return dones.load() != 0; });
+  EXPECT_THAT(dones.load(), Eq(1));
+
+  up = mi::any_receiver<std::exception_ptr, std::ptrdiff_t>{};
+  ex | op::schedule() | op::blocking_submit([](auto) {});
+  EXPECT_THAT(token.use_count(), Eq(1))
+      << "expected that the cancelled stream stopped waiting for the fd";
+}
+
+TEST_F(EpollContext, ReadableStreamSignalsDoneWhenDestroyed) {
+  make_pipe();
+  int dones = 0;
+  {
+    mi::epoll_context unstarted;
+    unstarted.readable_stream(pipe_[0]) |
+        op::submit(mi::make_flow_receiver(
+            mi::on_value([](std::vector<char>) {}),
+            mi::on_error([&](auto) noexcept { dones += 1000; }),
+            mi::on_done([&]() { ++dones; })));
+  }
+  EXPECT_THAT(dones, Eq(1))
+      << "expected that a stream that never started is signalled done";
+}
+
+#endif // defined(__linux__)
@@ -15,15 +15,22 @@
  */
 
 #include <array>
+#include <numeric>
 
 #include <type_traits>
 
 #include <chrono>
+#include <thread>
 using namespace std::literals;
 
 #include <pushmi/flow_many_sender.h>
+#include <pushmi/o/buffer.h>
+#include <pushmi/o/flat_map.h>
 #include <pushmi/o/for_each.h>
 #include <pushmi/o/from.h>
+#include <pushmi/o/merge.h>
+#include <pushmi/o/parallel_transform.h>
+#include <pushmi/o/ref_share.h>
 #include <pushmi/o/submit.h>
 
 #include <pushmi/new_thread.h>
@@ -317,3 +324,451 @@ TEST(FlowManySender, From) {
 
   EXPECT_THAT(actual, Eq(5)) << "expexcted that all the values are sent once";
 }
+
+class RefShareFlowManySender : public Test {
+ protected:
+  auto make_producer() {
+    return mi::MAKE(flow_many_sender)([&](auto out) {
+      using Out = decltype(out);
+      struct Data : mi::receiver<> {
+        explicit Data(Out out_) : out(std::move(out_)) {}
+        Out out;
+        int next = 0;
+      };
+
+      ++connects_;
+      auto up = mi::MAKE(receiver)(
+          Data{std::move(out)},
+          [&](auto& data, auto requested) {
+            while (requested-- > 0) {
+              ::mi::set_value(data.out, data.next++);
+            }
+          },
+          [&](auto& data, auto) noexcept {
+            ++cancels_;
+            ::mi::set_done(data.out);
+          },
+          [&](auto& data) {
+            ++cancels_;
+            ::mi::set_done(data.out);
+          });
+
+      // pass reference for cancellation.
+      ::mi::set_starting(up.data().out, std::move(up));
+    });
+  }
+
+  auto make_consumer(std::vector<int>& values) {
+    return mi::MAKE(flow_receiver)(
+        mi::on_value([&](int v) { values.push_back(v); }),
+        mi::on_error([&](auto) noexcept { ++errors_; }),
+        mi::on_done([&]() { ++dones_; }),
+        mi::on_starting([&](auto up) { ups_.push_back(std::move(up)); }));
+  }
+
+  int connects_{0};
+  int cancels_{0};
+  int errors_{0};
+  int dones_{0};
+  std::vector<mi::any_receiver<std::exception_ptr, std::ptrdiff_t>> ups_;
+};
+
+TEST_F(RefShareFlowManySender, ConnectsOnFirstAndCancelsOnLast) {
+  auto shared = make_producer() | op::ref_share<int>();
+
+  EXPECT_THAT(connects_, Eq(0))
+      << "expected that the upstream is not submitted until a receiver is";
+
+  std::vector<int> a, b;
+  shared | op::submit(make_consumer(a));
+  shared | op::submit(make_consumer(b));
+
+  EXPECT_THAT(connects_, Eq(1))
+      << "expected that both receivers share one upstream submission";
+  ASSERT_THAT(ups_.size(), Eq(2u));
+
+  ::mi::set_value(ups_[0], 2);
+  EXPECT_THAT(a, IsEmpty())
+      << "expected that values wait for demand from every receiver";
+
+  ::mi::set_value(ups_[1], 1);
+  EXPECT_THAT(a, ElementsAre(0));
+  EXPECT_THAT(b, ElementsAre(0));
+
+  ::mi::set_done(ups_[0]);
+  EXPECT_THAT(dones_, Eq(1));
+  EXPECT_THAT(cancels_, Eq(0))
+      << "expected that the upstream stays connected while a receiver remains";
+
+  ::mi::set_done(ups_[1]);
+  EXPECT_THAT(dones_, Eq(2));
+  EXPECT_THAT(cancels_, Eq(1))
+      << "expected that the last receiver to leave cancels the upstream";
+
+  std::vector<int> c;
+  shared | op::submit(make_consumer(c));
+  ::mi::set_value(ups_[2], 1);
+  EXPECT_THAT(connects_, Eq(2))
+      << "expected that a new receiver connects to the upstream again";
+  EXPECT_THAT(c, ElementsAre(0));
+  ::mi::set_done(ups_[2]);
+  EXPECT_THAT(cancels_, Eq(2));
+}
+
+TEST_F(RefShareFlowManySender, ReentrantRequests) {
+  auto shared = make_producer() | op::ref_share<int>();
+
+  std::vector<int> values;
+  shared | op::submit(mi::MAKE(flow_receiver)(
+               mi::on_value([&](int v) {
+                 values.push_back(v);
+                 if (v < 4) {
+                   ::mi::set_value(ups_[0], 1);
+                 } else {
+                   ::mi::set_done(ups_[0]);
+                 }
+               }),
+               mi::on_error([&](auto) noexcept { ++errors_; }),
+               mi::on_done([&]() { ++dones_; }),
+               mi::on_starting([&](auto up) {
+                 ups_.push_back(std::move(up));
+                 ::mi::set_value(ups_[0], 1);
+               })));
+
+  EXPECT_THAT(values, ElementsAre(0, 1, 2, 3, 4))
+      << "expected that requests from inside of value are honored in order";
+  EXPECT_THAT(dones_, Eq(1));
+  EXPECT_THAT(cancels_, Eq(1));
+}
+
+TEST_F(RefShareFlowManySender, RequestsFromAnotherThread) {
+  auto shared = make_producer() | op::ref_share<int>();
+
+  std::vector<int> values;
+  shared | op::submit(mi::MAKE(flow_receiver)(
+               mi::on_value([&](int v) {
+                 values.push_back(v);
+                 // the request is made, and waited for, while the value
+                 // signal is still running
+                 std::thread{[&, v] {
+                   if (v < 2) {
+                     ::mi::set_value(ups_[0], 1);
+                   } else {
+                     ::mi::set_done(ups_[0]);
+                   }
+                 }}.join();
+               }),
+               mi::on_error([&](auto) noexcept { ++errors_; }),
+               mi::on_done([&]() { ++dones_; }),
+               mi::on_starting([&](auto up) {
+                 ups_.push_back(std::move(up));
+                 ::mi::set_value(ups_[0], 1);
+               })));
+
+  EXPECT_THAT(values, ElementsAre(0, 1, 2))
+      << "expected that a request from another thread does not deadlock";
+  EXPECT_THAT(dones_, Eq(1));
+  EXPECT_THAT(cancels_, Eq(1));
+}
+
+TEST(FlowManySender, Buffer) {
+  auto v = std::array<int, 5>{{0, 1, 2, 3, 4}};
+  auto f = op::flow_from(v);
+
+  std::vector<std::vector<int>> buffers;
+  f | op::buffer<int>(2) | op::for_each(mi::MAKE(receiver)(
+                               [&](std::vector<int> b) {
+                                 buffers.push_back(std::move(b));
+                               }));
+
+  EXPECT_THAT(
+      buffers,
+      ElementsAre(ElementsAre(0, 1), ElementsAre(2, 3), ElementsAre(4)))
+      << "expected that each requested buffer requests two values";
+}
+
+class MergeFlowManySender : public Test {
+ protected:
+  // a producer that records the requests that it receives and sends count
+  // values in total.
+  auto make_producer(std::vector<std::ptrdiff_t>& requests, int first, int count) {
+    return mi::MAKE(flow_many_sender)([&requests, first, count](auto out) {
+      using Out = decltype(out);
+      struct Data : mi::receiver<> {
+        explicit Data(Out out_) : out(std::move(out_)) {}
+        Out out;
+        int next;
+        int last;
+      };
+      Data data{std::move(out)};
+      data.next = first;
+      data.last = first + count;
+
+      auto up = mi::MAKE(receiver)(
+          std::move(data),
+          [&requests](auto& data, auto requested) {
+            requests.push_back(requested);
+            while (requested-- > 0 && data.next != data.last) {
+              ::mi::set_value(data.out, data.next++);
+            }
+            if (data.next == data.last) {
+              ::mi::set_done(data.out);
+            }
+          },
+          [](auto& data, auto) noexcept { ::mi::set_done(data.out); },
+          [](auto& data) { ::mi::set_done(data.out); });
+
+      // pass reference for cancellation.
+      ::mi::set_starting(up.data().out, std::move(up));
+    });
+  }
+
+  auto make_consumer() {
+    return mi::MAKE(flow_receiver)(
+        mi::on_value([&](int v) { values_.push_back(v); }),
+        mi::on_error([&](auto) noexcept { ++errors_; }),
+        mi::on_done([&]() { ++dones_; }),
+        mi::on_starting([&](auto up) {
+          up_ = mi::any_receiver<std::exception_ptr, std::ptrdiff_t>{
+              std::move(up)};
+        }));
+  }
+
+  std::vector<int> values_;
+  int errors_{0};
+  int dones_{0};
+  mi::any_receiver<std::exception_ptr, std::ptrdiff_t> up_;
+};
+
+TEST_F(MergeFlowManySender, SplitsDemand) {
+  std::vector<std::ptrdiff_t> left, right;
+  op::merge<int>(make_producer(left, 0, 3), make_producer(right, 10, 3)) |
+      op::submit(make_consumer());
+
+  EXPECT_THAT(values_, IsEmpty()) << "expected that nothing was requested yet";
+
+  ::mi::set_value(up_, 3);
+  EXPECT_THAT(left.size() + right.size(), Eq(2u));
+  EXPECT_THAT(values_.size(), Eq(3u))
+      << "expected that exactly the requested values were delivered";
+  EXPECT_THAT(
+      std::abs(static_cast<int>(left.front() - right.front())), Le(1))
+      << "expected that the demand was split evenly";
+
+  ::mi::set_value(up_, 10);
+  EXPECT_THAT(values_, UnorderedElementsAre(0, 1, 2, 10, 11, 12));
+  EXPECT_THAT(dones_, Eq(1)) << "expected done once both inputs are done";
+}
+
+TEST_F(MergeFlowManySender, Cancellation) {
+  std::vector<std::ptrdiff_t> left, right;
+  op::merge<int>(make_producer(left, 0, 3), make_producer(right, 10, 3)) |
+      op::submit(make_consumer());
+
+  ::mi::set_value(up_, 2);
+  ::mi::set_done(up_);
+  ::mi::set_value(up_, 2);
+
+  EXPECT_THAT(values_.size(), Eq(2u))
+      << "expected that no values are delivered after cancellation";
+  EXPECT_THAT(dones_, Eq(1));
+}
+
+TEST_F(MergeFlowManySender, ManySenders) {
+  std::array<int, 3> a{{0, 1, 2}};
+  std::array<int, 2> b{{10, 11}};
+  int dones = 0;
+  op::merge<int>(op::from(a), op::from(b), op::from(a)) |
+      op::submit(
+          [&](int v) { values_.push_back(v); },
+          [&](auto) noexcept { ++errors_; },
+          [&]() { ++dones; });
+
+  EXPECT_THAT(values_, UnorderedElementsAre(0, 1, 2, 10, 11, 0, 1, 2));
+  EXPECT_THAT(dones, Eq(1));
+}
+
+TEST_F(MergeFlowManySender, MergeAll) {
+  std::array<int, 3> a{{0, 1, 2}};
+  std::array<int, 2> b{{10, 11}};
+  auto senders = std::array<decltype(op::flow_from(a)), 3>{
+      {op::flow_from(a), op::flow_from(b), op::flow_from(a)}};
+
+  op::flow_from(senders) | op::merge_all<int>(1) |
+      op::for_each(mi::MAKE(receiver)([&](int v) { values_.push_back(v); }));
+
+  EXPECT_THAT(values_, ElementsAre(0, 1, 2, 10, 11, 0, 1, 2))
+      << "expected that the inputs are merged one at a time";
+}
+
+TEST_F(MergeFlowManySender, Concurrent) {
+  // flow_from requires an executor that runs requests in order, each time
+  // source runs its items on its own thread.
+  NT nt0{mi::new_thread()}, nt1{mi::new_thread()}, nt2{mi::new_thread()};
+  mi::time_source<> t0{}, t1{}, t2{};
+  auto e0 = make_time(t0, nt0);
+  auto e1 = make_time(t1, nt1);
+  auto e2 = make_time(t2, nt2);
+  std::array<int, 100> a;
+  std::iota(a.begin(), a.end(), 0);
+  std::atomic<int> count{0};
+  std::atomic<int> done{0};
+
+  op::merge<int>(op::flow_from(a, e0), op::flow_from(a, e1), op::flow_from(a, e2)) |
+      op::for_each(mi::MAKE(receiver)(
+          [&](int) { ++count; },
+          [&](auto) noexcept { ++done; },
+          [&]() { ++done; }));
+
+  while (done.load() == 0) {
+    std::this_thread::yield();
+  }
+  t0.join();
+  t1.join();
+  t2.join();
+
+  EXPECT_THAT(count.load(), Eq(300))
+      << "expected that every value from every input is delivered once";
+}
+
+TEST_F(MergeFlowManySender, FlatMap) {
+  std::array<int, 4> a{{0, 1, 2, 3}};
+  std::vector<std::pair<int, mi::any_receiver<std::exception_ptr, int>>> inners;
+
+  op::flow_from(a) | op::flat_map<int>(
+                         [&](int v) {
+                           return mi::MAKE(single_sender)([&inners, v](auto out) {
+                             inners.emplace_back(
+                                 v,
+                                 mi::any_receiver<std::exception_ptr, int>{
+                                     std::move(out)});
+                           });
+                         },
+                         2) |
+      op::submit(make_consumer());
+  ::mi::set_value(up_, 10);
+
+  EXPECT_THAT(inners.size(), Eq(2u))
+      << "expected that only two inner senders are submitted at a time";
+
+  ::mi::set_value(inners[1].second, inners[1].first * 10);
+  ::mi::set_value(inners[0].second, inners[0].first * 10);
+  EXPECT_THAT(inners.size(), Eq(4u))
+      << "expected that a completed inner sender frees a slot";
+
+  ::mi::set_value(inners[3].second, inners[3].first * 10);
+  ::mi::set_value(inners[2].second, inners[2].first * 10);
+
+  EXPECT_THAT(values_, ElementsAre(10, 0, 30, 20))
+      << "expected that values are delivered in the order they complete";
+  EXPECT_THAT(dones_, Eq(1));
+}
+
+TEST_F(MergeFlowManySender, ConcatMap) {
+  std::array<int, 4> a{{0, 1, 2, 3}};
+  std::vector<std::pair<int, mi::any_receiver<std::exception_ptr, int>>> inners;
+
+  op::flow_from(a) | op::concat_map<int>(
+                         [&](int v) {
+                           return mi::MAKE(single_sender)([&inners, v](auto out) {
+                             inners.emplace_back(
+                                 v,
+                                 mi::any_receiver<std::exception_ptr, int>{
+                                     std::move(out)});
+                           });
+                         },
+                         2) |
+      op::submit(make_consumer());
+  ::mi::set_value(up_, 10);
+
+  ::mi::set_value(inners[1].second, inners[1].first * 10);
+  EXPECT_THAT(values_, IsEmpty())
+      << "expected that a value is held until the earlier inner completes";
+  EXPECT_THAT(inners.size(), Eq(2u))
+      << "expected that a held value keeps its slot";
+
+  ::mi::set_value(inners[0].second, inners[0].first * 10);
+  ::mi::set_value(inners[3].second, inners[3].first * 10);
+  ::mi::set_value(inners[2].second, inners[2].first * 10);
+
+  EXPECT_THAT(values_, ElementsAre(0, 10, 20, 30))
+      << "expected that values are delivered in source order";
+  EXPECT_THAT(dones_, Eq(1));
+}
+
+TEST(FlowManySender, ParallelTransform) {
+  auto nt = mi::new_thread();
+  std::array<int, 50> a;
+  std::iota(a.begin(), a.end(), 0);
+  std::atomic<int> active{0};
+  std::atomic<int> peak{0};
+  auto f = [&](int v) {
+    auto now = ++active;
+    auto seen = peak.load();
+    while (now > seen && !peak.compare_exchange_weak(seen, now)) {
+    }
+    // later values finish first
+    std::this_thread::sleep_for(std::chrono::microseconds(50 - v));
+    --active;
+    return v * 2;
+  };
+
+  std::vector<int> ordered;
+  std::atomic<int> done{0};
+  op::flow_from(a) | op::parallel_transform<int>(nt, 4, f) |
+      op::for_each(mi::MAKE(receiver)(
+          [&](int v) { ordered.push_back(v); },
+          [&](auto) noexcept { ++done; },
+          [&]() { ++done; }));
+  while (done.load() == 0) {
+    std::this_thread::yield();
+  }
+
+  std::vector<int> expected(a.size());
+  std::transform(a.begin(), a.end(), expected.begin(), [](int v) {
+    return v * 2;
+  });
+  EXPECT_THAT(ordered, Eq(expected))
+      << "expected that the results are delivered in the order of the values";
+  EXPECT_THAT(peak.load(), Le(4)) << "expected at most 4 calls in flight";
+
+  std::vector<int> unordered;
+  done = 0;
+  op::flow_from(a) | op::parallel_transform_unordered<int>(nt, 4, f) |
+      op::for_each(mi::MAKE(receiver)(
+          [&](int v) { unordered.push_back(v); },
+          [&](auto) noexcept { ++done; },
+          [&]() { ++done; }));
+  while (done.load() == 0) {
+    std::this_thread::yield();
+  }
+
+  EXPECT_THAT(unordered, UnorderedElementsAreArray(expected))
+      << "expected that every result is delivered once";
+
+  std::atomic<int> errors{0};
+  done = 0;
+  op::flow_from(a) |
+      op::parallel_transform<int>(
+          nt,
+          4,
+          [](int v) {
+            if (v == 10) {
+              throw std::runtime_error("ten");
+            }
+            return v;
+          }) |
+      op::for_each(mi::MAKE(receiver)(
+          [&](int) {},
+          [&](auto) noexcept {
+            ++errors;
+            ++done;
+          },
+          [&]() { ++done; }));
+  while (done.load() == 0) {
+    std::this_thread::yield();
+  }
+
+  EXPECT_THAT(errors.load(), Eq(1))
+      << "expected that the exception from f was delivered as the error";
+}
@@ -14,16 +14,23 @@
  * limitations under the License.
  */
 
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <thread>
 #include <type_traits>
+#include <vector>
 
 #include <chrono>
 using namespace std::literals;
 
+#include <pushmi/flow_many_sender.h>
 #include <pushmi/flow_single_sender.h>
 #include <pushmi/o/submit.h>
 
 #include <pushmi/entangle.h>
 #include <pushmi/new_thread.h>
+#include <pushmi/stop_token.h>
 #include <pushmi/time_source.h>
 #include <pushmi/trampoline.h>
 
@@ -361,3 +368,121 @@ TEST_F(ConcurrentFlowSingleSender, RacingEntangledCancellation) {
 
   join();
 }
+
+TEST(StopToken, FlowSingleCancellation) {
+  int signals = 0;
+  int callbacks = 0;
+  auto f = mi::MAKE(flow_single_sender)([&](auto out) {
+    mi::stop_source source;
+    auto token = source.get_token();
+    mi::stop_callback<std::function<void()>> callback{token,
+                                                      [&] { ++callbacks; }};
+
+    // pass the stop source as the up receiver for cancellation.
+    ::mi::set_starting(out, source);
+
+    if (!token.stop_requested()) {
+      ::mi::set_value(out, 42);
+    } else {
+      // cancellation is not an error
+      ::mi::set_done(out);
+    }
+  });
+
+  f | op::submit(mi::MAKE(flow_receiver)(
+          mi::on_value([&](int) { signals += 100; }),
+          mi::on_error([&](auto) noexcept { signals += 1000; }),
+          mi::on_done([&]() { signals += 1; }),
+          mi::on_starting([&](auto up) {
+            signals += 10;
+            ::mi::set_done(up);
+          })));
+
+  EXPECT_THAT(signals, Eq(11))
+      << "expected that the starting and done signals are each recorded once";
+  EXPECT_THAT(callbacks, Eq(1)) << "expected that the callback ran once";
+
+  mi::stop_source source;
+  {
+    mi::stop_callback<std::function<void()>> unregistered{source.get_token(),
+                                                          [&] { ++callbacks; }};
+  }
+  EXPECT_THAT(source.request_stop(), Eq(true));
+  EXPECT_THAT(source.request_stop(), Eq(false))
+      << "expected that only the first request stops";
+  EXPECT_THAT(callbacks, Eq(1))
+      << "expected that a destroyed callback is not called";
+
+  mi::stop_source requests;
+  auto token = requests.get_token();
+  ::mi::set_value(requests, 2);
+  ::mi::set_value(requests, 3);
+  EXPECT_THAT(token.take_requested(), Eq(5))
+      << "expected that the requests through the source are recorded";
+  EXPECT_THAT(token.take_requested(), Eq(0))
+      << "expected that the recorded requests are taken once";
+}
+
+// records whether connect was given the data of the sender as an lvalue
+// or as an rvalue
+template <class Data>
+struct connect_sf {
+  template <class Out>
+  void operator()(Data&, Out) {}
+  template <class Out>
+  std::string connect(Data&, Out) {
+    return "lvalue";
+  }
+  template <class Out>
+  std::string connect(Data&&, Out) {
+    return "rvalue";
+  }
+};
+
+TEST(FlowSender, ConnectMovesDataFromRvalue) {
+  using single_data = mi::flow_single_sender<>;
+  auto single = mi::flow_single_sender<single_data, connect_sf<single_data>>{
+      single_data{}, connect_sf<single_data>{}};
+  EXPECT_THAT(mi::connect(single, mi::receiver<>{}), Eq("lvalue"));
+  EXPECT_THAT(mi::connect(std::move(single), mi::receiver<>{}), Eq("rvalue"))
+      << "expected that an rvalue flow_single_sender moves its data";
+
+  using many_data = mi::flow_many_sender<>;
+  auto many = mi::flow_many_sender<many_data, connect_sf<many_data>>{
+      many_data{}, connect_sf<many_data>{}};
+  EXPECT_THAT(mi::connect(many, mi::receiver<>{}), Eq("lvalue"));
+  EXPECT_THAT(mi::connect(std::move(many), mi::receiver<>{}), Eq("rvalue"))
+      << "expected that an rvalue flow_many_sender moves its data";
+}
+
+TEST(Entangle, LockBothUnderContention) {
+  // twice as many threads as cores, so that the threads that wait for the
+  // other side of a pair are often descheduled.
+  const int pairs = std::max(1u, std::thread::hardware_concurrency());
+  const int iterations = 2'000;
+  using Pair = decltype(mi::entangle(0, 0));
+  std::vector<std::unique_ptr<Pair>> entangled;
+  std::vector<std::thread> threads;
+  for (int p = 0; p < pairs; ++p) {
+    entangled.push_back(std::make_unique<Pair>(mi::entangle(0, 0)));
+  }
+  auto run = [&](auto& side) {
+    for (int i = 0; i < iterations; ++i) {
+      auto both = lock_both(side);
+      ++*both.first;
+      ++*both.second;
+    }
+  };
+  for (auto& e : entangled) {
+    threads.emplace_back([&, p = e.get()] { run(p->first); });
+    threads.emplace_back([&, p = e.get()] { run(p->second); });
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+  for (auto& e : entangled) {
+    EXPECT_THAT(e->first.t, Eq(2 * iterations))
+        << "expected that both sides were never locked at the same time";
+    EXPECT_THAT(e->second.t, Eq(2 * iterations));
+  }
+}
@@ -0,0 +1,227 @@
+/*
+ * Copyright 2018-present Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <chrono>
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std::literals;
+
+#include <pushmi/o/schedule.h>
+#include <pushmi/o/submit.h>
+#include <pushmi/o/transform.h>
+
+#include <pushmi/io_context.h>
+
+using namespace pushmi::aliases;
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+using namespace testing;
+
+namespace net = std::experimental::net;
+using tcp = net::ip::tcp;
+
+class IoContext : public Test {
+ protected:
+  net::io_context io_;
+  mi::io_context_executor ex_{io_};
+};
+
+TEST_F(IoContext, ScheduleRunsOnRunThread) {
+  static_assert(
+      mi::TimeExecutor<mi::io_context_executor, mi::is_concurrent_sequence<>>,
+      "expected the io_context executor to be a time executor");
+
+  int signals = 0;
+  std::thread::id ran;
+  ex_ | op::schedule() |
+      op::submit(
+          [&](auto ex) {
+            ran = std::this_thread::get_id();
+            EXPECT_THAT(ex == ex_, Eq(true));
+            signals += 100;
+          },
+          [&](auto) noexcept { signals += 1000; },
+          [&]() { signals += 10; });
+
+  EXPECT_THAT(signals, Eq(0))
+      << "expected that nothing runs until the io_context is run";
+  io_.run();
+  EXPECT_THAT(signals, Eq(110));
+  EXPECT_THAT(ran, Eq(std::this_thread::get_id()));
+}
+
+TEST_F(IoContext, TimersAreOrderedInTime) {
+  std::vector<std::string> times;
+  auto push = [&](int time) {
+    return v::on_value([&, time](auto) {
+      times.push_back(std::to_string(time));
+    });
+  };
+  auto start = mi::now(ex_);
+  ex_ | op::schedule_after(40ms) | op::submit(push(40));
+  ex_ | op::schedule_at(start + 10ms) | op::submit(push(10));
+  ex_ | op::schedule_after(20ms) | op::submit(push(20));
+  ex_ | op::schedule() | op::submit(push(0));
+  io_.run();
+
+  EXPECT_THAT(times, ElementsAre("0", "10", "20", "40"))
+      << "expected that the items were pushed in time order not insertion order";
+  EXPECT_THAT(mi::now(ex_) - start, Ge(40ms));
+}
+
+template <class T>
+struct counting_allocator {
+  using value_type = T;
+
+  explicit counting_allocator(int& c) : count(&c) {}
+  template <class U>
+  counting_allocator(const counting_allocator<U>& o) : count(o.count) {}
+
+  T* allocate(std::size_t n) {
+    ++*count;
+    return std::allocator<T>{}.allocate(n);
+  }
+  void deallocate(T* p, std::size_t n) {
+    std::allocator<T>{}.deallocate(p, n);
+  }
+
+  int* count;
+};
+template <class T, class U>
+bool operator==(const counting_allocator<T>& l, const counting_allocator<U>& r) {
+  return l.count == r.count;
+}
+template <class T, class U>
+bool operator!=(const counting_allocator<T>& l, const counting_allocator<U>& r) {
+  return !(l == r);
+}
+
+struct allocating_receiver {
+  using properties = mi::property_set<mi::is_receiver<>>;
+
+  int* allocations;
+  int* signals;
+
+  counting_allocator<char> get_allocator() const {
+    return counting_allocator<char>{*allocations};
+  }
+  template <class V>
+  void value(V&&) {
+    *signals += 100;
+  }
+  template <class E>
+  void error(E) noexcept {
+    *signals += 1000;
+  }
+  void done() {
+    *signals += 10;
+  }
+};
+
+TEST_F(IoContext, TimerUsesReceiverAllocator) {
+  int allocations = 0;
+  int signals = 0;
+  ex_ | op::schedule_after(1ms) |
+      op::submit(allocating_receiver{&allocations, &signals});
+  io_.run();
+
+  EXPECT_THAT(signals, Eq(110));
+  EXPECT_THAT(allocations, Ge(2))
+      << "expected that the timer and the wait were allocated with the "
+         "receiver allocator";
+}
+
+TEST_F(IoContext, Loopback) {
+  tcp::acceptor acceptor{io_, tcp::endpoint{net::ip::address_v4::loopback(), 0}};
+  tcp::socket client{io_};
+  std::vector<tcp::socket> accepted;
+  std::vector<tcp::endpoint> connected;
+
+  mi::async_accept(acceptor) | op::submit([&](tcp::socket s) {
+    accepted.push_back(std::move(s));
+  });
+  mi::async_connect(client, acceptor.local_endpoint()) |
+      op::submit([&](tcp::endpoint ep) { connected.push_back(ep); });
+  io_.run();
+  io_.restart();
+
+  ASSERT_THAT(accepted.size(), Eq(1u));
+  ASSERT_THAT(connected.size(), Eq(1u));
+  EXPECT_THAT(connected[0] == acceptor.local_endpoint(), Eq(true));
+
+  std::size_t written = 0;
+  mi::async_write_some(client, net::buffer("hello", 5)) |
+      op::submit([&](std::size_t n) { written = n; });
+
+  char buffer[16] = {};
+  std::string received;
+  int signals = 0;
+  mi::async_read_some(accepted[0], net::buffer(buffer)) |
+      op::transform([&](std::size_t n) { return std::string(buffer, n); }) |
+      op::submit(
+          [&](std::string s) {
+            received = s;
+            signals += 100;
+          },
+          [&](auto) noexcept { signals += 1000; },
+          [&]() { signals += 10; });
+  io_.run();
+  io_.restart();
+
+  EXPECT_THAT(written, Eq(5u));
+  EXPECT_THAT(received, Eq("hello"));
+  EXPECT_THAT(signals, Eq(110));
+
+  client.close();
+  signals = 0;
+  mi::async_read_some(accepted[0], net::buffer(buffer)) |
+      op::submit(
+          [&](std::size_t) { signals += 100; },
+          [&](auto) noexcept { signals += 1000; },
+          [&]() { signals += 10; });
+  io_.run();
+  EXPECT_THAT(signals, Eq(10))
+      << "expected that a read at the end of the stream is done";
+}
+
+TEST_F(IoContext, ErrorsAreSystemErrors) {
+  tcp::acceptor acceptor{io_, tcp::endpoint{net::ip::address_v4::loopback(), 0}};
+  auto endpoint = acceptor.local_endpoint();
+  acceptor.close();
+
+  tcp::socket client{io_};
+  std::string what;
+  mi::async_connect(client, endpoint) |
+      op::submit(
+          [&](tcp::endpoint) { what = "connected"; },
+          [&](std::exception_ptr e) noexcept {
+            try {
+              std::rethrow_exception(e);
+            } catch (const std::system_error& error) {
+              what = error.code() == std::errc::connection_refused
+                  ? "refused"
+                  : error.what();
+            }
+          });
+  io_.run();
+  EXPECT_THAT(what, Eq("refused"));
+}
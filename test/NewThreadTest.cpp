@@ -17,18 +17,27 @@
 #include <chrono>
 #include <type_traits>
 #include <string>
+#include <tuple>
 using namespace std::literals;
 
+#include <pushmi/flow_many_sender.h>
 #include <pushmi/flow_single_sender.h>
+#include <pushmi/o/buffer.h>
 #include <pushmi/o/empty.h>
 #include <pushmi/o/extension_operators.h>
+#include <pushmi/o/from.h>
 #include <pushmi/o/just.h>
 #include <pushmi/o/on.h>
+#include <pushmi/o/retry.h>
 #include <pushmi/o/submit.h>
 #include <pushmi/o/tap.h>
+#include <pushmi/o/throttle.h>
+#include <pushmi/o/timeout.h>
 #include <pushmi/o/transform.h>
 #include <pushmi/o/via.h>
+#include <pushmi/o/when_all.h>
 
+#include <pushmi/instrumented.h>
 #include <pushmi/new_thread.h>
 #include <pushmi/strand.h>
 #include <pushmi/time_source.h>
@@ -132,6 +141,32 @@ TEST_F(NewthreadExecutor, SubmissionsAreOrderedInTime) {
       << "expected that the items were pushed in time order not insertion order";
 }
 
+TEST_F(NewthreadExecutor, ConnectedTimersAreOrderedInTime) {
+  std::vector<std::string> times;
+  std::atomic<int> pushed{0};
+  auto push = [&](int time) {
+    return v::make_receiver([&, time](auto) {
+      times.push_back(std::to_string(time));
+      ++pushed;
+    });
+  };
+  auto now = v::now(tnt_);
+  // the timer nodes are the operation states on this stack
+  auto op40 = mi::connect(tnt_ | op::schedule_at(now + 40ms), push(40));
+  auto op10 = mi::connect(tnt_ | op::schedule_at(now + 10ms), push(10));
+  auto op20 = mi::connect(tnt_ | op::schedule_at(now + 20ms), push(20));
+  mi::start(op40);
+  mi::start(op10);
+  mi::start(op20);
+
+  while (pushed.load() < 3) {
+    std::this_thread::yield();
+  }
+
+  EXPECT_THAT(times, ElementsAre("10", "20", "40"))
+      << "expected that the connected timers fired in time order";
+}
+
 TEST_F(NewthreadExecutor, NowIsCalled) {
   bool done = false;
   tnt_ | ep::now();
@@ -219,3 +254,612 @@ TEST_F(NewthreadExecutor, UsedWithVia) {
   EXPECT_THAT(values, ElementsAre(std::to_string(2.0)))
       << "expected that only the first item was pushed";
 }
+
+TEST_F(NewthreadExecutor, ConnectAndStart) {
+  std::vector<std::string> values;
+  std::atomic<int> dones{0};
+  auto sender = ::pushmi::make_single_sender([](auto out) {
+    ::pushmi::set_value(out, 2.0);
+    ::pushmi::set_done(out);
+  });
+  auto via = sender | op::via(mi::strands(nt_));
+  auto out = v::make_receiver(
+      [&](auto v) { values.push_back(std::to_string(v)); },
+      [&](auto) noexcept { ++dones; },
+      [&]() { ++dones; });
+
+  // the receiver lives in the operation state instead of a shared_ptr
+  auto op = mi::connect(via, std::move(out));
+  EXPECT_THAT(values, IsEmpty()) << "expected that connect does not start";
+  mi::start(op);
+  while (dones.load() < 1) {
+    std::this_thread::yield();
+  }
+
+  EXPECT_THAT(values, ElementsAre(std::to_string(2.0)))
+      << "expected that the value was delivered through the operation state";
+
+  // senders that only support submit get an operation state that submits
+  int value = 0;
+  auto just = mi::connect(op::just(7), v::make_receiver([&](int v) {
+                            value = v;
+                          }));
+  mi::start(just);
+  EXPECT_THAT(value, Eq(7));
+}
+
+TEST_F(NewthreadExecutor, BufferTime) {
+  std::vector<std::vector<int>> buffers;
+  std::atomic<int> flushed{0};
+  v::any_receiver<std::exception_ptr, int> in;
+
+  auto source = v::make_many_sender([&](auto out) {
+    in = v::any_receiver<std::exception_ptr, int>{std::move(out)};
+  });
+  source | op::buffer_time<int>(50ms, tnt_) |
+      op::submit([&](std::vector<int> b) {
+        buffers.push_back(std::move(b));
+        ++flushed;
+      });
+
+  ::mi::set_value(in, 1);
+  ::mi::set_value(in, 2);
+  while (flushed.load() < 1) {
+    std::this_thread::yield();
+  }
+  ::mi::set_value(in, 3);
+  ::mi::set_done(in);
+
+  EXPECT_THAT(buffers, ElementsAre(ElementsAre(1, 2), ElementsAre(3)))
+      << "expected that the timer flushed the first buffer and done flushed the second";
+}
+
+TEST_F(NewthreadExecutor, Throttle) {
+  std::vector<int> debounced, first, last;
+  std::atomic<int> delivered{0};
+  v::any_receiver<std::exception_ptr, int> in;
+
+  auto source = v::make_many_sender([&](auto out) {
+    in = v::any_receiver<std::exception_ptr, int>{std::move(out)};
+  });
+  auto record = [&](std::vector<int>& values) {
+    return [&values, &delivered](int v) {
+      values.push_back(v);
+      ++delivered;
+    };
+  };
+
+  source | op::debounce<int>(50ms, tnt_) | op::submit(record(debounced));
+  ::mi::set_value(in, 1);
+  ::mi::set_value(in, 2);
+  ::mi::set_value(in, 3);
+  while (delivered.load() < 1) {
+    std::this_thread::yield();
+  }
+  ::mi::set_done(in);
+
+  EXPECT_THAT(debounced, ElementsAre(3))
+      << "expected that only the value after the quiet period was delivered";
+
+  delivered = 0;
+  source | op::throttle_first<int>(50ms, tnt_) | op::submit(record(first));
+  ::mi::set_value(in, 1);
+  ::mi::set_value(in, 2);
+  ::mi::set_value(in, 3);
+  ::mi::set_done(in);
+
+  EXPECT_THAT(first, ElementsAre(1))
+      << "expected that the values within the duration were dropped";
+
+  delivered = 0;
+  source | op::throttle_last<int>(50ms, tnt_) | op::submit(record(last));
+  ::mi::set_value(in, 1);
+  ::mi::set_value(in, 2);
+  while (delivered.load() < 1) {
+    std::this_thread::yield();
+  }
+  ::mi::set_value(in, 3);
+  ::mi::set_done(in);
+
+  EXPECT_THAT(last, ElementsAre(2, 3))
+      << "expected that the latest value was delivered by the timer and by done";
+}
+
+TEST_F(NewthreadExecutor, ThrottleCancel) {
+  std::atomic<int> values{0};
+  std::atomic<int> dones{0};
+  std::atomic<int> cancelled{0};
+  v::any_receiver<std::exception_ptr, int> in;
+  v::any_receiver<std::exception_ptr, std::ptrdiff_t> up;
+
+  auto source = v::make_flow_many_sender([&](auto out) {
+    ::mi::set_starting(
+        out,
+        v::make_receiver(
+            [](std::ptrdiff_t) {},
+            [&](auto) noexcept { ++cancelled; },
+            [&]() { ++cancelled; }));
+    in = v::any_receiver<std::exception_ptr, int>{std::move(out)};
+  });
+  source | op::debounce<int>(20ms, tnt_) |
+      op::submit(v::make_flow_receiver(
+          v::on_value([&](int) { ++values; }),
+          v::on_error([&](auto) noexcept { ++dones; }),
+          v::on_done([&]() { ++dones; }),
+          v::on_starting([&](auto u) {
+            up = v::any_receiver<std::exception_ptr, std::ptrdiff_t>{
+                std::move(u)};
+            ::mi::set_value(up, 10);
+          })));
+
+  ::mi::set_value(in, 1);
+  ::mi::set_done(up);
+  std::this_thread::sleep_for(60ms);
+  ::mi::set_done(in);
+
+  EXPECT_THAT(cancelled.load(), Eq(1))
+      << "expected that the input was cancelled once";
+  EXPECT_THAT(values.load(), Eq(0))
+      << "expected that the pending value was dropped when the output cancelled";
+  EXPECT_THAT(dones.load(), Eq(0))
+      << "expected that the output was not signalled after it cancelled";
+}
+
+// a time executor that fails to schedule every timer
+struct failing_time_executor {
+  using properties = mi::property_set<mi::is_time<>, mi::is_fifo_sequence<>>;
+
+  std::chrono::system_clock::time_point top() {
+    return std::chrono::system_clock::now();
+  }
+  auto schedule(std::chrono::system_clock::time_point) {
+    return v::make_single_sender([](auto out) {
+      ::mi::set_error(
+          out, std::make_exception_ptr(std::runtime_error{"no timer"}));
+    });
+  }
+  auto schedule() {
+    return schedule(top());
+  }
+};
+
+TEST_F(NewthreadExecutor, ThrottleTimerError) {
+  std::atomic<int> values{0};
+  std::atomic<int> errors{0};
+  std::atomic<int> cancelled{0};
+  v::any_receiver<std::exception_ptr, int> in;
+
+  auto source = v::make_flow_many_sender([&](auto out) {
+    ::mi::set_starting(
+        out,
+        v::make_receiver(
+            [](std::ptrdiff_t) {},
+            [&](auto) noexcept { ++cancelled; },
+            [&]() { ++cancelled; }));
+    in = v::any_receiver<std::exception_ptr, int>{std::move(out)};
+  });
+  source | op::debounce<int>(20ms, failing_time_executor{}) |
+      op::submit(v::make_flow_receiver(
+          v::on_value([&](int) { ++values; }),
+          v::on_error([&](auto) noexcept { ++errors; }),
+          v::on_done([&]() { ++values; }),
+          v::on_starting([&](auto up) { ::mi::set_value(up, 10); })));
+
+  ::mi::set_value(in, 1);
+  ::mi::set_done(in);
+
+  EXPECT_THAT(errors.load(), Eq(1))
+      << "expected that the timer error was delivered";
+  EXPECT_THAT(cancelled.load(), Eq(1))
+      << "expected that the input was cancelled";
+  EXPECT_THAT(values.load(), Eq(0))
+      << "expected no value or done after the error";
+}
+
+TEST_F(NewthreadExecutor, BufferTimeTimerError) {
+  std::atomic<int> values{0};
+  std::atomic<int> errors{0};
+  std::atomic<int> cancelled{0};
+  v::any_receiver<std::exception_ptr, int> in;
+
+  auto source = v::make_flow_many_sender([&](auto out) {
+    ::mi::set_starting(
+        out,
+        v::make_receiver(
+            [](std::ptrdiff_t) {},
+            [&](auto) noexcept { ++cancelled; },
+            [&]() { ++cancelled; }));
+    in = v::any_receiver<std::exception_ptr, int>{std::move(out)};
+  });
+  source | op::buffer_time<int>(20ms, failing_time_executor{}) |
+      op::submit(v::make_flow_receiver(
+          v::on_value([&](std::vector<int>) { ++values; }),
+          v::on_error([&](auto) noexcept { ++errors; }),
+          v::on_done([&]() { ++values; }),
+          v::on_starting([&](auto up) { ::mi::set_value(up, 10); })));
+
+  ::mi::set_value(in, 1);
+  ::mi::set_done(in);
+
+  EXPECT_THAT(errors.load(), Eq(1))
+      << "expected that the timer error was delivered";
+  EXPECT_THAT(cancelled.load(), Eq(1))
+      << "expected that the input was cancelled";
+  EXPECT_THAT(values.load(), Eq(0))
+      << "expected no buffer or done after the error";
+}
+
+TEST_F(NewthreadExecutor, Timeout) {
+  std::atomic<int> values{0};
+  std::atomic<int> timeouts{0};
+  op::just(42) | op::timeout(50ms, tnt_) |
+      op::submit(
+          [&](int) { ++values; },
+          [&](auto e) noexcept {
+            try {
+              std::rethrow_exception(e);
+            } catch (const mi::timeout_error&) {
+              ++timeouts;
+            }
+          });
+
+  EXPECT_THAT(values.load(), Eq(1)) << "expected the value to win the race";
+
+  std::atomic<int> cancelled{0};
+  auto never = v::make_flow_single_sender([&](auto out) {
+    // pass reference for cancellation, never deliver a value
+    ::mi::set_starting(
+        out,
+        v::make_receiver(
+            [](std::ptrdiff_t) {},
+            [&](auto) noexcept { ++cancelled; },
+            [&]() { ++cancelled; }));
+  });
+  never | op::timeout(10ms, tnt_) |
+      op::submit(v::make_flow_receiver(
+          [&](int) { ++values; },
+          [&](auto e) noexcept {
+            try {
+              std::rethrow_exception(e);
+            } catch (const mi::timeout_error&) {
+              ++timeouts;
+            }
+          }));
+  while (timeouts.load() < 1) {
+    std::this_thread::yield();
+  }
+
+  EXPECT_THAT(values.load(), Eq(1)) << "expected that the timer won the race";
+  EXPECT_THAT(cancelled.load(), Eq(1))
+      << "expected that the input was cancelled once";
+
+  // the fixture joins the time_source, which would wait for a timer that was
+  // left pending
+  nt_ | op::schedule() | op::transform([](auto) { return 42; }) |
+      op::timeout(2s, tnt_) | op::submit([&](int) { ++values; });
+  while (values.load() < 2) {
+    std::this_thread::yield();
+  }
+  EXPECT_THAT(time_.stats().queued.load(), Eq(0u))
+      << "expected that the timer was removed when the value won";
+
+  // the output cancels, so the timer must not deliver a timeout to it
+  never | op::timeout(10ms, tnt_) |
+      op::submit(v::make_flow_receiver(
+          v::on_value([&](int) { ++values; }),
+          v::on_error([&](auto) noexcept { ++timeouts; }),
+          v::on_done([&]() { ++timeouts; }),
+          v::on_starting([&](auto up) { ::mi::set_done(up); })));
+  std::this_thread::sleep_for(30ms);
+  EXPECT_THAT(timeouts.load(), Eq(1))
+      << "expected that the output was not signalled after it cancelled";
+  EXPECT_THAT(cancelled.load(), Eq(2))
+      << "expected that the input was cancelled by the output";
+}
+
+TEST_F(NewthreadExecutor, Retry) {
+  std::atomic<int> attempts{0};
+  std::atomic<int> values{0};
+  std::atomic<int> errors{0};
+  std::atomic<int> dones{0};
+  auto fails_twice = v::make_single_sender([&](auto out) {
+    if (++attempts < 3) {
+      ::mi::set_error(out, std::make_exception_ptr(std::runtime_error{"no"}));
+      return;
+    }
+    ::mi::set_value(out, 42);
+    ::mi::set_done(out);
+  });
+
+  mi::retry_policy policy;
+  policy.initial_delay = 1ms;
+  policy.jitter = 0.5;
+  auto start = std::chrono::steady_clock::now();
+  fails_twice | op::retry(policy, tnt_) |
+      op::submit(
+          [&](int) { ++values; },
+          [&](auto) noexcept { ++errors; },
+          [&]() { ++dones; });
+  while (dones.load() + errors.load() < 1) {
+    std::this_thread::yield();
+  }
+  auto elapsed = std::chrono::steady_clock::now() - start;
+
+  EXPECT_THAT(attempts.load(), Eq(3));
+  EXPECT_THAT(elapsed, Ge(policy.initial_delay))
+      << "expected that the attempts were delayed";
+  EXPECT_THAT(values.load(), Eq(1)) << "expected the third attempt to succeed";
+  EXPECT_THAT(errors.load(), Eq(0));
+
+  attempts = 0;
+  policy.max_attempts = 2;
+  fails_twice | op::retry(policy, tnt_) |
+      op::submit(
+          [&](int) { ++values; },
+          [&](auto) noexcept { ++errors; },
+          [&]() { ++dones; });
+  while (errors.load() < 1) {
+    std::this_thread::yield();
+  }
+
+  EXPECT_THAT(attempts.load(), Eq(2))
+      << "expected that the error is delivered after the last attempt";
+}
+
+TEST_F(NewthreadExecutor, WhenAllWhenAny) {
+  std::atomic<int> dones{0};
+  int i = 0;
+  std::string s;
+  op::when_all<int, std::string>(
+      nt_ | op::schedule() | op::transform([](auto) { return 42; }),
+      op::just("ok"s)) |
+      op::submit(
+          [&](std::tuple<int, std::string> v) {
+            i = std::get<0>(v);
+            s = std::get<1>(v);
+          },
+          [&](auto) noexcept { ++dones; },
+          [&]() { ++dones; });
+  while (dones.load() < 1) {
+    std::this_thread::yield();
+  }
+
+  EXPECT_THAT(i, Eq(42));
+  EXPECT_THAT(s, Eq("ok"s)) << "expected the values of both senders";
+
+  std::atomic<int> cancelled{0};
+  auto never = v::make_flow_single_sender([&](auto out) {
+    using Out = decltype(out);
+    auto p = std::make_shared<Out>(std::move(out));
+    ::mi::set_starting(
+        *p,
+        v::make_receiver(
+            [](std::ptrdiff_t) {},
+            [](auto) noexcept {},
+            [&cancelled, p]() {
+              ++cancelled;
+              ::mi::set_done(*p);
+            }));
+  });
+  int first = 0;
+  op::when_any(never, op::just(7)) | op::submit([&](int v) { first = v; });
+
+  EXPECT_THAT(first, Eq(7)) << "expected the first value to win";
+  EXPECT_THAT(cancelled.load(), Eq(1))
+      << "expected that the losing flow sender was cancelled";
+
+  cancelled = 0;
+  auto winner = v::make_flow_single_sender([&](auto out) {
+    ::mi::set_starting(
+        out,
+        v::make_receiver(
+            [](std::ptrdiff_t) {},
+            [](auto) noexcept {},
+            [&cancelled]() { cancelled += 100; }));
+    ::mi::set_value(out, 8);
+    ::mi::set_done(out);
+  });
+  op::when_any(winner, never) | op::submit([&](int v) { first = v; });
+
+  EXPECT_THAT(first, Eq(8));
+  EXPECT_THAT(cancelled.load(), Eq(1))
+      << "expected that only the loser was cancelled, not the winner";
+}
+
+template <class T>
+struct counting_allocator {
+  using value_type = T;
+
+  explicit counting_allocator(std::atomic<int>& c) : count(&c) {}
+  template <class U>
+  counting_allocator(const counting_allocator<U>& o) : count(o.count) {}
+
+  T* allocate(std::size_t n) {
+    ++*count;
+    return std::allocator<T>{}.allocate(n);
+  }
+  void deallocate(T* p, std::size_t n) {
+    std::allocator<T>{}.deallocate(p, n);
+  }
+
+  std::atomic<int>* count;
+};
+template <class T, class U>
+bool operator==(const counting_allocator<T>& l, const counting_allocator<U>& r) {
+  return l.count == r.count;
+}
+template <class T, class U>
+bool operator!=(const counting_allocator<T>& l, const counting_allocator<U>& r) {
+  return !(l == r);
+}
+
+// a receiver that asks for its state to be allocated with a
+// counting_allocator
+struct allocating_receiver {
+  using properties = mi::property_set<mi::is_receiver<>>;
+
+  std::atomic<int>* allocations;
+  std::atomic<int>* dones;
+
+  counting_allocator<char> get_allocator() const {
+    return counting_allocator<char>{*allocations};
+  }
+  template <class V>
+  void value(V&&) {}
+  template <class E>
+  void error(E) noexcept {
+    ++*dones;
+  }
+  void done() {
+    ++*dones;
+  }
+};
+
+struct allocating_flow_receiver : allocating_receiver {
+  using properties = mi::property_set<mi::is_receiver<>, mi::is_flow<>>;
+
+  explicit allocating_flow_receiver(allocating_receiver r)
+      : allocating_receiver(r) {}
+
+  template <class Up>
+  void starting(Up up) {
+    ::mi::set_value(up, std::numeric_limits<std::ptrdiff_t>::max());
+  }
+};
+
+TEST_F(NewthreadExecutor, AllocatorsAreUsed) {
+  std::atomic<int> allocations{0};
+  std::atomic<int> dones{0};
+  auto wait = [&](int n) {
+    while (dones.load() < n) {
+      std::this_thread::yield();
+    }
+  };
+
+  tnt_ | op::schedule() | op::submit(allocating_receiver{&allocations, &dones});
+  wait(1);
+  EXPECT_THAT(allocations.load(), Eq(1))
+      << "expected that the timer node was allocated with the receiver allocator";
+
+  allocations = 0;
+  op::just(42) | op::via(mi::strands(nt_)) |
+      op::submit(allocating_receiver{&allocations, &dones});
+  wait(2);
+  EXPECT_THAT(allocations.load(), Eq(1))
+      << "expected that via allocated the receiver with its allocator";
+
+  std::atomic<int> queues{0};
+  auto strands = mi::strands(nt_, counting_allocator<char>{queues});
+  EXPECT_THAT(queues.load(), Eq(1))
+      << "expected that the strand stats were allocated with the allocator";
+  auto strand = mi::make_strand(strands);
+  EXPECT_THAT(queues.load(), Eq(2))
+      << "expected that the strand queue was allocated with the allocator";
+  (void)strand;
+
+  allocations = 0;
+  int values[] = {1, 2, 3};
+  op::flow_from(values) |
+      op::submit(allocating_flow_receiver{{&allocations, &dones}});
+  wait(3);
+  EXPECT_THAT(allocations.load(), Eq(1))
+      << "expected that flow_from allocated the producer with the receiver allocator";
+
+  std::atomic<int> shared{0};
+  {
+    mi::time_source<
+        std::exception_ptr,
+        std::chrono::system_clock::time_point,
+        counting_allocator<char>>
+        t{counting_allocator<char>{shared}};
+    auto tstrands = t.make(mi::systemNowF{}, nt_);
+    (void)tstrands;
+    t.join();
+  }
+  EXPECT_THAT(shared.load(), Eq(2))
+      << "expected that the time_source state and queue used the allocator";
+}
+
+TEST_F(NewthreadExecutor, Instrumented) {
+  auto stats = std::make_shared<mi::executor_stats>();
+  auto itnt = mi::instrumented(tnt_, stats);
+  static_assert(
+      mi::TimeExecutor<decltype(itnt), mi::is_fifo_sequence<>>,
+      "expected the instrumented time executor to be a time executor");
+
+  auto start = mi::now(itnt);
+  itnt | op::schedule_after(10ms) | op::blocking_submit(v::on_value([](auto) {
+    std::this_thread::sleep_for(5ms);
+  }));
+  auto delay = stats->queue_delay();
+  auto run = stats->run_time();
+  EXPECT_THAT(delay.count, Eq(1u));
+  EXPECT_THAT(delay.max_ns, Ge(std::uint64_t(9'000'000)))
+      << "expected that the time until the timer fired was queue delay";
+  EXPECT_THAT(run.max_ns, Ge(std::uint64_t(4'000'000)))
+      << "expected that the time in the receiver was run time";
+  EXPECT_THAT(delay.percentile_ns(50), Ge(std::uint64_t(9'000'000)));
+  EXPECT_THAT(mi::now(itnt), Ge(start));
+
+  auto strands = mi::strands(nt_);
+  auto strand = mi::make_strand(strands);
+  auto istrand = mi::instrumented(strand, stats.get());
+  static_assert(
+      mi::Strand<decltype(istrand)>,
+      "expected the instrumented strand to be a strand");
+  std::atomic<int> remaining{10};
+  for (int i = 0; i < 10; ++i) {
+    istrand | op::schedule() | op::submit([&](auto) { --remaining; });
+  }
+  while (stats->run_time().count < 11) {
+    std::this_thread::yield();
+  }
+  EXPECT_THAT(remaining.load(), Eq(0));
+  EXPECT_THAT(stats->queue_delay().count, Eq(11u));
+}
+
+TEST_F(NewthreadExecutor, QueueStats) {
+  auto& timers = time_.stats();
+  std::atomic<int> pushed{0};
+  tnt_ | op::schedule() | op::submit(v::on_value([&](auto tnt) {
+    tnt | op::schedule_after(10ms) | op::submit([&](auto) { ++pushed; });
+    tnt | op::schedule_after(20ms) | op::submit([&](auto) { ++pushed; });
+    tnt | op::schedule_after(20ms) | op::submit([&](auto) { ++pushed; });
+  }));
+  while (pushed.load() < 3 || timers.queued.load() != 0) {
+    std::this_thread::yield();
+  }
+  EXPECT_THAT(timers.enqueued.load(), Eq(4u));
+  EXPECT_THAT(timers.dispatched.load(), Eq(4u));
+  EXPECT_THAT(timers.batches.load(), AllOf(Ge(1u), Le(4u)))
+      << "expected that the timers due within 50ms share a dispatch";
+  EXPECT_THAT(timers.max_depth.load(), AllOf(Ge(3u), Le(4u)));
+  EXPECT_THAT(timers.fired_count.load(), Eq(4u))
+      << "expected that every fired timer recorded its lateness";
+  EXPECT_THAT(timers.max_late_ns.load(), Lt(std::uint64_t(1'000'000'000)));
+  EXPECT_THAT(
+      timers.mean_late().count(),
+      Le(static_cast<std::int64_t>(timers.max_late_ns.load())));
+
+  auto strands = mi::strands(nt_);
+  auto& drains = strands.stats();
+  auto first = mi::make_strand(strands);
+  auto second = mi::make_strand(strands);
+  std::atomic<int> remaining{10};
+  for (int i = 0; i < 5; ++i) {
+    first | op::schedule() | op::submit([&](auto) { --remaining; });
+    second | op::schedule() | op::submit([&](auto) { --remaining; });
+  }
+  while (remaining.load() != 0 || drains.queued.load() != 0) {
+    std::this_thread::yield();
+  }
+  EXPECT_THAT(drains.enqueued.load(), Eq(10u))
+      << "expected that the strands of a factory share their counts";
+  EXPECT_THAT(drains.batches.load(), AllOf(Ge(2u), Le(10u)));
+  EXPECT_THAT(drains.max_batch.load(), AllOf(Ge(1u), Le(5u)));
+  EXPECT_THAT(drains.max_depth.load(), AllOf(Ge(1u), Le(5u)));
+
+  drains.reset();
+  EXPECT_THAT(drains.enqueued.load(), Eq(0u));
+  EXPECT_THAT(drains.max_batch.load(), Eq(0u));
+}
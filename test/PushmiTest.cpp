@@ -21,6 +21,7 @@
 using namespace std::literals;
 
 #include <pushmi/flow_single_sender.h>
+#include <pushmi/o/buffer.h>
 #include <pushmi/o/empty.h>
 #include <pushmi/o/extension_operators.h>
 #include <pushmi/o/from.h>
@@ -165,3 +166,51 @@ TEST(FromIntManySender, TransformAndSubmit) {
 
   EXPECT_THAT(value, Eq(222)) << "expected a different result";
 }
+
+TEST(FromIntManySender, Buffer) {
+  std::array<int, 7> arr{{0, 1, 2, 3, 4, 5, 6}};
+
+  std::vector<std::vector<int>> buffers;
+  int signals = 0;
+  op::from(arr) | op::buffer<int>(3) |
+      op::submit(
+          [&](std::vector<int> b) { buffers.push_back(std::move(b)); },
+          [&](auto) noexcept { signals += 1000; },
+          [&]() { signals += 10; });
+
+  EXPECT_THAT(
+      buffers,
+      ElementsAre(
+          ElementsAre(0, 1, 2), ElementsAre(3, 4, 5), ElementsAre(6)))
+      << "expected full buffers followed by the values left over at done";
+  EXPECT_THAT(signals, Eq(10)) << "expected that done is signaled once";
+}
+
+TEST(FromIntManySender, Window) {
+  std::array<int, 5> arr{{0, 1, 2, 3, 4}};
+
+  std::vector<std::vector<int>> sliding;
+  op::from(arr) | op::window<int>(3, 1) |
+      op::submit([&](std::vector<int> w) { sliding.push_back(std::move(w)); });
+
+  EXPECT_THAT(
+      sliding,
+      ElementsAre(
+          ElementsAre(0, 1, 2), ElementsAre(1, 2, 3), ElementsAre(2, 3, 4)))
+      << "expected a window ending at each value once the first is full";
+
+  std::vector<std::vector<int>> tumbling;
+  op::from(arr) | op::window<int>(2) |
+      op::submit([&](std::vector<int> w) { tumbling.push_back(std::move(w)); });
+
+  EXPECT_THAT(tumbling, ElementsAre(ElementsAre(0, 1), ElementsAre(2, 3)))
+      << "expected that the incomplete window is not emitted";
+
+  std::vector<std::vector<int>> hopping;
+  op::from(arr) | op::window<int>(1, 2) |
+      op::submit([&](std::vector<int> w) { hopping.push_back(std::move(w)); });
+
+  EXPECT_THAT(
+      hopping, ElementsAre(ElementsAre(0), ElementsAre(2), ElementsAre(4)))
+      << "expected that the values between windows are dropped";
+}
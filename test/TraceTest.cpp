@@ -0,0 +1,137 @@
+/*
+ * Copyright 2018-present Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// the operators are only traced when every translation unit agrees, so this
+// test is built on its own
+#ifndef PUSHMI_TRACE
+#define PUSHMI_TRACE 1
+#endif
+
+#include <regex>
+#include <set>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <pushmi/o/filter.h>
+#include <pushmi/o/just.h>
+#include <pushmi/o/on.h>
+#include <pushmi/o/submit.h>
+#include <pushmi/o/tap.h>
+#include <pushmi/o/transform.h>
+#include <pushmi/o/via.h>
+
+#include <pushmi/inline.h>
+
+using namespace pushmi::aliases;
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+using namespace testing;
+
+class Trace : public Test {
+ protected:
+  void SetUp() override {
+    mi::clear_trace();
+    mi::start_tracing();
+  }
+  void TearDown() override {
+    mi::stop_tracing();
+    mi::clear_trace();
+  }
+
+  static int run_pipeline() {
+    int result = 0;
+    op::just(21) | op::transform([](int v) { return v * 2; }) |
+        op::filter([](int v) { return v > 0; }) | op::tap([](int) {}) |
+        op::via([] { return mi::inline_executor(); }) |
+        op::on([] { return mi::inline_executor(); }) |
+        op::submit([&](int v) { result = v; });
+    return result;
+  }
+
+  static std::string trace() {
+    std::stringstream out;
+    mi::write_chrome_trace(out);
+    return out.str();
+  }
+
+  struct span {
+    std::string name;
+    std::string signal;
+    std::string tid;
+  };
+
+  static std::vector<span> events(const std::string& json) {
+    static const std::regex event{
+        "\\{\"name\":\"(\\w+)\",\"cat\":\"(\\w+)\",\"ph\":\"X\","
+        "\"ts\":[0-9.]+,\"dur\":[0-9.]+,\"pid\":1,\"tid\":([0-9]+)\\}"};
+    std::vector<span> spans;
+    for (std::sregex_iterator it{json.begin(), json.end(), event}, end;
+         it != end;
+         ++it) {
+      spans.push_back(span{(*it)[1], (*it)[2], (*it)[3]});
+    }
+    return spans;
+  }
+};
+
+static_assert(PUSHMI_TRACE, "TraceTest must be built with PUSHMI_TRACE=1");
+
+TEST_F(Trace, OperatorSignals) {
+  EXPECT_THAT(run_pipeline(), Eq(42));
+
+  auto json = trace();
+  EXPECT_THAT(json, StartsWith("{\"traceEvents\":["));
+  EXPECT_THAT(json, EndsWith("],\"displayTimeUnit\":\"ns\"}\n"));
+
+  std::set<std::string> seen;
+  for (auto& e : events(json)) {
+    seen.insert(e.name + "." + e.signal);
+  }
+  for (auto op : {"transform", "filter", "tap", "via", "on", "submit"}) {
+    EXPECT_THAT(seen, Contains(std::string(op) + ".value")) << op;
+    EXPECT_THAT(seen, Contains(std::string(op) + ".done")) << op;
+  }
+}
+
+TEST_F(Trace, NotRecordedWhenStopped) {
+  mi::stop_tracing();
+  EXPECT_THAT(run_pipeline(), Eq(42));
+  EXPECT_THAT(events(trace()), IsEmpty());
+
+  mi::start_tracing();
+  EXPECT_THAT(run_pipeline(), Eq(42));
+  EXPECT_THAT(events(trace()), Not(IsEmpty()));
+
+  mi::clear_trace();
+  EXPECT_THAT(events(trace()), IsEmpty());
+}
+
+TEST_F(Trace, ThreadIds) {
+  std::thread first{[] { run_pipeline(); }};
+  first.join();
+  std::thread second{[] { run_pipeline(); }};
+  second.join();
+
+  std::set<std::string> tids;
+  for (auto& e : events(trace())) {
+    tids.insert(e.tid);
+  }
+  EXPECT_THAT(tids.size(), Eq(2u));
+}
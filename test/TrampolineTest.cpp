@@ -31,6 +31,7 @@ using namespace std::literals;
 #include <pushmi/o/via.h>
 
 #include <pushmi/inline.h>
+#include <pushmi/instrumented.h>
 #include <pushmi/trampoline.h>
 
 using namespace pushmi::aliases;
@@ -138,3 +139,28 @@ TEST_F(TrampolineExecutor, UsedWithVia) {
   EXPECT_THAT(values, ElementsAre(std::to_string(2.0)))
       << "expected that only the first item was pushed";
 }
+
+TEST_F(TrampolineExecutor, Instrumented) {
+  mi::executor_stats stats;
+  auto itr = mi::instrumented(tr_, &stats);
+  static_assert(
+      mi::Executor<decltype(itr), mi::is_fifo_sequence<>>,
+      "expected the instrumented trampoline to be a fifo executor");
+
+  int counter = 10;
+  itr | op::schedule() | op::submit(countdownsingle{counter});
+  EXPECT_THAT(counter, Eq(0)) << "expected that all the items ran";
+  EXPECT_THAT(stats.queue_delay().count, Eq(1u))
+      << "expected that only the item submitted to the instrumented executor "
+         "recorded its queue delay";
+  EXPECT_THAT(stats.run_time().count, Eq(1u))
+      << "expected that the instrumented item recorded its run time";
+
+  auto v = itr | op::schedule() |
+      op::transform([](auto) { return 42; }) | op::get<int>;
+  EXPECT_THAT(v, Eq(42)) << "expected that the result was delivered";
+  EXPECT_THAT(stats.run_time().count, Eq(2u));
+
+  stats.reset();
+  EXPECT_THAT(stats.run_time().count, Eq(0u));
+}